@@ -0,0 +1,36 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/sources/bvh.cpp" "sources/CMakeFiles/raytracer.dir/bvh.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/bvh.cpp.o.d"
+  "/root/repo/sources/distributed.cpp" "sources/CMakeFiles/raytracer.dir/distributed.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/distributed.cpp.o.d"
+  "/root/repo/sources/hittable_list.cpp" "sources/CMakeFiles/raytracer.dir/hittable_list.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/hittable_list.cpp.o.d"
+  "/root/repo/sources/image_formats.cpp" "sources/CMakeFiles/raytracer.dir/image_formats.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/image_formats.cpp.o.d"
+  "/root/repo/sources/image_writer.cpp" "sources/CMakeFiles/raytracer.dir/image_writer.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/image_writer.cpp.o.d"
+  "/root/repo/sources/material.cpp" "sources/CMakeFiles/raytracer.dir/material.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/material.cpp.o.d"
+  "/root/repo/sources/progressive.cpp" "sources/CMakeFiles/raytracer.dir/progressive.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/progressive.cpp.o.d"
+  "/root/repo/sources/random_world.cpp" "sources/CMakeFiles/raytracer.dir/random_world.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/random_world.cpp.o.d"
+  "/root/repo/sources/rtweekend.cpp" "sources/CMakeFiles/raytracer.dir/rtweekend.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/rtweekend.cpp.o.d"
+  "/root/repo/sources/scene.cpp" "sources/CMakeFiles/raytracer.dir/scene.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/scene.cpp.o.d"
+  "/root/repo/sources/sphere.cpp" "sources/CMakeFiles/raytracer.dir/sphere.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/sphere.cpp.o.d"
+  "/root/repo/sources/sphere_soa.cpp" "sources/CMakeFiles/raytracer.dir/sphere_soa.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/sphere_soa.cpp.o.d"
+  "/root/repo/sources/temporal.cpp" "sources/CMakeFiles/raytracer.dir/temporal.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/temporal.cpp.o.d"
+  "/root/repo/sources/thread_pool.cpp" "sources/CMakeFiles/raytracer.dir/thread_pool.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/thread_pool.cpp.o.d"
+  "/root/repo/sources/tile_scheduler.cpp" "sources/CMakeFiles/raytracer.dir/tile_scheduler.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/tile_scheduler.cpp.o.d"
+  "/root/repo/sources/trace_stats.cpp" "sources/CMakeFiles/raytracer.dir/trace_stats.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/trace_stats.cpp.o.d"
+  "/root/repo/sources/vec3.cpp" "sources/CMakeFiles/raytracer.dir/vec3.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/vec3.cpp.o.d"
+  "/root/repo/sources/wavefront.cpp" "sources/CMakeFiles/raytracer.dir/wavefront.cpp.o" "gcc" "sources/CMakeFiles/raytracer.dir/wavefront.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
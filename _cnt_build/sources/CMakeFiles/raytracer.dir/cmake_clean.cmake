@@ -0,0 +1,45 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/raytracer.dir/bvh.cpp.o"
+  "CMakeFiles/raytracer.dir/bvh.cpp.o.d"
+  "CMakeFiles/raytracer.dir/distributed.cpp.o"
+  "CMakeFiles/raytracer.dir/distributed.cpp.o.d"
+  "CMakeFiles/raytracer.dir/hittable_list.cpp.o"
+  "CMakeFiles/raytracer.dir/hittable_list.cpp.o.d"
+  "CMakeFiles/raytracer.dir/image_formats.cpp.o"
+  "CMakeFiles/raytracer.dir/image_formats.cpp.o.d"
+  "CMakeFiles/raytracer.dir/image_writer.cpp.o"
+  "CMakeFiles/raytracer.dir/image_writer.cpp.o.d"
+  "CMakeFiles/raytracer.dir/material.cpp.o"
+  "CMakeFiles/raytracer.dir/material.cpp.o.d"
+  "CMakeFiles/raytracer.dir/progressive.cpp.o"
+  "CMakeFiles/raytracer.dir/progressive.cpp.o.d"
+  "CMakeFiles/raytracer.dir/random_world.cpp.o"
+  "CMakeFiles/raytracer.dir/random_world.cpp.o.d"
+  "CMakeFiles/raytracer.dir/rtweekend.cpp.o"
+  "CMakeFiles/raytracer.dir/rtweekend.cpp.o.d"
+  "CMakeFiles/raytracer.dir/scene.cpp.o"
+  "CMakeFiles/raytracer.dir/scene.cpp.o.d"
+  "CMakeFiles/raytracer.dir/sphere.cpp.o"
+  "CMakeFiles/raytracer.dir/sphere.cpp.o.d"
+  "CMakeFiles/raytracer.dir/sphere_soa.cpp.o"
+  "CMakeFiles/raytracer.dir/sphere_soa.cpp.o.d"
+  "CMakeFiles/raytracer.dir/temporal.cpp.o"
+  "CMakeFiles/raytracer.dir/temporal.cpp.o.d"
+  "CMakeFiles/raytracer.dir/thread_pool.cpp.o"
+  "CMakeFiles/raytracer.dir/thread_pool.cpp.o.d"
+  "CMakeFiles/raytracer.dir/tile_scheduler.cpp.o"
+  "CMakeFiles/raytracer.dir/tile_scheduler.cpp.o.d"
+  "CMakeFiles/raytracer.dir/trace_stats.cpp.o"
+  "CMakeFiles/raytracer.dir/trace_stats.cpp.o.d"
+  "CMakeFiles/raytracer.dir/vec3.cpp.o"
+  "CMakeFiles/raytracer.dir/vec3.cpp.o.d"
+  "CMakeFiles/raytracer.dir/wavefront.cpp.o"
+  "CMakeFiles/raytracer.dir/wavefront.cpp.o.d"
+  "libraytracer.a"
+  "libraytracer.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/raytracer.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
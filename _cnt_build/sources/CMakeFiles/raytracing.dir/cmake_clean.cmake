@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/raytracing.dir/main.cpp.o"
+  "CMakeFiles/raytracing.dir/main.cpp.o.d"
+  "raytracing"
+  "raytracing.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/raytracing.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/raytracing_bench.dir/bench.cpp.o"
+  "CMakeFiles/raytracing_bench.dir/bench.cpp.o.d"
+  "raytracing_bench"
+  "raytracing_bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/raytracing_bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
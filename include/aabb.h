@@ -0,0 +1,72 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <algorithm>
+
+#include "ray.h"
+#include "vec3.h"
+
+class aabb {
+ public:
+  // default box is empty, growing it by any point or box gives that point or box
+  aabb() : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+  aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+  point3 min() const { return minimum; }
+  point3 max() const { return maximum; }
+
+  point3 centroid() const { return (minimum + maximum) / 2; }
+
+  bool empty() const { return minimum[0] > maximum[0] || minimum[1] > maximum[1] || minimum[2] > maximum[2]; }
+
+  void grow(const point3& p) {
+    for (int a = 0; a < 3; a++) {
+      minimum[a] = std::min(minimum[a], p[a]);
+      maximum[a] = std::max(maximum[a], p[a]);
+    }
+  }
+
+  void grow(const aabb& box) {
+    for (int a = 0; a < 3; a++) {
+      minimum[a] = std::min(minimum[a], box.minimum[a]);
+      maximum[a] = std::max(maximum[a], box.maximum[a]);
+    }
+  }
+
+  int longest_axis() const {
+    vec3 extent = maximum - minimum;
+    if (extent[0] > extent[1] && extent[0] > extent[2]) return 0;
+    return (extent[1] > extent[2]) ? 1 : 2;
+  }
+
+  real surface_area() const {
+    if (empty()) return 0;
+    vec3 d = maximum - minimum;
+    return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+  }
+
+  bool hit(const ray& r, real t_min, real t_max) const {
+    for (int a = 0; a < 3; a++) {
+      real inv_d = 1 / r.direction()[a];
+      real t0 = (minimum[a] - r.origin()[a]) * inv_d;
+      real t1 = (maximum[a] - r.origin()[a]) * inv_d;
+      if (inv_d < 0) std::swap(t0, t1);
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+      if (t_max <= t_min) return false;
+    }
+    return true;
+  }
+
+ public:
+  point3 minimum;
+  point3 maximum;
+};
+
+inline aabb surrounding_box(const aabb& box0, const aabb& box1) {
+  aabb box = box0;
+  box.grow(box1);
+  return box;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "vec3.h"
+
+struct adaptive_settings {
+  bool enabled = false;
+  // every pixel gets at least min_samples, a converged pixel is not sampled any more
+  uint32_t min_samples = 8;
+  // no pixel gets more than max_samples, the average stays at samples_per_pixel of the renderer
+  uint32_t max_samples = 512;
+  // samples per pixel and pass after the first pass
+  uint32_t batch_size = 4;
+  // a pixel is converged when the standard error of its displayed (gamma corrected) value is below this threshold
+  double noise_threshold = 0.005;
+};
+
+// Running mean and variance of the luminance of a pixel (Welford's algorithm) next to the color sum
+struct pixel_estimate {
+  color sum = color(0, 0, 0);
+  uint32_t count = 0;
+  double mean = 0.;
+  double m2 = 0.;
+
+  void add(const color& sample) {
+    sum += sample;
+    count++;
+
+    double y = 0.2126 * sample[0] + 0.7152 * sample[1] + 0.0722 * sample[2];
+    double delta = y - mean;
+    mean += delta / count;
+    m2 += delta * (y - mean);
+  }
+
+  // Standard error of the displayed value sqrt(mean). With d sqrt(x) = dx / (2 sqrt(x)) the standard error of the
+  // mean is scaled, so dark and bright pixels are treated the same way as the eye sees them.
+  double error() const {
+    if (count < 2) return std::numeric_limits<double>::max();
+
+    double standard_error = std::sqrt(m2 / (count - 1) / count);
+    return standard_error / (2. * std::sqrt(mean) + 1e-4);
+  }
+};
+
+#endif
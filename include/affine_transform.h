@@ -0,0 +1,110 @@
+#ifndef AFFINE_TRANSFORM_H
+#define AFFINE_TRANSFORM_H
+
+#include <cmath>
+#include <stdexcept>
+
+#include "aabb.h"
+#include "vec3.h"
+
+// Affine transform p' = A p + b stored as the 3x4 matrix [A | b], the last row (0 0 0 1) is implicit.
+struct affine_transform {
+  real m[3][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+  static affine_transform translation(const vec3& offset) {
+    affine_transform t;
+    for (int i = 0; i < 3; i++) t.m[i][3] = offset[i];
+    return t;
+  }
+
+  static affine_transform scaling(const vec3& factors) {
+    affine_transform t;
+    for (int i = 0; i < 3; i++) t.m[i][i] = factors[i];
+    return t;
+  }
+
+  // counterclockwise around axis when looking against it
+  static affine_transform rotation(const vec3& axis, real degrees) {
+    const vec3 u = unit_vector(axis);
+    const real c = std::cos(degrees_to_radians(degrees));
+    const real s = std::sin(degrees_to_radians(degrees));
+    affine_transform t;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) t.m[i][j] = (1 - c) * u[i] * u[j] + (i == j ? c : 0);
+    }
+    t.m[0][1] -= s * u[2];
+    t.m[0][2] += s * u[1];
+    t.m[1][0] += s * u[2];
+    t.m[1][2] -= s * u[0];
+    t.m[2][0] -= s * u[1];
+    t.m[2][1] += s * u[0];
+    return t;
+  }
+
+  // first other, then this
+  affine_transform operator*(const affine_transform& other) const {
+    affine_transform t;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 4; j++) {
+        t.m[i][j] = m[i][0] * other.m[0][j] + m[i][1] * other.m[1][j] + m[i][2] * other.m[2][j];
+      }
+      t.m[i][3] += m[i][3];
+    }
+    return t;
+  }
+
+  // throws std::invalid_argument if A is singular
+  affine_transform inverse() const {
+    // inverse of A as the adjugate over the determinant, solved in precise_real
+    precise_real cofactor[3][3];
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        const int i1 = (i + 1) % 3, i2 = (i + 2) % 3, j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        cofactor[i][j] = precise_real(m[i1][j1]) * m[i2][j2] - precise_real(m[i1][j2]) * m[i2][j1];
+      }
+    }
+    const precise_real det = m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] + m[0][2] * cofactor[0][2];
+    if (!(std::abs(det) > 0) || !std::isfinite(det)) throw std::invalid_argument("transform can't be inverted");
+
+    affine_transform t;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) t.m[i][j] = cofactor[j][i] / det;
+    }
+    for (int i = 0; i < 3; i++) {
+      t.m[i][3] = -(precise_real(t.m[i][0]) * m[0][3] + precise_real(t.m[i][1]) * m[1][3] +
+                    precise_real(t.m[i][2]) * m[2][3]);
+    }
+    return t;
+  }
+
+  point3 apply_point(const point3& p) const { return apply_vector(p) + vec3(m[0][3], m[1][3], m[2][3]); }
+
+  vec3 apply_vector(const vec3& v) const {
+    return vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2], m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+  }
+
+  // A^T v, transforms the normals of the inverse transform
+  vec3 apply_transposed(const vec3& v) const {
+    return vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2], m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+                m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+  }
+
+  // smallest box around the transformed box (Arvo)
+  aabb apply_box(const aabb& box) const {
+    if (box.empty()) return box;
+    point3 minimum(m[0][3], m[1][3], m[2][3]);
+    point3 maximum = minimum;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        const real a = m[i][j] * box.minimum[j];
+        const real b = m[i][j] * box.maximum[j];
+        minimum[i] += std::min(a, b);
+        maximum[i] += std::max(a, b);
+      }
+    }
+    return aabb(minimum, maximum);
+  }
+};
+
+#endif
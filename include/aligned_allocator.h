@@ -0,0 +1,39 @@
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Allocator for std::vector which aligns the data for aligned SIMD loads
+template <class T, size_t ALIGNMENT = 64>
+class aligned_allocator {
+ public:
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = aligned_allocator<U, ALIGNMENT>;
+  };
+
+  aligned_allocator() noexcept {}
+  template <class U>
+  aligned_allocator(const aligned_allocator<U, ALIGNMENT>&) noexcept {}
+
+  T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT))); }
+  void deallocate(T* p, size_t) noexcept { ::operator delete(p, std::align_val_t(ALIGNMENT)); }
+
+  template <class U>
+  bool operator==(const aligned_allocator<U, ALIGNMENT>&) const noexcept {
+    return true;
+  }
+  template <class U>
+  bool operator!=(const aligned_allocator<U, ALIGNMENT>&) const noexcept {
+    return false;
+  }
+};
+
+template <class T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+#endif
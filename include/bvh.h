@@ -0,0 +1,280 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "thread_pool.h"
+#include "trace_stats.h"
+
+// Node of a flattened bounding volume hierarchy. The nodes are stored depth first, so the left child of an inner
+// node is always the next node in the array and only the index of the right child has to be stored.
+// One node fills exactly one cache line in double precision and half of one in float.
+struct alignas(8 * sizeof(real)) bvh_node {
+  real bounds_min[3];
+  real bounds_max[3];
+  uint32_t offset;  // leaf: index of the first primitive, inner node: index of the right child
+  uint16_t count;   // number of primitives in a leaf, 0 for inner nodes
+  uint8_t axis;     // split axis of an inner node
+
+  bool is_leaf() const { return count > 0; }
+};
+
+// When bvh_tree::update rebuilds after the primitives moved. The SAH cost of a (sub)tree is measured relative to the
+// surface of its root box, so it grows when the boxes of the children overlap more, not when the whole tree grows.
+struct bvh_update_settings {
+  // a subtree below bvh_tree::refit_depth is rebuilt if its cost grew by this factor since it was built
+  double partial_rebuild_ratio = 1.2;
+  // the whole tree is rebuilt if its cost grew by this factor since the last full build, e.g. when primitives moved
+  // from one side of the scene to the other and the upper levels don't separate them any more
+  double full_rebuild_ratio = 1.5;
+};
+
+struct bvh_update_stats {
+  double refit_time = 0.;    // [s]
+  double rebuild_time = 0.;  // [s]
+  double cost_ratio = 1.;    // cost after the refit / cost after the last full build
+  size_t rebuilt_subtrees = 0;
+  bool full_rebuild = false;
+};
+
+// Binned SAH bounding volume hierarchy over arbitrary primitives which are only known by their bounding boxes.
+// The primitives are referenced by primitive_indices(), leaves cover a contiguous range of this array.
+class bvh_tree {
+ public:
+  void build(const std::vector<aabb>& primitive_boxes);
+  // Uses the nodes of a tree built before in place, e.g. in a mapped file, they have to outlive the tree. The
+  // primitives have to be stored in the leaf order of that tree, primitive_indices() is empty.
+  void reference(const bvh_node* nodes, size_t count);
+  // for owners which reordered their primitives into the leaf order after build
+  void clear_primitive_indices() { std::vector<uint32_t>().swap(primitive_indices_); }
+
+  const bvh_node* nodes() const { return external_nodes_ != nullptr ? external_nodes_ : nodes_.data(); }
+  size_t num_nodes() const { return external_nodes_ != nullptr ? num_external_nodes_ : nodes_.size(); }
+  const std::vector<uint32_t>& primitive_indices() const { return primitive_indices_; }
+
+  bool empty() const { return num_nodes() == 0; }
+  aabb bounds() const;
+
+  // Fits the tree to moved primitives, primitive_boxes are indexed like in build(). The boxes of the nodes are refitted
+  // bottom up, the subtrees below refit_depth in parallel, then the nodes above them. Subtrees whose SAH cost degraded
+  // are rebuilt in parallel and spliced into the node array, if the cost of the whole tree degraded it is rebuilt,
+  // see bvh_update_settings. Only for trees built with build() which kept their primitive indices.
+  bvh_update_stats update(const std::vector<aabb>& primitive_boxes, threadPool& pool,
+                          const bvh_update_settings& settings = bvh_update_settings());
+
+  // SAH cost relative to the surface of the root box: expected node visits and primitive intersections of a ray
+  // through the root box, weighted with the costs of the builder
+  double sah_cost() const;
+
+  // Finds the closest hit by visiting the children front-to-back and skipping all nodes which start behind the
+  // closest hit found so far.
+  // intersect_leaf(first, count, closest_so_far) has to test the primitives [first, first + count) and reduce
+  // closest_so_far on a hit. It returns true if a primitive was hit.
+  template <class LEAF_FUNC>
+  bool traverse(const ray& r, real t_min, real t_max, LEAF_FUNC&& intersect_leaf) const;
+
+  // Any hit query for shadow rays: stops at the first leaf for which occluded_leaf(first, count) returns true, the
+  // children are not sorted and the t range doesn't shrink.
+  template <class LEAF_FUNC>
+  bool traverse_any(const ray& r, real t_min, real t_max, LEAF_FUNC&& occluded_leaf) const;
+
+  static constexpr uint32_t max_leaf_size = 4;
+  static constexpr uint32_t max_depth = 64;
+  // the roots of the subtrees which update refits and rebuilds in parallel, up to 2^refit_depth subtrees
+  static constexpr uint32_t refit_depth = 6;
+
+ private:
+  // subtree below refit_depth, its nodes are [root, end) as the nodes are stored depth first
+  struct subtree {
+    uint32_t root;
+    uint32_t end;
+    uint32_t depth;
+    double build_cost;  // relative cost after it was built
+  };
+
+  // appends the nodes of the primitives [begin, end) to nodes, the child indices are indices into nodes
+  uint32_t build_recursive(std::vector<bvh_node>& nodes, const std::vector<aabb>& boxes,
+                           const std::vector<point3>& centroids, uint32_t begin, uint32_t end, uint32_t depth);
+  // subtrees_ and top_nodes_ of the current nodes, the build costs of the subtrees and the tree
+  void find_subtrees();
+  // refits the nodes [begin, end) from the back, the children of every node have to be refitted before or in the range
+  double refit_nodes(const std::vector<aabb>& boxes, uint32_t begin, uint32_t end);
+  double refit_node(const std::vector<aabb>& boxes, uint32_t index);
+  // unnormalized cost of the nodes [begin, end)
+  double nodes_cost(uint32_t begin, uint32_t end) const;
+  // rebuilds the subtrees with the given indices in subtrees_ (ascending) and splices them into nodes_
+  void rebuild_subtrees(const std::vector<aabb>& boxes, const std::vector<size_t>& rebuilt, threadPool& pool);
+
+  static void prepare_ray(const ray& r, real origin[3], real inv_dir[3]) {
+    for (int a = 0; a < 3; a++) {
+      origin[a] = r.origin()[a];
+      // avoid 0 * inf = nan in the slab test, -ffast-math doesn't handle infinities reliably
+      real d = r.direction()[a];
+      inv_dir[a] = 1 / (std::abs(d) > real(1e-12) ? d : std::copysign(real(1e-12), d));
+    }
+  }
+
+  static bool hit_node(const bvh_node& node, const real origin[3], const real inv_dir[3], real t_min,
+                       real t_max, real& t_entry) {
+    for (int a = 0; a < 3; a++) {
+      real t0 = (node.bounds_min[a] - origin[a]) * inv_dir[a];
+      real t1 = (node.bounds_max[a] - origin[a]) * inv_dir[a];
+      if (inv_dir[a] < 0.0) std::swap(t0, t1);
+      t_min = t0 > t_min ? t0 : t_min;
+      t_max = t1 < t_max ? t1 : t_max;
+    }
+    t_entry = t_min;
+    return t_min <= t_max;
+  }
+
+  std::vector<bvh_node> nodes_;
+  const bvh_node* external_nodes_ = nullptr;  // set by reference(), nodes_ is empty then
+  size_t num_external_nodes_ = 0;
+  std::vector<uint32_t> primitive_indices_;
+  // the partition of the nodes for update, found after every build
+  std::vector<subtree> subtrees_;
+  std::vector<uint32_t> top_nodes_;  // the nodes above the subtrees, ascending
+  double build_cost_ = 0.;           // relative cost after the last full build
+};
+
+template <class LEAF_FUNC>
+bool bvh_tree::traverse(const ray& r, real t_min, real t_max, LEAF_FUNC&& intersect_leaf) const {
+  if (empty()) return false;
+  const bvh_node* nodes = this->nodes();
+
+  real origin[3];
+  real inv_dir[3];
+  prepare_ray(r, origin, inv_dir);
+
+  uint32_t node_stack[max_depth];
+  real entry_stack[max_depth];
+  size_t stack_size = 0;
+
+  bool hit_anything = false;
+  real closest_so_far = t_max;
+  real t_entry;
+
+  if (!hit_node(nodes[0], origin, inv_dir, t_min, closest_so_far, t_entry)) return false;
+
+  uint32_t node_index = 0;
+
+  while (true) {
+    const bvh_node& node = nodes[node_index];
+    TRACE_COUNT(node_visits);
+
+    if (node.is_leaf()) {
+      if (intersect_leaf(node.offset, node.count, closest_so_far)) hit_anything = true;
+    } else {
+      uint32_t near_index = node_index + 1;
+      uint32_t far_index = node.offset;
+      real t_near, t_far;
+      bool hit_near = hit_node(nodes[near_index], origin, inv_dir, t_min, closest_so_far, t_near);
+      bool hit_far = hit_node(nodes[far_index], origin, inv_dir, t_min, closest_so_far, t_far);
+
+      if (hit_near && hit_far) {
+        if (t_far < t_near) {
+          std::swap(near_index, far_index);
+          std::swap(t_near, t_far);
+        }
+        node_stack[stack_size] = far_index;
+        entry_stack[stack_size] = t_far;
+        stack_size++;
+        node_index = near_index;
+        continue;
+      } else if (hit_near) {
+        node_index = near_index;
+        continue;
+      } else if (hit_far) {
+        node_index = far_index;
+        continue;
+      }
+    }
+
+    // early out: nodes which are entered behind the closest hit can't contain a closer one
+    do {
+      if (stack_size == 0) return hit_anything;
+      stack_size--;
+    } while (entry_stack[stack_size] > closest_so_far);
+
+    node_index = node_stack[stack_size];
+  }
+}
+
+template <class LEAF_FUNC>
+bool bvh_tree::traverse_any(const ray& r, real t_min, real t_max, LEAF_FUNC&& occluded_leaf) const {
+  if (empty()) return false;
+  const bvh_node* nodes = this->nodes();
+
+  real origin[3];
+  real inv_dir[3];
+  prepare_ray(r, origin, inv_dir);
+
+  uint32_t node_stack[max_depth];
+  size_t stack_size = 0;
+  real t_entry;
+
+  if (!hit_node(nodes[0], origin, inv_dir, t_min, t_max, t_entry)) return false;
+
+  uint32_t node_index = 0;
+
+  while (true) {
+    const bvh_node& node = nodes[node_index];
+    TRACE_COUNT(node_visits);
+
+    if (node.is_leaf()) {
+      if (occluded_leaf(node.offset, node.count)) return true;
+    } else {
+      bool hit_near = hit_node(nodes[node_index + 1], origin, inv_dir, t_min, t_max, t_entry);
+      bool hit_far = hit_node(nodes[node.offset], origin, inv_dir, t_min, t_max, t_entry);
+
+      if (hit_near) {
+        if (hit_far) node_stack[stack_size++] = node.offset;
+        node_index = node_index + 1;
+        continue;
+      } else if (hit_far) {
+        node_index = node.offset;
+        continue;
+      }
+    }
+
+    if (stack_size == 0) return false;
+    node_index = node_stack[--stack_size];
+  }
+}
+
+// Bounding volume hierarchy over hittables, drop-in replacement for the linear search in hittable_list.
+class bvh : public hittable {
+ public:
+  bvh(const hittable_list& list) : bvh(list.objects) {}
+  bvh(const std::vector<std::shared_ptr<hittable>>& objects);
+  virtual ~bvh() {}
+
+  virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const;
+  virtual bool occluded(const ray& r, real t_min, real t_max) const;
+  virtual bool bounding_box(aabb& output_box) const;
+
+  const bvh_tree& tree() const { return tree_; }
+  const std::vector<std::shared_ptr<hittable>>& objects() const { return objects_; }
+
+  // Fits the bvh to objects which moved since it was built or updated, e.g. spheres with a new center or instances
+  // with a new transform, see bvh_tree::update. The bounding boxes of the objects are collected in parallel.
+  // Objects with a bounding box must keep it, throws std::runtime_error else.
+  bvh_update_stats update(threadPool& pool, const bvh_update_settings& settings = bvh_update_settings());
+
+ private:
+  // objects_ and leaves_ in the leaf order of tree_
+  void sort_objects();
+
+  std::vector<std::shared_ptr<hittable>> bounded_;    // objects with bounding box in the order of the tree build
+  std::vector<std::shared_ptr<hittable>> objects_;    // sorted in the order of the tree leaves
+  std::vector<const hittable*> leaves_;               // objects_ without the reference counts, used by hit
+  std::vector<std::shared_ptr<hittable>> unbounded_;  // objects without bounding box, tested linearly
+  bvh_tree tree_;
+};
+
+#endif
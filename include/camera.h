@@ -7,14 +7,14 @@
 class camera {
  public:
   camera(point3 lookfrom, point3 lookat, vec3 vup,
-         double vfov,  // vertical field-of-view in degrees
-         double aspect_ratio, double aperture, double focus_dist) {
+         real vfov,  // vertical field-of-view in degrees
+         real aspect_ratio, real aperture, real focus_dist) {
     origin = lookfrom;
     lens_radius = aperture / 2;
 
-    double theta = degrees_to_radians(vfov);
-    double half_height = tan(theta / 2);
-    double half_width = aspect_ratio * half_height;
+    real theta = degrees_to_radians(vfov);
+    real half_height = std::tan(theta / 2);
+    real half_width = aspect_ratio * half_height;
 
     w = unit_vector(lookfrom - lookat);
     u = unit_vector(cross(vup, w));
@@ -23,21 +23,43 @@ class camera {
 
     horizontal = 2 * half_width * focus_dist * u;
     vertical = 2 * half_height * focus_dist * v;
+    focus_distance = focus_dist;
   }
 
-  ray get_ray(double s, double t) const {
+  ray get_ray(real s, real t) const {
     vec3 rd = lens_radius * random_in_unit_disk();
     vec3 offset = u * rd.x() + v * rd.y();
 
     return ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset);
   }
 
+  // ray through the center of the lens, the ray of a pinhole camera
+  ray get_center_ray(real s, real t) const {
+    return ray(origin, lower_left_corner + s * horizontal + t * vertical - origin);
+  }
+
+  // Inverse of get_center_ray: image coordinates (s, t) of point p, false if p is not in front of the camera
+  bool project(const point3& p, real& s, real& t) const {
+    const vec3 d = p - origin;
+    const real depth = -dot(d, w);
+    if (depth <= 0) return false;
+
+    // intersection with the focus plane, on which the image coordinates are spanned
+    const vec3 on_plane = origin + (focus_distance / depth) * d - lower_left_corner;
+    s = dot(on_plane, horizontal) / dot(horizontal, horizontal);
+    t = dot(on_plane, vertical) / dot(vertical, vertical);
+    return true;
+  }
+
+  point3 position() const { return origin; }
+
  private:
   point3 origin;
   point3 lower_left_corner;
   vec3 horizontal;
   vec3 vertical;
   vec3 u, v, w;
-  double lens_radius;
+  real lens_radius;
+  real focus_distance;
 };
 #endif
\ No newline at end of file
@@ -1,55 +1,51 @@
 #ifndef COLOR_H
 #define COLOR_H
 
-#include <array>
-#include <iostream>
-#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "image_formats.h"
 #include "vec3.h"
 
-#ifdef USE_PNG
-#include <png++/png.hpp>
-typedef png::rgb_pixel image_color;
-typedef png::image<image_color> image_type;
-const std::string image_filename_postfix = ".png";
-#else
-#include "p3.h"
-typedef color image_color;
-typedef P3<image_color> image_type;
-const std::string image_filename_postfix = ".p3";
-#endif
-
 class ImageWrapper {
  public:
-  ImageWrapper(std::string filename, uint32_t width, uint32_t height)
-      : image_(std::make_unique<image_type>(width, height)), width_(width), height_(height), filename_(filename) {
-    static_cast<void>(width_); // not used, warning by clang
-  }
+  ImageWrapper(std::string filename, uint32_t width, uint32_t height, image_type type = default_image_type)
+      : pixels_(3ul * width * height), width_(width), height_(height), filename_(filename), type_(type) {}
 
   void write_color(uint32_t x, uint32_t y, color pixel_color, int samples_per_pixel) {
-    double r = pixel_color[0];
-    double g = pixel_color[1];
-    double b = pixel_color[2];
-
-    // Divide the color total by the number of samples.
+    // Divide the color total by the number of samples, the encoder does the gamma correction of 8 bit formats.
     double scale = 1.0 / samples_per_pixel;
-    r = std::sqrt(scale * r);
-    g = std::sqrt(scale * g);
-    b = std::sqrt(scale * b);
-
-    // Write the translated [0,255] value of each color component.
-    auto pixel = image_color(static_cast<int>(256 * clamp(r, 0.0, 0.999)), static_cast<int>(256 * clamp(g, 0.0, 0.999)),
-                             static_cast<int>(256 * clamp(b, 0.0, 0.999)));
-    image_->set_pixel(x, height_ - 1 - y, pixel);
+
+    float* pixel = &pixels_[3ul * (x + width_ * (height_ - 1 - y))];
+    for (int c = 0; c < 3; c++) {
+      pixel[c] = static_cast<float>(scale * pixel_color[c]);
+    }
   }
 
-  void write() { image_->write(filename_ + image_filename_postfix); }
+  void set_type(image_type type) { type_ = type; }
+  image_type type() const { return type_; }
+
+  void write() { write_file(filename(), encode()); }
+
+  // encoded file content, write() split in the CPU part and the I/O part
+  std::string encode() const { return imageEncoder::encode(type_, width_, height_, pixels_.data()); }
+
+  static void write_file(const std::string& filename, const std::string& data) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (!file) throw std::runtime_error("can't write image " + filename);
+  }
+
+  std::string filename() const { return filename_ + imageEncoder::extension(type_); }
 
  private:
-  std::unique_ptr<image_type> image_;
+  std::vector<float> pixels_;  // linear mean of the samples, rows from top to bottom
   uint32_t width_;
   uint32_t height_;
   std::string filename_;
+  image_type type_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,68 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstddef>
+#include <cstdint>
+
+// splitmix64 finalizer, mixes a and b into a well distributed 64 bit value
+inline uint64_t hash_combine(uint64_t a, uint64_t b) {
+  uint64_t z = a + 0x9e3779b97f4a7c15ull * (b + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Counter based random numbers: number n of the stream with key k is hash_combine(k, n), which is the splitmix64
+// sequence seeded with k. The state is only the position in the stream, so there is nothing to carry between threads.
+// The renderer starts a stream for every pixel sample, keyed by frame, pixel and sample, and every bounce starts at
+// its own block of the stream. The numbers a sample uses don't depend on the thread which renders it or on the
+// numbers earlier bounces consumed.
+class counterRng {
+ public:
+  static uint64_t key(uint64_t frame, uint64_t pixel, uint64_t sample) {
+    return hash_combine(hash_combine(frame, pixel), sample);
+  }
+
+  void set_stream(uint64_t key, uint64_t counter = 0) {
+    key_ = key;
+    counter_ = counter;
+  }
+
+  // continue at the number offset of the block of the bounce
+  void set_bounce(uint32_t bounce, uint32_t offset = 0) { counter_ = (static_cast<uint64_t>(bounce) << 32) + offset; }
+
+  uint64_t next() { return hash_combine(key_, counter_++); }
+
+  // position of the next number in the stream
+  uint64_t counter() const { return counter_; }
+
+  // uniform in [0,1), with all the mantissa bits of T
+  template <class T>
+  T uniform() {
+    return to_uniform<T>(next());
+  }
+
+  // number counter of N streams at once, the loop vectorizes to N lanes
+  template <class T, size_t N>
+  static void uniform(const uint64_t (&keys)[N], uint64_t counter, T (&out)[N]) {
+    for (size_t lane = 0; lane < N; lane++) {
+      out[lane] = to_uniform<T>(hash_combine(keys[lane], counter));
+    }
+  }
+
+  // the high bits as uniform number in [0,1)
+  template <class T>
+  static T to_uniform(uint64_t bits) {
+    if constexpr (sizeof(T) == sizeof(float)) {
+      return static_cast<T>(bits >> 40) * 0x1p-24f;
+    } else {
+      return static_cast<T>(bits >> 11) * 0x1p-53;
+    }
+  }
+
+ private:
+  uint64_t key_ = 0;
+  uint64_t counter_ = 0;
+};
+
+#endif
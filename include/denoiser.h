@@ -0,0 +1,73 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "adaptive_sampling.h"
+#include "thread_pool.h"
+#include "vec3.h"
+
+// Guide buffers of a pixel, summed over its samples like pixel_estimate::sum. They are taken at the first diffuse hit
+// of a path, mirrors and glass are followed, so the reflections keep their edges: the albedo times the attenuation of
+// the mirrors before, the normal and the length of the path up to that hit. A ray into the sky counts with the sky
+// color as albedo, no normal and miss_depth.
+struct pixel_features {
+  static constexpr real miss_depth = 1e4;
+
+  color albedo = color(0, 0, 0);
+  vec3 normal = vec3(0, 0, 0);
+  real depth = 0;
+
+  void add(const color& sample_albedo, const vec3& sample_normal, real sample_depth) {
+    albedo += sample_albedo;
+    normal += sample_normal;
+    depth += sample_depth;
+  }
+};
+
+struct denoise_settings {
+  // passes of the filter with the tap distances 1, 2, 4, ..., the footprint is 4 * 2^iterations + 1 pixels wide
+  uint32_t iterations = 5;
+  // edge stopping: a neighbour counts less the more its value differs, the color sigma is halved every pass
+  float sigma_color = 1.f;
+  float sigma_normal = 0.3f;
+  float sigma_depth = 0.05f;  // relative to the depth of the pixel
+  float sigma_albedo = 0.1f;
+};
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al., HPG 2010) guided by the pixel_features. Every pass is a 5x5
+// B3 spline kernel with holes, the distance of its taps doubles from pass to pass, so a few passes cover a large
+// footprint with 25 taps per pixel and pass. The weight of a tap is the kernel weight times
+// exp(-color, normal, depth and albedo distance), so the filter blurs the noise but not across geometric edges.
+// The color is divided by the albedo before filtering and multiplied afterwards, the filter smoothes only the
+// lighting and the albedo edges and textures stay sharp.
+// The buffers are float planes, the taps of a row are one loop over contiguous pixels which the compiler vectorizes.
+// The rows are filtered in parallel by the thread pool.
+class atrousDenoiser {
+ public:
+  explicit atrousDenoiser(const denoise_settings& settings = denoise_settings()) : settings_(settings) {}
+
+  const denoise_settings& settings() const { return settings_; }
+
+  // Mean colors of the pixels, filtered. estimates and features are indexed with j * width + i like the pixel
+  // estimates of the renderer.
+  std::vector<color> filter(size_t width, size_t height, const std::vector<pixel_estimate>& estimates,
+                            const std::vector<pixel_features>& features, threadPool& pool);
+
+  // run time of the last filter call [s]
+  double last_time() const { return last_time_; }
+
+ private:
+  denoise_settings settings_;
+  double last_time_ = 0.;
+
+  // planes of the filter, reused by the next frame
+  std::vector<float> color_[2][3];
+  std::vector<float> albedo_[3];
+  std::vector<float> normal_[3];
+  std::vector<float> depth_;
+  std::vector<float> depth_scale_;  // 1 / (sigma_depth * depth)
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "color.h"
+#include "sampler.h"
+#include "scene.h"
+#include "tile_scheduler.h"
+
+// one frame of an animation: the camera of the scene moved to lookfrom
+struct frame_job {
+  uint64_t frame;  // frame number of the random streams, see raytrace::set_frame
+  point3 lookfrom;
+  std::string filename;
+};
+
+struct distributed_settings {
+  size_t workers = 2;
+  // frames with more than tile_size^2 pixels are split into tiles of tile_size x tile_size pixels
+  uint32_t tile_size = 256;
+  // jobs sent to a worker before its first result arrives, hides the round trip of the results
+  size_t jobs_per_worker = 2;
+  // a job is given up after it was sent to that many failed workers
+  size_t max_attempts = 3;
+  // render threads of every worker, 0: the hardware threads shared by the workers
+  size_t threads_per_worker = 0;
+  // a worker without a result for that long is killed and its jobs are retried, 0: no timeout [s]
+  double job_timeout = 0.;
+  // argv of the worker, it speaks the protocol on stdin and stdout
+  std::vector<std::string> worker_command;
+  // for tests of the retries: the first worker exits after this many jobs, 0: never
+  size_t fail_after = 0;
+  // see raytrace::set_roulette_depth, the default of the raytracer if not set
+  std::optional<uint32_t> roulette_depth;
+  // see raytrace::set_sampler
+  sampler_type sampler = sampler_type::independent;
+};
+
+// Renders the frames of an animation with worker processes. The coordinator starts the workers, sends them the scene
+// and hands out the frames or, for large frames, their tiles. The workers render the jobs with their own thread pool
+// and send back the linear float pixels, the coordinator assembles the frames. The jobs of a worker which dies, closes
+// the connection or runs into the timeout are sent to the other workers.
+// The pixels of a job depend only on frame, pixel and sample number, so the frames are the same as the frames of a
+// single process.
+// The messages are a header with the type and the payload size followed by the payload, in the native byte order of
+// the machine. The first message to a worker is the scene in the text format of sceneLoader. Errors throw
+// std::runtime_error.
+class distributedRender {
+ public:
+  struct worker_stats {
+    pid_t pid = 0;
+    size_t jobs = 0;
+    size_t pixels = 0;
+    double render_time = 0.;  // time the worker spent rendering [s]
+    bool failed = false;
+  };
+
+  struct run_stats {
+    double wall_time = 0.;  // [s]
+    size_t frames = 0;
+    size_t jobs = 0;
+    size_t retried = 0;  // jobs sent again after a worker failed
+    std::vector<worker_stats> workers;
+
+    // render time of all workers / (workers * wall time), 1.0 if the workers were never idle
+    double efficiency() const;
+  };
+
+  using frame_callback = std::function<void(ImageWrapper image, const frame_job& job)>;
+
+  // starts the workers
+  distributedRender(const scene& s, const distributed_settings& settings);
+  // stops the workers
+  ~distributedRender();
+
+  distributedRender(const distributedRender&) = delete;
+  distributedRender& operator=(const distributedRender&) = delete;
+
+  // Renders the frames, on_frame is called with every finished frame in the order they are finished.
+  void render(const std::vector<frame_job>& frames, const frame_callback& on_frame);
+
+  const run_stats& stats() const { return stats_; }
+
+  // Main loop of a worker process, returns the exit code.
+  static int worker_main(int in, int out);
+
+ private:
+  struct job {
+    size_t frame_index;
+    tile region;
+    size_t attempts = 0;
+  };
+
+  struct worker {
+    int fd = -1;
+    pid_t pid = 0;
+    std::deque<uint64_t> in_flight;  // ids of the sent jobs, answered in this order
+    double last_progress = 0.;       // time of the last result or of the first job after idling [s]
+    bool alive = false;
+  };
+
+  struct frame_buffer {
+    std::vector<float> pixels;  // rows from bottom to top like the pixel indices of the raytracer
+    size_t missing_tiles = 0;
+  };
+
+  void start_worker(size_t index, const std::string& scene_text);
+  void send_job(size_t worker_index, uint64_t job_id);
+  void receive_result(size_t worker_index, const frame_callback& on_frame);
+  void fail_worker(size_t worker_index, const std::string& reason);
+  void stop_worker(worker& w, bool kill);
+
+  distributed_settings settings_;
+  render_settings render_settings_;
+  std::vector<worker> workers_;
+  std::vector<job> jobs_;
+  std::deque<uint64_t> pending_;
+  std::map<size_t, frame_buffer> frames_in_progress_;
+  const std::vector<frame_job>* frames_ = nullptr;
+  run_stats stats_;
+};
+
+#endif
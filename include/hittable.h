@@ -1,16 +1,17 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include <cstdint>
 #include <memory>
-#include "ray.h"
 
-class material;
+#include "aabb.h"
+#include "ray.h"
 
 struct hit_record {
   point3 p;
   vec3 normal;
-  std::shared_ptr<material> mat_ptr;
-  double t;
+  uint32_t mat_index;  // index into the material_table of the scene
+  real t;
   bool front_face;
 
   inline void set_face_normal(const ray& r, const vec3& outward_normal) {
@@ -21,7 +22,15 @@ struct hit_record {
 
 class hittable {
  public:
-  virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
+  virtual ~hittable() {}
+
+  virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const = 0;
+  // true if anything is hit in (t_min, t_max), for shadow rays. Can stop at the first hit instead of the closest.
+  virtual bool occluded(const ray& r, real t_min, real t_max) const {
+    hit_record rec;
+    return hit(r, t_min, t_max, rec);
+  }
+  virtual bool bounding_box(aabb& output_box) const = 0;
 };
 
 #endif
\ No newline at end of file
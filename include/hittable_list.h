@@ -14,7 +14,9 @@ class hittable_list : public hittable {
   void clear() { objects.clear(); }
   void add(std::shared_ptr<hittable> object) { objects.push_back(object); }
 
-  virtual bool hit(const ray& r, double tmin, double tmax, hit_record& rec) const;
+  virtual bool hit(const ray& r, real tmin, real tmax, hit_record& rec) const;
+  virtual bool occluded(const ray& r, real t_min, real t_max) const;
+  virtual bool bounding_box(aabb& output_box) const;
 
  public:
   std::vector<std::shared_ptr<hittable>> objects;
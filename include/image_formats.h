@@ -0,0 +1,38 @@
+#ifndef IMAGE_FORMATS_H
+#define IMAGE_FORMATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// File formats of the images
+//   png: 8 bit, only with png++
+//   p3:  8 bit text netpbm
+//   p6:  8 bit binary netpbm
+//   pfm: 32 bit float, linear
+//   hdr: Radiance RGBE with run length encoded scanlines, linear
+// The 8 bit formats are gamma corrected (gamma 2), the HDR formats keep the linear values.
+enum class image_type { png, p3, p6, pfm, hdr };
+
+#ifdef USE_PNG
+constexpr image_type default_image_type = image_type::png;
+#else
+constexpr image_type default_image_type = image_type::p6;
+#endif
+
+class imageEncoder {
+ public:
+  // Encodes the linear RGB pixels (3 floats per pixel, rows from top to bottom) into the file content.
+  // The rows are encoded one by one into a buffer of the size of the file, so it can be written with one call.
+  static std::string encode(image_type type, uint32_t width, uint32_t height, const float* pixels);
+  // Decodes the content of a color PFM file into linear RGB pixels like the ones of encode, rows from top to bottom.
+  // Throws std::runtime_error if the content isn't a little endian color PFM.
+  static std::vector<float> decode_pfm(const std::string& content, uint32_t& width, uint32_t& height);
+
+  static image_type parse_type(const std::string& name);
+  static std::string type_name(image_type type);
+  // file name extension with the dot
+  static std::string extension(image_type type);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "color.h"
+
+// Encodes and writes images on background threads, so the render threads can start the next frame while the
+// previous one is compressed and written.
+// The queue is bounded: push() blocks while it is full, so a slow disk throttles the renderer instead of piling up
+// finished frames in memory.
+class imageWriter {
+ public:
+  struct frame_stats {
+    std::string filename;
+    double encode_time = 0.;  // [s]
+    double write_time = 0.;   // [s]
+  };
+
+  explicit imageWriter(size_t queue_capacity = 2, size_t num_threads = 1);
+  ~imageWriter();
+
+  imageWriter(const imageWriter&) = delete;
+  imageWriter& operator=(const imageWriter&) = delete;
+
+  // Queues the image and returns the time [s] spent waiting for a free slot.
+  // Rethrows the exception of a failed encode or write of an earlier image.
+  double push(ImageWrapper image);
+
+  // waits until all queued images are written, rethrows like push
+  void finish();
+
+  // stats of the written images in the order they were finished
+  std::vector<frame_stats> stats() const;
+
+ private:
+  void worker_loop();
+  void rethrow_error();
+
+  const size_t queue_capacity_;
+  std::vector<std::thread> workers_;
+  std::deque<ImageWrapper> queue_;
+  std::vector<frame_stats> stats_;
+  size_t in_progress_ = 0;
+  std::exception_ptr error_;
+  bool shutdown_ = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_condition_;
+  std::condition_variable space_condition_;
+};
+
+#endif
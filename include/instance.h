@@ -0,0 +1,48 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <cstdint>
+#include <memory>
+
+#include "affine_transform.h"
+#include "hittable.h"
+
+// Shared geometry placed in the world with an affine transform, e.g. one mesh in a thousand places. The instance
+// stores the geometry pointer, the world to object transform and a material, so the memory grows with the unique
+// geometry and not with the number of copies. A ray is transformed into object space without normalizing the
+// direction, so the t of the hit is the same in both spaces.
+class instance : public hittable {
+ public:
+  // mat_index of keep_material keeps the materials of the geometry
+  static constexpr uint32_t keep_material = UINT32_MAX;
+
+  // throws std::invalid_argument if object_to_world can't be inverted
+  instance(std::shared_ptr<const hittable> geometry, const affine_transform& object_to_world,
+           uint32_t mat_index = keep_material)
+      : geometry_(std::move(geometry)), world_to_object_(object_to_world.inverse()), mat_index_(mat_index) {}
+  virtual ~instance() {}
+
+  virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const;
+  virtual bool occluded(const ray& r, real t_min, real t_max) const;
+  virtual bool bounding_box(aabb& output_box) const;
+
+  const std::shared_ptr<const hittable>& geometry() const { return geometry_; }
+  const affine_transform& world_to_object() const { return world_to_object_; }
+  // computed from world_to_object, the instance doesn't store it
+  affine_transform object_to_world() const { return world_to_object_.inverse(); }
+  uint32_t mat_index() const { return mat_index_; }
+
+  // moves the instance, the bvh above it has to be updated, see bvh::update
+  void set_object_to_world(const affine_transform& object_to_world) { world_to_object_ = object_to_world.inverse(); }
+
+ private:
+  ray to_object(const ray& r) const {
+    return ray(world_to_object_.apply_point(r.origin()), world_to_object_.apply_vector(r.direction()));
+  }
+
+  std::shared_ptr<const hittable> geometry_;
+  affine_transform world_to_object_;
+  uint32_t mat_index_;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "hittable.h"
+#include "material.h"
+
+struct light_sample {
+  vec3 direction;  // unit vector from the shaded point to the light
+  real distance;   // along direction to the surface of the light
+  color emitted;
+  real pdf;  // solid angle density of direction, including the choice of the light
+};
+
+// Weight of a sample with density pdf which could also have been taken with other_pdf by the other strategy of
+// multiple importance sampling (Veach's power heuristic with beta = 2).
+inline real power_heuristic(real pdf, real other_pdf) {
+  const real p2 = pdf * pdf;
+  return p2 / (p2 + other_pdf * other_pdf);
+}
+
+// The spheres with a diffuse_light material of a world, sampled for next event estimation. A light is chosen
+// uniformly, then a direction uniformly in the cone of the sphere as seen from the shaded point. This hits the visible
+// cap of the sphere only, so even small or distant lights get samples with a low variance.
+class lightSampler {
+ public:
+  lightSampler() {}
+  // collects the lights of a sphere, a hittable_list or a bvh
+  lightSampler(const hittable& world, const material_table& materials);
+
+  bool empty() const { return lights_.empty(); }
+  size_t size() const { return lights_.size(); }
+
+  // Direction to a random point of a random light, uses three random numbers. Returns false if p is inside of the
+  // chosen light.
+  bool sample(const point3& p, light_sample& sample) const;
+
+  // Density with which sample from origin chooses the direction to the light point rec, 0 if rec is not on a light.
+  // The multiple importance weight of a scattered ray which hits a light.
+  real pdf(const point3& origin, const hit_record& rec) const;
+
+ private:
+  struct sphere_light {
+    point3 center;
+    real radius;
+    uint32_t mat_index;
+    color emit;
+  };
+
+  void collect(const hittable& object, const material_table& materials);
+  // 1 - cos of the half angle of the cone of the light as seen from p, 0 if p is inside of the light
+  static real cone_size(const sphere_light& light, const point3& p);
+
+  std::vector<sphere_light> lights_;
+};
+
+#endif
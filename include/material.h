@@ -1,22 +1,26 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <algorithm>
+#include <cstdint>
+#include <variant>
+#include <vector>
+
 #include "hittable.h"
 #include "ray.h"
+#include "trace_stats.h"
 
-extern double schlick(double cosine, double ref_idx);
+extern real schlick(real cosine, real ref_idx);
 
-class material {
- public:
-  virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
-};
+// Besides scatter every material has pdf(r_in, rec, direction), the solid angle density with which scatter chooses
+// direction, 0 for the directions it never chooses and for the single directions of mirrors and glass. The BRDF times
+// cosine of the diffuse materials is attenuation * pdf, which next event estimation uses to weight a light sample.
 
-class lambertian : public material {
+class lambertian {
  public:
   lambertian(const color& a) : albedo(a) {}
-  virtual ~lambertian() {};
 
-  virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+  bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
     static_cast<void>(r_in); // not used
 
     vec3 scatter_direction = rec.normal + random_unit_vector();
@@ -25,47 +29,73 @@ class lambertian : public material {
     return true;
   }
 
+  // normal + random_unit_vector is distributed with cos / pi
+  real pdf(const ray& /*r_in*/, const hit_record& rec, const vec3& direction) const {
+    const real cosine = dot(unit_vector(direction), rec.normal);
+    return cosine > 0 ? cosine / pi : 0;
+  }
+
  public:
   color albedo;
 };
 
-class metal : public material {
+class metal {
  public:
-  metal(const color& a, double f = 0.) : albedo(a), fuzz(f < 1 ? f : 1) {}
-  virtual ~metal() {};
+  metal(const color& a, real f = 0.) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
-  virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+  bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
     vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
     scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
     attenuation = albedo;
     return (dot(scattered.direction(), rec.normal) > 0);
   }
 
+  // The end point of the scattered direction is uniform in the ball of radius fuzz around the reflected direction, so
+  // the density of a direction is the volume of the ball along it: (t2^3 - t1^3) / 3 over the ball volume, t1 and t2
+  // are where the direction enters and leaves the ball. The directions below the surface are absorbed.
+  real pdf(const ray& r_in, const hit_record& rec, const vec3& direction) const {
+    if (fuzz <= 0) return 0;
+
+    const vec3 unit_direction = unit_vector(direction);
+    if (dot(unit_direction, rec.normal) <= 0) return 0;
+
+    const vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
+    const real b = dot(unit_direction, reflected);
+    const real discriminant = b * b - 1 + fuzz * fuzz;
+    if (discriminant <= 0) return 0;
+
+    const real root = std::sqrt(discriminant);
+    const real t1 = std::max(b - root, real(0));
+    const real t2 = b + root;
+    if (t2 <= 0) return 0;
+    return (t2 * t2 * t2 - t1 * t1 * t1) / (4 * pi * fuzz * fuzz * fuzz);
+  }
+
  public:
   color albedo;
-  double fuzz;
+  real fuzz;
 };
 
-class dielectric : public material {
+class dielectric {
  public:
-  dielectric(double ri) : ref_idx(ri) {}
-  virtual ~dielectric() {};
+  dielectric(real ri) : ref_idx(ri) {}
 
-  virtual bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
-    attenuation = color(1.0, 1.0, 1.0);
-    double etai_over_etat = (rec.front_face) ? (1.0 / ref_idx) : (ref_idx);
+  bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+    attenuation = color(1, 1, 1);
+    real etai_over_etat = (rec.front_face) ? (1 / ref_idx) : (ref_idx);
 
     vec3 unit_direction = unit_vector(r_in.direction());
-    double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-    double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
-    if (etai_over_etat * sin_theta > 1.0) {
+    real cos_theta = std::min(dot(-unit_direction, rec.normal), real(1));
+    real sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+    if (etai_over_etat * sin_theta > 1) {
+      TRACE_COUNT(total_internal_reflections);
       vec3 reflected = reflect(unit_direction, rec.normal);
       scattered = ray(rec.p, reflected);
       return true;
     }
 
-    double reflect_prob = schlick(cos_theta, etai_over_etat);
-    if (random_double() < reflect_prob) {
+    real reflect_prob = schlick(cos_theta, etai_over_etat);
+    if (random_real() < reflect_prob) {
       vec3 reflected = reflect(unit_direction, rec.normal);
       scattered = ray(rec.p, reflected);
       return true;
@@ -76,8 +106,86 @@ class dielectric : public material {
     return true;
   }
 
+  real pdf(const ray&, const hit_record&, const vec3&) const { return 0; }
+
+ public:
+  real ref_idx;
+};
+
+// Emits radiance from the front side and absorbs everything. Spheres with this material are the lights of
+// next event estimation, see lightSampler.
+class diffuse_light {
  public:
-  double ref_idx;
+  diffuse_light(const color& e) : emit(e) {}
+
+  bool scatter(const ray&, const hit_record&, color&, ray&) const { return false; }
+  real pdf(const ray&, const hit_record&, const vec3&) const { return 0; }
+
+  color emitted(const hit_record& rec) const { return rec.front_face ? emit : color(0, 0, 0); }
+
+ public:
+  color emit;
+};
+
+// The materials are stored by value in one contiguous table and are referenced by their index. The variant
+// replaces the virtual call of scatter by a switch over the alternatives, which the compiler can inline.
+using material = std::variant<lambertian, metal, dielectric, diffuse_light>;
+
+// same order as the alternatives of material, lets batched renderers group the hits by material
+enum class material_type : uint8_t { lambertian, metal, dielectric, light, count };
+
+inline material_type type_of(const material& mat) { return static_cast<material_type>(mat.index()); }
+
+inline bool scatter(const material& mat, const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) {
+  return std::visit([&](const auto& m) { return m.scatter(r_in, rec, attenuation, scattered); }, mat);
+}
+
+inline real scatter_pdf(const material& mat, const ray& r_in, const hit_record& rec, const vec3& direction) {
+  return std::visit([&](const auto& m) { return m.pdf(r_in, rec, direction); }, mat);
+}
+
+// BRDF times cosine for direction, 0 for the materials without a density
+inline color scatter_eval(const material& mat, const ray& r_in, const hit_record& rec, const vec3& direction) {
+  if (const auto* m = std::get_if<lambertian>(&mat)) return m->albedo * m->pdf(r_in, rec, direction);
+  if (const auto* m = std::get_if<metal>(&mat)) return m->albedo * m->pdf(r_in, rec, direction);
+  return color(0, 0, 0);
+}
+
+// false for the materials which scatter into single directions (mirrors, glass) or not at all (lights), a light
+// sample can't hit their directions
+inline bool has_scatter_density(const material& mat) {
+  if (std::holds_alternative<lambertian>(mat)) return true;
+  if (const auto* m = std::get_if<metal>(&mat)) return m->fuzz > 0;
+  return false;
+}
+
+inline color emitted(const material& mat, const hit_record& rec) {
+  const auto* light = std::get_if<diffuse_light>(&mat);
+  return light ? light->emitted(rec) : color(0, 0, 0);
+}
+
+// reflectance of the surface for the guide buffers of the denoiser, white for glass and lights
+inline color surface_albedo(const material& mat) {
+  if (const auto* m = std::get_if<lambertian>(&mat)) return m->albedo;
+  if (const auto* m = std::get_if<metal>(&mat)) return m->albedo;
+  return color(1, 1, 1);
+}
+
+class material_table {
+ public:
+  // returns the index which is stored in the objects and hit records
+  uint32_t add(const material& mat) {
+    materials_.push_back(mat);
+    return static_cast<uint32_t>(materials_.size() - 1);
+  }
+
+  const material& operator[](uint32_t index) const { return materials_[index]; }
+  size_t size() const { return materials_.size(); }
+  void reserve(size_t size) { materials_.reserve(size); }
+  void clear() { materials_.clear(); }
+
+ private:
+  std::vector<material> materials_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef OBJECT_ARENA_H
+#define OBJECT_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bump allocator for the objects of a scene, replaces one make_shared per object.
+// Objects of the same type are placed one after the other in blocks of that type. After reserve() for the number of
+// objects the whole scene is in a single block.
+// make() returns shared_ptrs which alias the arena: they share the reference count of the arena instead of having
+// their own, so they need no allocation and the arena is freed with the last object of the scene.
+class objectArena : public std::enable_shared_from_this<objectArena> {
+ public:
+  static std::shared_ptr<objectArena> create() { return std::shared_ptr<objectArena>(new objectArena()); }
+
+  objectArena(const objectArena&) = delete;
+  objectArena& operator=(const objectArena&) = delete;
+
+  // space for count more objects of type T in one block
+  template <class T>
+  void reserve(size_t count) {
+    get_pool<T>().reserve(count);
+  }
+
+  template <class T, class... ARGS>
+  std::shared_ptr<T> make(ARGS&&... args) {
+    T* object = get_pool<T>().construct(std::forward<ARGS>(args)...);
+    return std::shared_ptr<T>(shared_from_this(), object);
+  }
+
+  // bytes of all blocks
+  size_t capacity_bytes() const {
+    size_t bytes = 0;
+    for (const auto& pool : pools_) {
+      bytes += pool.second->capacity_bytes();
+    }
+    return bytes;
+  }
+
+ private:
+  objectArena() = default;
+
+  class pool_base {
+   public:
+    virtual ~pool_base() = default;
+    virtual size_t capacity_bytes() const = 0;
+  };
+
+  template <class T>
+  class pool : public pool_base {
+   public:
+    virtual ~pool() {
+      for (auto block = blocks_.rbegin(); block != blocks_.rend(); ++block) {
+        for (size_t i = block->size; i-- > 0;) {
+          block->data[i].~T();
+        }
+        std::allocator<T>().deallocate(block->data, block->capacity);
+      }
+    }
+
+    virtual size_t capacity_bytes() const {
+      size_t bytes = 0;
+      for (const auto& block : blocks_) {
+        bytes += block.capacity * sizeof(T);
+      }
+      return bytes;
+    }
+
+    void reserve(size_t count) {
+      if (blocks_.empty() || blocks_.back().capacity - blocks_.back().size < count) add_block(count);
+    }
+
+    template <class... ARGS>
+    T* construct(ARGS&&... args) {
+      // the blocks grow geometrically if nothing was reserved
+      if (blocks_.empty() || blocks_.back().size == blocks_.back().capacity) {
+        add_block(blocks_.empty() ? min_block_size : 2 * blocks_.back().capacity);
+      }
+      block& current = blocks_.back();
+      T* object = new (current.data + current.size) T(std::forward<ARGS>(args)...);
+      current.size++;
+      return object;
+    }
+
+   private:
+    struct block {
+      T* data;
+      size_t size;
+      size_t capacity;
+    };
+
+    void add_block(size_t capacity) {
+      capacity = std::max(capacity, min_block_size);
+      if (!blocks_.empty() && blocks_.back().size == 0) {
+        std::allocator<T>().deallocate(blocks_.back().data, blocks_.back().capacity);
+        blocks_.pop_back();
+      }
+      blocks_.push_back({std::allocator<T>().allocate(capacity), 0, capacity});
+    }
+
+    static constexpr size_t min_block_size = 64;
+    std::vector<block> blocks_;
+  };
+
+  template <class T>
+  pool<T>& get_pool() {
+    auto& entry = pools_[std::type_index(typeid(T))];
+    if (!entry) entry = std::make_unique<pool<T>>();
+    return static_cast<pool<T>&>(*entry);
+  }
+
+  std::unordered_map<std::type_index, std::unique_ptr<pool_base>> pools_;
+};
+
+#endif
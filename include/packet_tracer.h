@@ -0,0 +1,112 @@
+#ifndef PACKET_TRACER_H
+#define PACKET_TRACER_H
+
+#include <memory>
+
+#include "bvh.h"
+#include "sphere_soa.h"
+
+// Traces packets of coherent rays together through the bvh. A node is entered if any lane of the packet hits it,
+// the leaves are intersected with the SIMD kernels of sphere_soa.
+class packetTracer {
+ public:
+  // all objects of the bvh have to be spheres
+  packetTracer(std::shared_ptr<const bvh> world) : world_(world), spheres_(world->objects()) {}
+
+  // Finds the closest hit in (t_min, hit.t) for all lanes, hit has to be reset before
+  template <size_t N>
+  void intersect(const ray_packet<N>& packet, double t_min, packet_hit<N>& hit, bool use_simd = true) const;
+
+  const sphere_soa& spheres() const { return spheres_; }
+
+ private:
+  template <size_t N>
+  static bool any_lane_hits(const bvh_node& node, const ray_packet<N>& packet, const double inv_dir[3][N],
+                            double t_min, const packet_hit<N>& hit);
+
+  std::shared_ptr<const bvh> world_;
+  sphere_soa spheres_;
+};
+
+template <size_t N>
+bool packetTracer::any_lane_hits(const bvh_node& node, const ray_packet<N>& packet, const double inv_dir[3][N],
+                                 double t_min, const packet_hit<N>& hit) {
+  bool any_hit = false;
+
+  for (size_t lane = 0; lane < N; lane++) {
+    double t_entry = t_min;
+    double t_exit = hit.t[lane];
+    for (int a = 0; a < 3; a++) {
+      double t0 = (node.bounds_min[a] - packet.origin[a][lane]) * inv_dir[a][lane];
+      double t1 = (node.bounds_max[a] - packet.origin[a][lane]) * inv_dir[a][lane];
+      t_entry = std::max(t_entry, std::min(t0, t1));
+      t_exit = std::min(t_exit, std::max(t0, t1));
+    }
+    any_hit |= (t_entry <= t_exit);
+  }
+
+  return any_hit;
+}
+
+template <size_t N>
+void packetTracer::intersect(const ray_packet<N>& packet, double t_min, packet_hit<N>& hit, bool use_simd) const {
+  const bvh_tree& tree = world_->tree();
+  if (tree.empty()) return;
+  const bvh_node* nodes = tree.nodes();
+
+  alignas(64) double inv_dir[3][N];
+  for (int a = 0; a < 3; a++) {
+    for (size_t lane = 0; lane < N; lane++) {
+      double d = packet.direction[a][lane];
+      inv_dir[a][lane] = 1.0 / (std::abs(d) > 1e-12 ? d : std::copysign(1e-12, d));
+    }
+  }
+
+  uint32_t node_stack[bvh_tree::max_depth];
+  size_t stack_size = 0;
+  uint32_t node_index = 0;
+
+  if (!any_lane_hits(nodes[0], packet, inv_dir, t_min, hit)) return;
+
+  while (true) {
+    const bvh_node& node = nodes[node_index];
+
+    if (node.is_leaf()) {
+      for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+        if (use_simd) {
+          spheres_.intersect(i, packet, t_min, hit);
+        } else {
+          spheres_.intersect_scalar(i, packet, t_min, hit);
+        }
+      }
+    } else {
+      // coherent rays share the direction signs, so the first lane decides the front-to-back order
+      uint32_t near_index = node_index + 1;
+      uint32_t far_index = node.offset;
+      if (packet.direction[node.axis][0] < 0) std::swap(near_index, far_index);
+
+      bool hit_near = any_lane_hits(nodes[near_index], packet, inv_dir, t_min, hit);
+      bool hit_far = any_lane_hits(nodes[far_index], packet, inv_dir, t_min, hit);
+
+      if (hit_near && hit_far) {
+        node_stack[stack_size++] = far_index;
+        node_index = near_index;
+        continue;
+      } else if (hit_near) {
+        node_index = near_index;
+        continue;
+      } else if (hit_far) {
+        node_index = far_index;
+        continue;
+      }
+    }
+
+    // the hits of the near node might have moved all lanes in front of the far node
+    do {
+      if (stack_size == 0) return;
+      node_index = node_stack[--stack_size];
+    } while (!any_lane_hits(nodes[node_index], packet, inv_dir, t_min, hit));
+  }
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+
+// Hardware counters of the process with perf_event_open, only on Linux. The counters are inherited by the threads
+// started after the constructor, so a thread pool which should be counted has to be created after it. Events which the
+// kernel or the CPU don't offer (no PMU in a VM, perf_event_paranoid, container without CAP_PERFMON) are unavailable
+// and read as 0.
+class perfCounters {
+ public:
+  enum event { instructions, l1d_misses, llc_misses, event_count };
+  using values = std::array<uint64_t, event_count>;
+
+  perfCounters();
+  ~perfCounters();
+
+  perfCounters(const perfCounters&) = delete;
+  perfCounters& operator=(const perfCounters&) = delete;
+
+  bool available(event e) const { return fds_[e] >= 0; }
+  bool any_available() const;
+
+  // resets and enables the counters
+  void start();
+  // disables the counters and returns the events since start
+  values stop();
+
+  static const char* name(event e);
+
+ private:
+  std::array<int, event_count> fds_;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "color.h"
+#include "raytrace.h"
+
+// Progressive rendering: passes of samples_per_pixel samples of the raytracer are added to a linear float
+// accumulation buffer, so the image can be refined as long as wanted.
+// Every pass is rendered as its own frame, numbered by the seed and the pass number. A checkpoint with the buffer, the
+// number of passes and the seed therefore contains the complete state, a resumed render continues exactly like an
+// uninterrupted one.
+class progressiveRender {
+ public:
+  progressiveRender(raytrace& raytracer, uint64_t seed = 1);
+
+  void add_pass(const camera& cam);
+
+  size_t passes() const { return passes_; }
+  size_t samples_per_pixel() const { return samples_; }
+
+  // 8 bit image of the current state, e.g. for previews
+  ImageWrapper image(const std::string& filename, image_type type = default_image_type) const;
+
+  // throw std::runtime_error if the file can't be written or read or doesn't match the image size
+  void save_checkpoint(const std::string& filename) const;
+  void load_checkpoint(const std::string& filename);
+
+ private:
+  raytrace& raytracer_;
+  uint64_t seed_;
+  size_t passes_ = 0;
+  size_t samples_ = 0;
+  std::vector<float> accumulation_;  // linear RGB sum of all samples, 3 floats per pixel
+};
+
+#endif
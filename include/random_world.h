@@ -2,10 +2,12 @@
 #define RANDOM_WORLD_H
 
 #include "hittable_list.h"
+#include "material.h"
 
 class randomWorld {
  public:
-  static hittable_list generate_random_scene();
+  // the small spheres are placed on a grid from -grid_extent to grid_extent, their materials are added to materials
+  static hittable_list generate_random_scene(material_table& materials, int grid_extent = 11);
 };
 
 #endif
\ No newline at end of file
@@ -5,75 +5,523 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
 
+#include "adaptive_sampling.h"
+#include "bvh.h"
+#include "camera.h"
 #include "color.h"
+#include "denoiser.h"
+#include "hittable.h"
+#include "lights.h"
+#include "material.h"
+#include "packet_tracer.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
+#include "trace_stats.h"
 
 class raytrace {
  public:
-  raytrace(hittable_list world, size_t image_width, size_t image_height, size_t samples_per_pixel, uint8_t max_depth)
+  raytrace(std::shared_ptr<hittable> world, std::shared_ptr<const material_table> materials, size_t image_width,
+           size_t image_height, size_t samples_per_pixel, uint8_t max_depth,
+           std::shared_ptr<threadPool> pool = std::make_shared<threadPool>())
       : world_(world),
+        materials_(materials),
         image_width_(image_width),
         image_height_(image_height),
         samples_per_pixel_(samples_per_pixel),
-        max_depth_(max_depth) {}
+        max_depth_(max_depth),
+        pool_(pool),
+        lights_(*world, *materials) {
+    set_tiles(default_tile_size, tile_order::hilbert);
+  }
+
+  void set_tiles(uint32_t tile_size, tile_order order) {
+    tiles_ = tileScheduler::generate(image_width_, image_height_, tile_size, order);
+  }
+
+  threadPool& thread_pool() { return *pool_; }
+  const hittable& world() const { return *world_; }
+  const material_table& materials() const { return *materials_; }
+
+  size_t image_width() const { return image_width_; }
+  size_t image_height() const { return image_height_; }
+  size_t samples_per_pixel() const { return samples_per_pixel_; }
+
+  // The random numbers of every pixel sample are keyed by frame, pixel, sample and bounce, so a frame is reproducible
+  // and doesn't depend on the number of threads. Frames with the same number get the same noise.
+  void set_frame(uint64_t frame) { frame_ = frame; }
+
+  // Sequence of the random numbers of the pixel samples, see sampler_type. The low discrepancy samplers need fewer
+  // samples for the same error; the wavefront renderer always uses the independent numbers.
+  void set_sampler(sampler_type sampler) { sampler_ = sampler; }
+  sampler_type sampler() const { return sampler_; }
+
+  // Adaptive sampling: converged pixels stop early, the saved samples go to the noisy pixels.
+  // The average number of samples per pixel stays samples_per_pixel.
+  void set_adaptive(const adaptive_settings& settings) { adaptive_ = settings; }
+
+  // color sums and sample counts of the pixels of the last call of render
+  const std::vector<pixel_estimate>& pixel_estimates() const { return estimates_; }
+
+  // Guide buffers of the denoiser, rendered next to the pixel estimates while enabled. Off by default.
+  void set_features(bool enabled) {
+    features_enabled_ = enabled;
+    if (!enabled) features_.clear();
+  }
+  const std::vector<pixel_features>& features() const { return features_; }
+
+  // calcImage filters the frame with the a-trous denoiser guided by the features, std::nullopt switches it off
+  void set_denoiser(const std::optional<denoise_settings>& settings) {
+    denoiser_.reset();
+    if (settings) denoiser_.emplace(*settings);
+    set_features(settings.has_value());
+  }
+  const atrousDenoiser* denoiser() const { return denoiser_ ? &*denoiser_ : nullptr; }
 
   ImageWrapper calcImage(const camera& cam, std::string image_filename, bool do_log) {
     ImageWrapper image(image_filename, image_width_, image_height_);
 
-#pragma omp parallel for
-    for (size_t j = 0; j < image_height_; j++) {
-      if (do_log) {
-        std::cout << "Line " << j << " / " << image_height_ << "\r" << std::flush;
+    render(cam);
+
+    if (denoiser_) {
+      const std::vector<color> colors = denoiser_->filter(image_width_, image_height_, estimates_, features_, *pool_);
+      for (size_t j = 0; j < image_height_; j++) {
+        for (size_t i = 0; i < image_width_; i++) {
+          image.write_color(i, j, colors[j * image_width_ + i], 1);
+        }
+      }
+    } else {
+      for (size_t j = 0; j < image_height_; j++) {
+        for (size_t i = 0; i < image_width_; i++) {
+          const pixel_estimate& estimate = estimates_[j * image_width_ + i];
+          image.write_color(i, j, estimate.sum, estimate.count);
+        }
       }
-      for (size_t i = 0; i < image_width_; ++i) {
-        color pixel_color = calcPixel(cam, i, j, samples_per_pixel_);
+    }
 
-        image.write_color(i, j, pixel_color, samples_per_pixel_);
-      };
-    };
+    if (do_log) {
+      pool_->print_stats(std::cout);
+    }
 
     return image;
   }
 
-  color calcPixel(const camera& cam, size_t i, size_t j, size_t samples_per_pixel) {
+  // Renders the frame into pixel_estimates(), index of pixel (i, j) is j * image_width + i
+  void render(const camera& cam) {
+    reset_estimates();
+
+    if (!adaptive_.enabled) {
+      render_tiles(cam, tiles_);
+    } else {
+      renderAdaptive(cam);
+    }
+  }
+
+  // Renders only the pixels of the region with samples_per_pixel samples, the other estimates stay empty.
+  // The pixels are the same as in a render of the whole frame, so a frame can be assembled from regions.
+  void render(const camera& cam, const tile& region) {
+    if (region.x1 > image_width_ || region.y1 > image_height_ || region.x0 >= region.x1 || region.y0 >= region.y1) {
+      throw std::invalid_argument("region outside of the image");
+    }
+    std::vector<tile> tiles = tileScheduler::generate(region.x1 - region.x0, region.y1 - region.y0, default_tile_size,
+                                                      tile_order::hilbert);
+    for (tile& t : tiles) {
+      t = tile{t.x0 + region.x0, t.y0 + region.y0, t.x1 + region.x0, t.y1 + region.y0};
+    }
+
+    reset_estimates();
+    render_tiles(cam, tiles);
+  }
+
+  // Renders samples[index] samples into the pixel with the index, pixels with 0 samples stay empty
+  void render_samples(const camera& cam, const std::vector<uint32_t>& samples) {
+    reset_estimates();
+    sample_pixels(cam, samples);
+  }
+
+  // Next event estimation: every diffuse bounce samples a direction to a light and traces a shadow ray to it. The
+  // light sample and the scattered ray which hits a light are combined by multiple importance sampling. On by
+  // default, it changes nothing in scenes without diffuse_light spheres.
+  void set_light_sampling(bool enabled) { light_sampling_ = enabled; }
+  bool light_sampling() const { return light_sampling_; }
+  const lightSampler& lights() const { return lights_; }
+
+  // constant background color instead of the sky gradient, e.g. black for scenes lit only by their lights
+  void set_background(const std::optional<color>& background) { background_ = background; }
+
+  // Russian roulette for the paths after depth rays, 0 switches it off
+  void set_roulette_depth(uint32_t depth) { roulette_depth_ = depth; }
+  uint32_t roulette_depth() const { return roulette_depth_; }
+
+  // Updates the renderer after objects of the world moved: refits the world if it is a bvh (see bvh::update), collects
+  // the lights again and copies the spheres of packet tracing again.
+  bvh_update_stats update_world(const bvh_update_settings& settings = bvh_update_settings()) {
+    bvh_update_stats stats;
+    if (auto world_bvh = std::dynamic_pointer_cast<bvh>(world_)) {
+      stats = world_bvh->update(*pool_, settings);
+      if (packet_tracer_) packet_tracer_ = std::make_shared<packetTracer>(world_bvh);
+    }
+    lights_ = lightSampler(*world_, *materials_);
+    return stats;
+  }
+
+  // Traces the primary rays in packets of packet_size (4, 8 or 16) rays through a SIMD sphere store,
+  // 0 switches back to single rays. The world has to be a bvh of spheres.
+  void set_packet_size(size_t packet_size) {
+    if (packet_size != 0 && packet_size != 4 && packet_size != 8 && packet_size != 16) {
+      throw std::invalid_argument("packet size has to be 0, 4, 8 or 16");
+    }
+    if (packet_size != 0 && !packet_tracer_) {
+      auto world_bvh = std::dynamic_pointer_cast<const bvh>(world_);
+      if (!world_bvh) throw std::invalid_argument("packet tracing needs a bvh as world");
+      packet_tracer_ = std::make_shared<packetTracer>(world_bvh);
+    }
+    packet_size_ = packet_size;
+  }
+
+  // sum of the samples first_sample to first_sample + samples_per_pixel of pixel (i, j), the guide buffers of the
+  // samples are added to features if it isn't nullptr
+  color calcPixel(const camera& cam, size_t i, size_t j, size_t samples_per_pixel, size_t first_sample = 0,
+                  pixel_features* features = nullptr) {
+    switch (packet_size_) {
+      case 4:
+        return calcPixelPacket<4>(cam, i, j, samples_per_pixel, first_sample, features);
+      case 8:
+        return calcPixelPacket<8>(cam, i, j, samples_per_pixel, first_sample, features);
+      case 16:
+        return calcPixelPacket<16>(cam, i, j, samples_per_pixel, first_sample, features);
+      default:
+        break;
+    }
+
     color pixel_color(0, 0, 0);
 
-    for (size_t s = 0; s < samples_per_pixel; s++) {
-      double u = (i + random_double()) / (image_width_ - 1);
-      double v = (j + random_double()) / (image_height_ - 1);
+    traceStats::local().paths += samples_per_pixel;
+    for (size_t s = first_sample; s < first_sample + samples_per_pixel; s++) {
+      random_sample(sampler_, sample_of(i, j, s));
+      real u = (i + random_real()) / (image_width_ - 1);
+      real v = (j + random_real()) / (image_height_ - 1);
       ray r = cam.get_ray(u, v);
-      pixel_color += ray_color(r, world_, max_depth_);
+      pixel_color += ray_color(r, nullptr, features);
     }
 
     return pixel_color;
   }
 
-  color ray_color(const ray& r, const hittable& world, uint8_t depth) {
+  // The samples of one pixel are traced together, they are as coherent as primary rays can be.
+  // Only the primary hits use the packet, the scattered rays continue as single rays.
+  template <size_t N>
+  color calcPixelPacket(const camera& cam, size_t i, size_t j, size_t samples_per_pixel, size_t first_sample,
+                        pixel_features* features) {
+    color pixel_color(0, 0, 0);
+    ray_packet<N> packet;
+    packet_hit<N> hit;
+    ray rays[N];
+    uint64_t keys[N];
+    real jitter_u[N];
+    real jitter_v[N];
+
+    const size_t pixel = j * image_width_ + i;
+    for (size_t s = 0; s < samples_per_pixel; s += N) {
+      size_t lanes = std::min(N, samples_per_pixel - s);
+      // the streams are the same as in the single ray path, the independent pixel jitter of all lanes is generated at
+      // once
+      if (sampler_ == sampler_type::independent) {
+        for (size_t lane = 0; lane < N; lane++) {
+          keys[lane] = counterRng::key(frame_, pixel, first_sample + s + lane);
+        }
+        counterRng::uniform(keys, 0, jitter_u);
+        counterRng::uniform(keys, 1, jitter_v);
+      } else {
+        for (size_t lane = 0; lane < lanes; lane++) {
+          random_sample(sampler_, sample_of(i, j, first_sample + s + lane));
+          jitter_u[lane] = random_real();
+          jitter_v[lane] = random_real();
+        }
+      }
+
+      for (size_t lane = 0; lane < N; lane++) {
+        if (lane < lanes) {
+          random_sample(sampler_, sample_of(i, j, first_sample + s + lane), 2);
+          real u = (i + jitter_u[lane]) / (image_width_ - 1);
+          real v = (j + jitter_v[lane]) / (image_height_ - 1);
+          rays[lane] = cam.get_ray(u, v);
+        } else {
+          rays[lane] = rays[0];
+        }
+        packet.set(lane, rays[lane]);
+      }
+
+      hit.reset(infinity);
+      // unused lanes are masked by an empty t range
+      for (size_t lane = lanes; lane < N; lane++) {
+        hit.t[lane] = 0.;
+      }
+      trace_counters& counters = traceStats::local();
+      counters.paths += lanes;
+      counters.rays += lanes;
+      traceStats::timed(counters.intersect_time, [&] {
+        packet_tracer_->intersect(packet, 0.001, hit);
+        return true;
+      });
+
+      for (size_t lane = 0; lane < lanes; lane++) {
+        if (hit.hit(lane)) {
+          TRACE_COUNT(hits);
+          random_sample(sampler_, sample_of(i, j, first_sample + s + lane));
+          hit_record rec;
+          packet_tracer_->spheres().fill_hit_record(static_cast<size_t>(hit.index[lane]), rays[lane], hit.t[lane], rec);
+          pixel_color += ray_color(rays[lane], &rec, features);
+        } else {
+          TRACE_PATH_END(escaped, 1);
+          pixel_color += background(rays[lane]);
+          if (features) features->add(background(rays[lane]), vec3(0, 0, 0), pixel_features::miss_depth);
+        }
+      }
+    }
+
+    return pixel_color;
+  }
+
+  // All pixels get min_samples, then passes of batch_size samples go to the noisier half of the pixels which are not
+  // converged until the sample budget of the frame is used up or all pixels are converged.
+  void renderAdaptive(const camera& cam) {
+    const size_t num_pixels = image_width_ * image_height_;
+    const uint32_t min_samples = std::min<size_t>(adaptive_.min_samples, samples_per_pixel_);
+    size_t budget = num_pixels * samples_per_pixel_;
+    std::vector<uint32_t> samples_in_pass(num_pixels, min_samples);
+
+    while (true) {
+      sample_pixels(cam, samples_in_pass);
+
+      for (size_t index = 0; index < num_pixels; index++) {
+        budget -= std::min<size_t>(budget, samples_in_pass[index]);
+      }
+
+      // Pixels which still need samples. They are ranked by the variance reduction of one more sample
+      // (error / sqrt(count)), which leads to samples proportional to the standard deviation and the lowest overall
+      // error. Ranking by the error alone would waste samples on fireflies.
+      std::vector<std::pair<double, size_t>> noisy;
+      for (size_t index = 0; index < num_pixels; index++) {
+        const pixel_estimate& estimate = estimates_[index];
+        double error = estimate.error();
+        if (error > adaptive_.noise_threshold && estimate.count < adaptive_.max_samples) {
+          noisy.emplace_back(error / std::sqrt(estimate.count), index);
+        }
+      }
+      if (noisy.empty() || budget == 0) break;
+
+      // the higher ranked half gets the next batch
+      const size_t batch = std::max<size_t>(1, std::min<size_t>(adaptive_.batch_size, budget));
+      const size_t num_sampled = std::min((noisy.size() + 1) / 2, budget / batch);
+      std::nth_element(noisy.begin(), noisy.begin() + num_sampled, noisy.end(),
+                       [](const auto& a, const auto& b) { return a.first > b.first; });
+
+      std::fill(samples_in_pass.begin(), samples_in_pass.end(), 0);
+      for (size_t k = 0; k < num_sampled; k++) {
+        const size_t index = noisy[k].second;
+        samples_in_pass[index] = std::min<size_t>(batch, adaptive_.max_samples - estimates_[index].count);
+      }
+    }
+  }
+
+  // Radiance of the path starting with the camera ray r, traced bounce by bounce. The throughput is the product of
+  // the attenuations so far. After roulette_depth rays a path with a throughput below 1 survives a bounce with the
+  // probability of its largest component and is weighted by its inverse, so the estimate stays unbiased while the
+  // paths which contribute almost nothing end early.
+  // With light sampling the emission of a light which the scattered ray hits is weighted against the light sample of
+  // the previous bounce, see direct_light.
+  // primary_hit is the hit of r if the caller already intersected it (packet tracing), else nullptr.
+  // The guide buffers of the path are added to features if it isn't nullptr, see pixel_features.
+  color ray_color(ray r, const hit_record* primary_hit = nullptr, pixel_features* features = nullptr) {
+    trace_counters& counters = traceStats::local();
+    const bool sample_lights = light_sampling_ && !lights_.empty();
+    color radiance(0, 0, 0);
+    color throughput(1, 1, 1);
     hit_record rec;
+    // density of the scatter direction of r, 0 for the camera ray and after mirrors and glass
+    real scatter_density = 0;
+    // length of the path to the hit which goes into the features
+    real path_length = 0;
 
-    if (depth <= 0) return color(0, 0, 0);
+    for (uint32_t bounce = 1; bounce <= max_depth_; bounce++) {
+      if (bounce == 1 && primary_hit) {
+        rec = *primary_hit;
+      } else {
+        counters.rays++;
+        if (!traceStats::timed(counters.intersect_time, [&] { return world_->hit(r, 0.001, infinity, rec); })) {
+          TRACE_PATH_END(escaped, bounce);
+          if (features) {
+            features->add(throughput.cwiseProduct(background(r)), vec3(0, 0, 0), pixel_features::miss_depth);
+          }
+          return radiance + throughput.cwiseProduct(background(r));
+        }
+        TRACE_COUNT(hits);
+      }
+
+      const material& mat = (*materials_)[rec.mat_index];
+      if (features) {
+        path_length += (rec.p - r.origin()).norm();
+        // mirrors and glass are followed to the surface they show
+        if (has_scatter_density(mat) || std::holds_alternative<diffuse_light>(mat) || bounce == max_depth_) {
+          features->add(throughput.cwiseProduct(surface_albedo(mat)), rec.normal, path_length);
+          features = nullptr;
+        }
+      }
+      if (std::holds_alternative<diffuse_light>(mat)) {
+        const real weight =
+            sample_lights && scatter_density > 0 ? power_heuristic(scatter_density, lights_.pdf(r.origin(), rec)) : 1;
+        radiance += weight * throughput.cwiseProduct(emitted(mat, rec));
+      }
 
-    if (world.hit(r, 0.001, infinity, rec)) {
-      color attenuation;
+      color attenuation(0, 0, 0);
       ray scattered;
-      if (rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
-        return attenuation.cwiseProduct(ray_color(scattered, world, depth - 1));
-      } else {
-        return color(0, 0, 0);
+      random_bounce(bounce);
+      TRACE_COUNT(bounces[mat.index()]);
+      const bool scattered_ray =
+          traceStats::timed(counters.scatter_time, [&] { return scatter(mat, r, rec, attenuation, scattered); });
+      // the light sample doesn't depend on the scattered ray, it counts even if the scattered ray is absorbed
+      if (sample_lights && has_scatter_density(mat)) {
+        radiance += throughput.cwiseProduct(direct_light(mat, r, rec, bounce));
       }
+      if (!scattered_ray) {
+        TRACE_PATH_END(absorbed, bounce);
+        return radiance;
+      }
+      scatter_density = sample_lights ? scatter_pdf(mat, r, rec, scattered.direction()) : 0;
+      throughput = throughput.cwiseProduct(attenuation);
+
+      if (roulette_depth_ > 0 && bounce >= roulette_depth_) {
+        const real survival = throughput.maxCoeff();
+        if (survival < 1) {
+          random_bounce(bounce, roulette_offset);
+          if (random_real() >= survival) {
+            TRACE_PATH_END(roulette, bounce);
+            return radiance;
+          }
+          throughput /= survival;
+        }
+      }
+
+      r = scattered;
+    }
+
+    TRACE_PATH_END(max_depth_reached, max_depth_);
+    return radiance;
+  }
+
+  // Light sample of the hit rec of r_in: BRDF * cos * emission / density, weighted against the chance that the
+  // scattered ray hits the same point of the light. The shadow ray only has to find any hit, not the closest.
+  color direct_light(const material& mat, const ray& r_in, const hit_record& rec, uint32_t bounce) {
+    random_bounce(bounce, light_offset);
+    light_sample light;
+    if (!lights_.sample(rec.p, light)) return color(0, 0, 0);
+
+    const real density = scatter_pdf(mat, r_in, rec, light.direction);
+    if (density <= 0) return color(0, 0, 0);
+
+    trace_counters& counters = traceStats::local();
+    counters.shadow_rays++;
+    const ray shadow_ray(rec.p, light.direction);
+    if (traceStats::timed(counters.intersect_time,
+                          [&] { return world_->occluded(shadow_ray, 0.001, light.distance - 0.001); })) {
+      TRACE_COUNT(occluded_shadow_rays);
+      return color(0, 0, 0);
     }
 
+    const color brdf_cos = scatter_eval(mat, r_in, rec, light.direction);
+    return power_heuristic(light.pdf, density) / light.pdf * brdf_cos.cwiseProduct(light.emitted);
+  }
+
+  color background(const ray& r) const {
+    if (background_) return *background_;
+
     vec3 unit_direction = unit_vector(r.direction());
-    double t = 0.5 * (unit_direction.y() + 1.0);
-    return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
+    real t = (unit_direction.y() + 1) / 2;
+    return (1 - t) * color(1, 1, 1) + t * color(0.5, 0.7, 1.0);
   }
 
  private:
-  hittable_list world_;
+  void reset_estimates() {
+    estimates_.assign(image_width_ * image_height_, pixel_estimate());
+    if (features_enabled_) features_.assign(image_width_ * image_height_, pixel_features());
+  }
+
+  pixel_sample sample_of(size_t i, size_t j, size_t s) const {
+    return pixel_sample{frame_, j * image_width_ + i, static_cast<uint32_t>(i), static_cast<uint32_t>(j),
+                        static_cast<uint32_t>(s)};
+  }
+
+  // the features of pixel index or nullptr if they are disabled
+  pixel_features* features_of(size_t index) { return features_enabled_ ? &features_[index] : nullptr; }
+
+  void render_tiles(const camera& cam, const std::vector<tile>& tiles) {
+    // a tile under glass and metal takes much longer than a sky tile, the pool balances this by work stealing
+    pool_->run(
+        tiles.size(),
+        [&](size_t tile_index, size_t) {
+          const tile& t = tiles[tile_index];
+          for (size_t j = t.y0; j < t.y1; j++) {
+            for (size_t i = t.x0; i < t.x1; ++i) {
+              pixel_estimate& estimate = estimates_[j * image_width_ + i];
+              estimate.sum = calcPixel(cam, i, j, samples_per_pixel_, 0, features_of(j * image_width_ + i));
+              estimate.count = samples_per_pixel_;
+            }
+          }
+        },
+        "tile");
+  }
+
+  // adds samples[index] samples to the estimate of the pixel with the index
+  void sample_pixels(const camera& cam, const std::vector<uint32_t>& samples) {
+    pool_->run(
+        tiles_.size(),
+        [&](size_t tile_index, size_t) {
+          const tile& t = tiles_[tile_index];
+          for (size_t j = t.y0; j < t.y1; j++) {
+            for (size_t i = t.x0; i < t.x1; ++i) {
+              const size_t index = j * image_width_ + i;
+              for (uint32_t s = 0; s < samples[index]; s++) {
+                estimates_[index].add(calcPixel(cam, i, j, 1, estimates_[index].count, features_of(index)));
+              }
+            }
+          }
+        },
+        "tile");
+  }
+
+  std::shared_ptr<hittable> world_;
+  std::shared_ptr<const material_table> materials_;
   size_t image_width_;
   size_t image_height_;
   size_t samples_per_pixel_;
   uint8_t max_depth_;
+  std::shared_ptr<threadPool> pool_;
+  std::vector<tile> tiles_;
+  size_t packet_size_ = 0;
+  std::shared_ptr<packetTracer> packet_tracer_;
+  adaptive_settings adaptive_;
+  std::vector<pixel_estimate> estimates_;
+  bool features_enabled_ = false;
+  std::vector<pixel_features> features_;
+  std::optional<atrousDenoiser> denoiser_;
+  uint64_t frame_ = 0;
+  sampler_type sampler_ = sampler_type::independent;
+  uint32_t roulette_depth_ = default_roulette_depth;
+  lightSampler lights_;
+  bool light_sampling_ = true;
+  std::optional<color> background_;
+
+  static constexpr uint32_t default_tile_size = 16;
+  // earlier roulette costs more variance than it saves time on the default scene, see raytracing_bench roulette
+  static constexpr uint32_t default_roulette_depth = 5;
+  // the roulette numbers come from the second half of the block of the bounce, the scatter never uses that many
+  static constexpr uint32_t roulette_offset = stream_layout::roulette_offset;
+  // the light sample from the second quarter
+  static constexpr uint32_t light_offset = stream_layout::light_offset;
 };
 
 #endif
\ No newline at end of file
@@ -2,37 +2,68 @@
 #define RTWEEKEND_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <limits>
 #include <memory>
-#include <random>
+
+#include "sampler.h"
+
+// Scalar types, selected with the cmake option RAYTRACING_PRECISION
+// real: used for all vectors, rays, cameras and objects
+// precise_real: used where float isn't precise enough, e.g. the root solve of the sphere intersection
+
+#if defined(RAYTRACING_FLOAT)
+using real = float;
+using precise_real = float;
+#elif defined(RAYTRACING_MIXED)
+using real = float;
+using precise_real = double;
+#else
+using real = double;
+using precise_real = double;
+#endif
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
+const real infinity = std::numeric_limits<real>::infinity();
+const real pi = 3.1415926535897932385;
 
 // Utility Functions
 
-inline double degrees_to_radians(double degrees) { return degrees * pi / 180; }
+inline real degrees_to_radians(real degrees) { return degrees * pi / 180; }
+
+inline sampleStream& random_generator() {
+  // thread_local, the threads must not share a position in a stream
+  static thread_local sampleStream generator;
+
+  return generator;
+}
 
-inline double random_double() {
-  // thread_local to speed up, else the threads wait most of the time
-  //static thread_local std::mt19937 generator;  // slow
-  //static thread_local std::ranlux48_base generator; // faster
-  // fast random number generator
-  static thread_local std::minstd_rand generator; // fastest
-  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+// starts the random numbers of the calling thread at the stream key, see counterRng::key
+inline void random_stream(uint64_t key) { random_generator().set_stream(key); }
 
-  return distribution(generator);
+// starts the random numbers of the calling thread at the pixel sample, see sampleStream::set_sample
+inline void random_sample(sampler_type sampler, const pixel_sample& sample, uint64_t counter = 0) {
+  random_generator().set_sample(sampler, sample, counter);
 }
 
+// continues the stream of the calling thread at the numbers of the bounce
+inline void random_bounce(uint32_t bounce, uint32_t offset = 0) { random_generator().set_bounce(bounce, offset); }
+
+inline double random_double() { return random_generator().uniform<double>(); }
+
+// random real number in [0,1) in the precision of the renderer
+inline real random_real() { return random_generator().uniform<real>(); }
+
 inline double random_double(double min, double max) {
   // Returns a random real in [min,max).
   return min + (max - min) * random_double();
 }
 
+inline real random_real(real min, real max) { return min + (max - min) * random_real(); }
+
 inline double clamp(double x, double min, double max) {
   if (x < min) return min;
   if (x > max) return max;
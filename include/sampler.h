@@ -0,0 +1,209 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "counter_rng.h"
+
+// Sequence of the random numbers of the pixel samples
+//   independent: the counterRng stream of the sample, every number is independent of the others
+//   sobol: Owen scrambled Sobol points (0, 2)-sequence, shuffled and scrambled per pixel and pair of dimensions
+//   halton: Halton points with random linear digit scrambling per pixel and dimension
+//   blue_noise: one Owen scrambled Sobol sequence for all pixels, rotated per pixel by a blue noise mask, so the
+//               error of neighbouring pixels differs and the remaining noise has no low frequencies
+enum class sampler_type : uint8_t { independent, sobol, halton, blue_noise };
+
+// the pixel sample whose numbers a sampleStream generates
+struct pixel_sample {
+  uint64_t frame;
+  uint64_t pixel;  // index of the pixel
+  uint32_t x, y;   // coordinates of the pixel, the blue noise mask is tiled over the image
+  uint32_t index;  // number of the sample in the pixel
+};
+
+// Points of the low discrepancy sequences as 32 bit fixed point numbers in [0,1)
+class lowDiscrepancy {
+ public:
+  static constexpr uint32_t num_halton_dimensions = 64;
+  static constexpr uint32_t blue_noise_size = 64;
+
+  static sampler_type parse_type(const std::string& name);
+  static std::string type_name(sampler_type type);
+
+  static uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    return ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+  }
+
+  // Laine-Karras permutation of x with reversed bits: every bit is flipped depending on the seed and the lower bits,
+  // which is Owen scrambling of the reversed number (Burley, "Practical Hash-based Owen Scrambling", JCGT 2020)
+  static uint32_t laine_karras(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+  }
+
+  static uint32_t owen_scramble(uint32_t x, uint32_t seed) { return reverse_bits(laine_karras(reverse_bits(x), seed)); }
+
+  // Dimension 0 or 1 of the Owen scrambled Sobol point of the index, the index is shuffled by Owen scrambling it with
+  // index_seed. The points with the same index_seed and different value seeds are a scrambled (0, 2)-sequence.
+  // The index, the shuffled index and the point of dimension 1 stay bit reversed, the table gives the reversed point.
+  static uint32_t owen_sobol(uint32_t reversed_index, uint32_t dimension, uint32_t index_seed, uint32_t value_seed) {
+    uint32_t x = laine_karras(reversed_index, index_seed);
+    if (dimension == 0) {
+      // the radical inverse in base 2 of the shuffled index is x itself
+      x = reverse_bits(x);
+    } else {
+      // the point is linear in the bits of the index, so it is the xor of the points of its bytes
+      const uint32_t* table = sobol_byte_table();
+      x = table[x & 0xff] ^ table[256 + ((x >> 8) & 0xff)] ^ table[512 + ((x >> 16) & 0xff)] ^ table[768 + (x >> 24)];
+    }
+    return reverse_bits(laine_karras(x, value_seed));
+  }
+
+  // Halton point of dimension (base of the dimension-th prime). The digit k of the radical inverse is mapped to
+  // (a_k * digit + c_k) mod base with a_k > 0, random from the seed. The digits of the indices below 2^16 are
+  // scrambled, the numbers below the last digit come from tail_bits.
+  static uint32_t halton(uint32_t index, uint32_t dimension, uint64_t seed, uint32_t tail_bits);
+
+  // rank of pixel (x, y) in the blue noise mask, 0 to blue_noise_size^2 - 1, the mask repeats over the image
+  static uint32_t blue_noise_rank(uint32_t x, uint32_t y) {
+    return blue_noise_mask()[(y % blue_noise_size) * blue_noise_size + x % blue_noise_size];
+  }
+
+ private:
+  // dimension 1 of the Sobol points of every byte of the reversed index, 4 x 256 entries, bit reversed
+  static const uint32_t* sobol_byte_table();
+
+  // void and cluster mask (Ulichney 1993), generated on the first use
+  static const uint16_t* blue_noise_mask();
+};
+
+// Layout of the numbers of a path in its stream, see counterRng::set_bounce: bounce 0 is the camera ray, the scatter of
+// every bounce starts at offset 0, the light sample at light_offset and the roulette at roulette_offset.
+// The low discrepancy samplers number the first numbers of these blocks as dimensions: 4 for the camera (pixel jitter
+// and lens) and 8 per bounce: 0-3 scatter, 4-5 light direction, 6 light index, 7 roulette. The pairs 2k, 2k + 1 are
+// the 2D point sets of the Sobol sampler, so the two numbers of a direction are one pair.
+// The numbers of rejection sampling after the first try and of bounces beyond the Halton primes stay independent.
+struct stream_layout {
+  static constexpr uint32_t light_offset = 1u << 30;
+  static constexpr uint32_t roulette_offset = 1u << 31;
+  static constexpr uint32_t camera_dimensions = 4;
+  static constexpr uint32_t bounce_dimensions = 8;
+  static constexpr uint32_t no_dimension = UINT32_MAX;
+
+  static uint32_t dimension(uint64_t counter) {
+    const uint32_t bounce = static_cast<uint32_t>(counter >> 32);
+    const uint32_t offset = static_cast<uint32_t>(counter);
+    if (bounce == 0) return offset < camera_dimensions ? offset : no_dimension;
+
+    uint32_t slot;
+    if (offset < 4) {
+      slot = offset;
+    } else if (offset - light_offset < 3) {
+      // index, direction 1, direction 2 -> 6, 4, 5
+      slot = 4 + (offset - light_offset + 2) % 3;
+    } else if (offset == roulette_offset) {
+      slot = 7;
+    } else {
+      return no_dimension;
+    }
+    return camera_dimensions + (bounce - 1) * bounce_dimensions + slot;
+  }
+};
+
+// The random numbers of the renderer: a counterRng stream, whose numbers at the dimensions of stream_layout come from
+// the sequence of the sampler while a pixel sample is set. The sequence gives the high 32 bits, the stream the rest.
+class sampleStream {
+ public:
+  // the independent numbers of the stream key, see counterRng
+  void set_stream(uint64_t key, uint64_t counter = 0) {
+    rng_.set_stream(key, counter);
+    sampler_ = sampler_type::independent;
+  }
+
+  // The numbers of the pixel sample starting at counter. The independent sampler gives the stream
+  // counterRng::key(frame, pixel, index).
+  void set_sample(sampler_type sampler, const pixel_sample& sample, uint64_t counter = 0) {
+    const uint64_t pixel_key = hash_combine(sample.frame, sample.pixel);
+    rng_.set_stream(hash_combine(pixel_key, sample.index), counter);
+    sampler_ = sampler;
+    if (sampler == sampler_type::independent) return;
+
+    index_ = sample.index;
+    reversed_index_ = lowDiscrepancy::reverse_bits(sample.index);
+    if (sampler == sampler_type::blue_noise) {
+      // the same sequence for all pixels of the frame
+      sequence_key_ = hash_combine(sample.frame, UINT64_MAX);
+      x_ = sample.x;
+      y_ = sample.y;
+    } else {
+      sequence_key_ = pixel_key;
+    }
+  }
+
+  void set_bounce(uint32_t bounce, uint32_t offset = 0) { rng_.set_bounce(bounce, offset); }
+
+  uint64_t next() {
+    const uint64_t counter = rng_.counter();
+    const uint64_t bits = rng_.next();
+    if (sampler_ == sampler_type::independent) return bits;
+
+    const uint32_t dimension = stream_layout::dimension(counter);
+    if (dimension == stream_layout::no_dimension) return bits;
+    const uint32_t low = static_cast<uint32_t>(bits);
+    uint32_t value;
+    switch (sampler_) {
+      case sampler_type::halton:
+        if (dimension >= lowDiscrepancy::num_halton_dimensions) return bits;
+        value = lowDiscrepancy::halton(index_, dimension, hash_combine(sequence_key_, dimension), low);
+        break;
+      case sampler_type::blue_noise: {
+        // Cranley-Patterson rotation by the mask, shifted per dimension so the dimensions aren't correlated
+        const uint64_t seeds = sobol_seeds(dimension);
+        const uint32_t rank = lowDiscrepancy::blue_noise_rank(x_ + static_cast<uint32_t>(seeds >> 32),
+                                                              y_ + static_cast<uint32_t>(seeds >> 48));
+        value = sobol_value(dimension, seeds) + (rank << 20) + (low >> 12);
+        break;
+      }
+      default:
+        value = sobol_value(dimension, sobol_seeds(dimension));
+        break;
+    }
+    return (static_cast<uint64_t>(value) << 32) | low;
+  }
+
+  // uniform in [0,1), with all the mantissa bits of T
+  template <class T>
+  T uniform() {
+    return counterRng::to_uniform<T>(next());
+  }
+
+ private:
+  // the dimensions 2k and 2k + 1 are one 2D point set with the same index seed (low half) and different value seeds
+  uint64_t sobol_seeds(uint32_t dimension) const {
+    return hash_combine(sequence_key_, dimension / 2) ^ (static_cast<uint64_t>(dimension % 2) * 0x9e3779b900000000ull);
+  }
+
+  uint32_t sobol_value(uint32_t dimension, uint64_t seeds) const {
+    return lowDiscrepancy::owen_sobol(reversed_index_, dimension % 2, static_cast<uint32_t>(seeds),
+                                      static_cast<uint32_t>(seeds >> 32));
+  }
+
+  counterRng rng_;
+  sampler_type sampler_ = sampler_type::independent;
+  uint64_t sequence_key_ = 0;
+  uint32_t index_ = 0;
+  uint32_t reversed_index_ = 0;
+  uint32_t x_ = 0, y_ = 0;
+};
+
+#endif
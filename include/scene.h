@@ -0,0 +1,89 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+
+// render settings of a scene, the defaults are the settings of the built in random scene
+struct render_settings {
+  uint32_t image_width = 320;
+  uint32_t image_height = 180;
+  uint32_t samples_per_pixel = 50;
+  uint32_t max_depth = 50;
+};
+
+struct camera_settings {
+  point3 lookfrom = point3(13, 2, 3);
+  point3 lookat = point3(0, 0, 0);
+  vec3 vup = vec3(0, 1, 0);
+  real vfov = 20;  // vertical field-of-view in degrees
+  real aperture = 0.1;
+  real focus_dist = 10;
+};
+
+struct scene {
+  std::shared_ptr<hittable_list> world = std::make_shared<hittable_list>();
+  std::shared_ptr<material_table> materials = std::make_shared<material_table>();
+  render_settings settings;
+  camera_settings view;
+  // constant background color instead of the sky gradient
+  std::optional<color> background;
+
+  real aspect_ratio() const { return static_cast<real>(settings.image_width) / settings.image_height; }
+  camera make_camera() const { return make_camera(view.lookfrom); }
+  // camera of the scene moved to lookfrom
+  camera make_camera(const point3& lookfrom) const {
+    return camera(lookfrom, view.lookat, view.vup, view.vfov, aspect_ratio(), view.aperture, view.focus_dist);
+  }
+};
+
+// Scenes are described in a text file, one statement per line, # starts a comment:
+//   image <width> <height>
+//   samples <samples per pixel>
+//   depth <max depth>
+//   camera lookfrom <x y z> lookat <x y z> vup <x y z> vfov <degrees> aperture <a> focus_dist <d>
+//   material <name> lambertian <r g b>
+//   material <name> metal <r g b> <fuzz>
+//   material <name> dielectric <refraction index>
+//   material <name> light <r g b>                  emitted radiance, the components can be larger than 1
+//   sphere <x y z> <radius> <material name>
+//   mesh <file> <material name> [transforms]       OBJ or binary mesh, relative to the scene file, see meshLoader
+//     transforms: scale <s>, rotate <axis x y z> <degrees>, translate <x y z>, matrix <3x4 row by row>
+//     applied in the written order. A file is loaded once, its further meshes are instances of the first.
+//   background <r g b>                             constant color instead of the sky
+// The keywords of the camera are optional and can be in any order.
+// The binary cache is a header followed by the material and sphere records and is read through mmap. The spheres are
+// created in an objectArena, with the count from the cache header a million objects load with a single allocation.
+// Only scenes of spheres are cached, a scene with meshes is parsed every time and the meshes have their own cache.
+// Errors throw std::runtime_error.
+class sceneLoader {
+ public:
+  struct load_stats {
+    double load_time = 0.;  // [s]
+    bool from_cache = false;
+  };
+
+  // Loads the scene through the binary cache <filename>.bin if it is newer than the text file, else the text file
+  // is parsed and the cache written.
+  static scene load(const std::string& filename, bool use_cache = true, load_stats* stats = nullptr);
+
+  static scene load_text(const std::string& filename);
+  static void save_text(const scene& s, const std::string& filename);
+  // the text format in a stream, the numbers are written with all digits, so a scene is read back unchanged
+  static scene read_text(std::istream& stream, const std::string& name);
+  static void write_text(const scene& s, std::ostream& stream);
+
+  static scene load_binary(const std::string& filename);
+  static void save_binary(const scene& s, const std::string& filename);
+
+  static std::string cache_filename(const std::string& filename) { return filename + ".bin"; }
+};
+
+#endif
@@ -7,15 +7,16 @@
 class sphere : public hittable {
  public:
   sphere() {}
-  sphere(point3 cen, double r, std::shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m){};
+  sphere(point3 cen, real r, uint32_t m) : center(cen), radius(r), mat_index(m){};
   virtual ~sphere() {};
 
-  virtual bool hit(const ray& r, double tmin, double tmax, hit_record& rec) const;
+  virtual bool hit(const ray& r, real tmin, real tmax, hit_record& rec) const;
+  virtual bool bounding_box(aabb& output_box) const;
 
  public:
   point3 center;
-  double radius;
-  std::shared_ptr<material> mat_ptr;
+  real radius;
+  uint32_t mat_index;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#ifndef SPHERE_SOA_H
+#define SPHERE_SOA_H
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "hittable.h"
+#include "ray.h"
+
+// N rays in structure of arrays layout, the lanes are processed together by the SIMD kernels.
+// The packets are always double precision, independent of the precision of the renderer.
+template <size_t N>
+struct alignas(64) ray_packet {
+  double origin[3][N];
+  double direction[3][N];
+
+  void set(size_t lane, const ray& r) {
+    for (int a = 0; a < 3; a++) {
+      origin[a][lane] = r.origin()[a];
+      direction[a][lane] = r.direction()[a];
+    }
+  }
+
+  ray get(size_t lane) const {
+    return ray(vec3_t<double>(origin[0][lane], origin[1][lane], origin[2][lane]).cast<real>(),
+               vec3_t<double>(direction[0][lane], direction[1][lane], direction[2][lane]).cast<real>());
+  }
+};
+
+template <size_t N>
+struct alignas(64) packet_hit {
+  double t[N];      // closest hit so far per lane, starts with t_max. A lane with t_max <= t_min is masked.
+  double index[N];  // index of the hit sphere or -1, stored as double to blend it with the same masks as t
+
+  void reset(double t_max) {
+    for (size_t lane = 0; lane < N; lane++) {
+      t[lane] = t_max;
+      index[lane] = -1.;
+    }
+  }
+
+  bool hit(size_t lane) const { return index[lane] >= 0.; }
+};
+
+// Spheres in structure of arrays layout: center x/y/z and radius in separate aligned arrays.
+// One sphere is intersected with all lanes of a ray packet at once.
+class sphere_soa {
+ public:
+  // all objects have to be spheres, the index of a sphere is its position in objects
+  sphere_soa(const std::vector<std::shared_ptr<hittable>>& objects);
+
+  size_t size() const { return radius_.size(); }
+
+  // Updates the lanes of hit which have a closer intersection with sphere index in (t_min, hit.t).
+  template <size_t N>
+  void intersect(size_t index, const ray_packet<N>& packet, double t_min, packet_hit<N>& hit) const;
+  // same without SIMD intrinsics as reference and fallback
+  template <size_t N>
+  void intersect_scalar(size_t index, const ray_packet<N>& packet, double t_min, packet_hit<N>& hit) const;
+
+  // fills the record the same way as sphere::hit
+  void fill_hit_record(size_t index, const ray& r, real t, hit_record& rec) const;
+
+ private:
+  void intersect_lane(size_t index, size_t lane, const double* origin[3], const double* direction[3], double t_min,
+                      double* hit_t, double* hit_index) const;
+
+  aligned_vector<double> center_x_;
+  aligned_vector<double> center_y_;
+  aligned_vector<double> center_z_;
+  aligned_vector<double> radius_;
+  std::vector<uint32_t> materials_;
+};
+
+inline void sphere_soa::intersect_lane(size_t index, size_t lane, const double* origin[3], const double* direction[3],
+                                       double t_min, double* hit_t, double* hit_index) const {
+  double ocx = origin[0][lane] - center_x_[index];
+  double ocy = origin[1][lane] - center_y_[index];
+  double ocz = origin[2][lane] - center_z_[index];
+  double dx = direction[0][lane];
+  double dy = direction[1][lane];
+  double dz = direction[2][lane];
+
+  double a = dx * dx + dy * dy + dz * dz;
+  double half_b = ocx * dx + ocy * dy + ocz * dz;
+  double c = ocx * ocx + ocy * ocy + ocz * ocz - radius_[index] * radius_[index];
+  double discriminant = half_b * half_b - a * c;
+
+  if (discriminant > 0) {
+    double root = std::sqrt(discriminant);
+    double t = (-half_b - root) / a;
+    if (!(t < hit_t[lane] && t > t_min)) t = (-half_b + root) / a;
+    if (t < hit_t[lane] && t > t_min) {
+      hit_t[lane] = t;
+      hit_index[lane] = index;
+    }
+  }
+}
+
+template <size_t N>
+void sphere_soa::intersect_scalar(size_t index, const ray_packet<N>& packet, double t_min,
+                                  packet_hit<N>& hit) const {
+  const double* origin[3] = {packet.origin[0], packet.origin[1], packet.origin[2]};
+  const double* direction[3] = {packet.direction[0], packet.direction[1], packet.direction[2]};
+
+  for (size_t lane = 0; lane < N; lane++) {
+    intersect_lane(index, lane, origin, direction, t_min, hit.t, hit.index);
+  }
+}
+
+template <size_t N>
+void sphere_soa::intersect(size_t index, const ray_packet<N>& packet, double t_min, packet_hit<N>& hit) const {
+  size_t lane = 0;
+
+#ifdef __AVX512F__
+  if (N >= 8) {
+    const __m512d cx = _mm512_set1_pd(center_x_[index]);
+    const __m512d cy = _mm512_set1_pd(center_y_[index]);
+    const __m512d cz = _mm512_set1_pd(center_z_[index]);
+    const __m512d r2 = _mm512_set1_pd(radius_[index] * radius_[index]);
+    const __m512d tmin = _mm512_set1_pd(t_min);
+    const __m512d sphere_index = _mm512_set1_pd(index);
+
+    for (; lane + 8 <= N; lane += 8) {
+      __m512d dx = _mm512_loadu_pd(&packet.direction[0][lane]);
+      __m512d dy = _mm512_loadu_pd(&packet.direction[1][lane]);
+      __m512d dz = _mm512_loadu_pd(&packet.direction[2][lane]);
+      __m512d ocx = _mm512_sub_pd(_mm512_loadu_pd(&packet.origin[0][lane]), cx);
+      __m512d ocy = _mm512_sub_pd(_mm512_loadu_pd(&packet.origin[1][lane]), cy);
+      __m512d ocz = _mm512_sub_pd(_mm512_loadu_pd(&packet.origin[2][lane]), cz);
+
+      __m512d a = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dz, dz)));
+      __m512d half_b = _mm512_fmadd_pd(ocx, dx, _mm512_fmadd_pd(ocy, dy, _mm512_mul_pd(ocz, dz)));
+      __m512d c = _mm512_sub_pd(_mm512_fmadd_pd(ocx, ocx, _mm512_fmadd_pd(ocy, ocy, _mm512_mul_pd(ocz, ocz))), r2);
+      __m512d discriminant = _mm512_fmsub_pd(half_b, half_b, _mm512_mul_pd(a, c));
+
+      __mmask8 valid = _mm512_cmp_pd_mask(discriminant, _mm512_setzero_pd(), _CMP_GT_OQ);
+      if (!valid) continue;
+
+      __m512d root = _mm512_maskz_sqrt_pd(valid, discriminant);
+      __m512d t_max = _mm512_loadu_pd(&hit.t[lane]);
+      __m512d t0 = _mm512_div_pd(_mm512_sub_pd(_mm512_setzero_pd(), _mm512_add_pd(half_b, root)), a);
+      __m512d t1 = _mm512_div_pd(_mm512_sub_pd(root, half_b), a);
+
+      __mmask8 hit0 = _mm512_mask_cmp_pd_mask(valid, t0, t_max, _CMP_LT_OQ);
+      hit0 = _mm512_mask_cmp_pd_mask(hit0, t0, tmin, _CMP_GT_OQ);
+      __mmask8 hit1 = _mm512_mask_cmp_pd_mask(valid & ~hit0, t1, t_max, _CMP_LT_OQ);
+      hit1 = _mm512_mask_cmp_pd_mask(hit1, t1, tmin, _CMP_GT_OQ);
+
+      __m512d t = _mm512_mask_mov_pd(t_max, hit0, t0);
+      t = _mm512_mask_mov_pd(t, hit1, t1);
+      _mm512_storeu_pd(&hit.t[lane], t);
+      _mm512_mask_storeu_pd(&hit.index[lane], hit0 | hit1, sphere_index);
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  if (lane + 4 <= N) {
+    const __m256d cx = _mm256_set1_pd(center_x_[index]);
+    const __m256d cy = _mm256_set1_pd(center_y_[index]);
+    const __m256d cz = _mm256_set1_pd(center_z_[index]);
+    const __m256d r2 = _mm256_set1_pd(radius_[index] * radius_[index]);
+    const __m256d tmin = _mm256_set1_pd(t_min);
+    const __m256d sphere_index = _mm256_set1_pd(index);
+    const __m256d zero = _mm256_setzero_pd();
+
+    for (; lane + 4 <= N; lane += 4) {
+      __m256d dx = _mm256_loadu_pd(&packet.direction[0][lane]);
+      __m256d dy = _mm256_loadu_pd(&packet.direction[1][lane]);
+      __m256d dz = _mm256_loadu_pd(&packet.direction[2][lane]);
+      __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(&packet.origin[0][lane]), cx);
+      __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(&packet.origin[1][lane]), cy);
+      __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(&packet.origin[2][lane]), cz);
+
+      __m256d a = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+      __m256d half_b = _mm256_fmadd_pd(ocx, dx, _mm256_fmadd_pd(ocy, dy, _mm256_mul_pd(ocz, dz)));
+      __m256d c = _mm256_sub_pd(_mm256_fmadd_pd(ocx, ocx, _mm256_fmadd_pd(ocy, ocy, _mm256_mul_pd(ocz, ocz))), r2);
+      __m256d discriminant = _mm256_fmsub_pd(half_b, half_b, _mm256_mul_pd(a, c));
+
+      __m256d valid = _mm256_cmp_pd(discriminant, zero, _CMP_GT_OQ);
+      if (_mm256_movemask_pd(valid) == 0) continue;
+
+      __m256d root = _mm256_sqrt_pd(_mm256_max_pd(discriminant, zero));
+      __m256d t_max = _mm256_loadu_pd(&hit.t[lane]);
+      __m256d t0 = _mm256_div_pd(_mm256_sub_pd(zero, _mm256_add_pd(half_b, root)), a);
+      __m256d t1 = _mm256_div_pd(_mm256_sub_pd(root, half_b), a);
+
+      __m256d hit0 = _mm256_and_pd(valid, _mm256_and_pd(_mm256_cmp_pd(t0, t_max, _CMP_LT_OQ),
+                                                         _mm256_cmp_pd(t0, tmin, _CMP_GT_OQ)));
+      __m256d hit1 = _mm256_andnot_pd(hit0, _mm256_and_pd(valid, _mm256_and_pd(_mm256_cmp_pd(t1, t_max, _CMP_LT_OQ),
+                                                                               _mm256_cmp_pd(t1, tmin, _CMP_GT_OQ))));
+      __m256d any_hit = _mm256_or_pd(hit0, hit1);
+
+      __m256d t = _mm256_blendv_pd(t_max, t0, hit0);
+      t = _mm256_blendv_pd(t, t1, hit1);
+      _mm256_storeu_pd(&hit.t[lane], t);
+      _mm256_storeu_pd(&hit.index[lane], _mm256_blendv_pd(_mm256_loadu_pd(&hit.index[lane]), sphere_index, any_hit));
+    }
+  }
+#endif
+
+  if (lane < N) {
+    const double* origin[3] = {packet.origin[0], packet.origin[1], packet.origin[2]};
+    const double* direction[3] = {packet.direction[0], packet.direction[1], packet.direction[2]};
+
+    for (; lane < N; lane++) {
+      intersect_lane(index, lane, origin, direction, t_min, hit.t, hit.index);
+    }
+  }
+}
+
+#endif
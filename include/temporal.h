@@ -0,0 +1,80 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "color.h"
+#include "raytrace.h"
+
+struct temporal_settings {
+  // samples per pixel of a frame on top of a valid history, pixels without history get samples_per_pixel
+  uint32_t fresh_samples = 8;
+  // the history counts at most for max_history samples, so old samples fade out
+  uint32_t max_history = 200;
+  // a reprojected hit point is only reused if it is closer than position_tolerance * depth to the new hit point
+  real position_tolerance = 0.03;
+};
+
+// Temporal reuse for animations of a static scene with a moving camera.
+// The hit points of the pixel centers (position, depth and material) are kept for every frame. A hit point of the
+// new frame is projected into the previous camera and the accumulated radiance of the previous frame is
+// interpolated there, if the previous pixels saw the same surface. Such pixels only get fresh_samples new samples.
+// Only diffuse (lambertian) surfaces are reused, the radiance of metal and glass depends on the view direction.
+class temporalReuse {
+ public:
+  struct frame_stats {
+    size_t pixels = 0;
+    size_t reused = 0;        // pixels with a valid history
+    size_t rejected = 0;      // diffuse pixels whose history failed the check: off screen, disoccluded
+    size_t not_reusable = 0;  // sky, metal and glass
+    size_t samples = 0;       // fresh samples of the frame
+    double history = 0.;      // samples the history of a reused pixel counts for on average
+
+    double reuse_ratio() const { return pixels ? static_cast<double>(reused) / pixels : 0.; }
+    double samples_per_pixel() const { return pixels ? static_cast<double>(samples) / pixels : 0.; }
+  };
+
+  temporalReuse(raytrace& raytracer, temporal_settings settings = temporal_settings());
+
+  void render(const camera& cam);
+
+  // the next frame is rendered from scratch
+  void reset() { previous_camera_.reset(); }
+
+  // linear color of the pixel with index j * width + i
+  color mean(size_t index) const { return sum_[index] / static_cast<real>(std::max(count_[index], 1.)); }
+  ImageWrapper image(const std::string& filename, image_type type = default_image_type) const;
+  const frame_stats& stats() const { return stats_; }
+
+ private:
+  struct hit_buffer {
+    std::vector<point3> position;
+    std::vector<real> depth;
+    std::vector<uint32_t> material;  // no_hit for the sky
+  };
+
+  static constexpr uint32_t no_hit = std::numeric_limits<uint32_t>::max();
+
+  void trace_hits(const camera& cam, hit_buffer& buffer);
+  bool interior(size_t index) const;
+  bool reproject(size_t index, color& sum, double& count) const;
+
+  raytrace& raytracer_;
+  temporal_settings settings_;
+  size_t width_;
+  size_t height_;
+
+  hit_buffer hits_, previous_hits_;
+  std::vector<color> sum_, previous_sum_;  // accumulated radiance
+  std::vector<double> count_, previous_count_;
+  std::optional<camera> previous_camera_;
+  frame_stats stats_;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool. The threads are started once and kept alive between calls to run(), so a pool can be
+// reused for every frame of a sequence.
+// The tasks of one run are split into contiguous blocks, one per thread. Each thread works on its own block from the
+// front and steals from the back of the other blocks when it runs out of work.
+class threadPool {
+ public:
+  struct thread_stats {
+    double busy_time = 0.;  // time spent in tasks [s]
+    double idle_time = 0.;  // time of the run not spent in tasks [s]
+    size_t tasks = 0;       // number of executed tasks
+    size_t stolen = 0;      // number of tasks stolen from other threads
+  };
+
+  using task_function = std::function<void(size_t task_index, size_t thread_index)>;
+
+  explicit threadPool(size_t num_threads = std::thread::hardware_concurrency());
+  ~threadPool();
+
+  threadPool(const threadPool&) = delete;
+  threadPool& operator=(const threadPool&) = delete;
+
+  // Calls task(task_index, thread_index) for all task indices in [0, num_tasks) and returns when all have finished.
+  // The name labels the tasks in the trace.
+  void run(size_t num_tasks, const task_function& task, const char* name = "task");
+
+  size_t size() const { return workers_.size(); }
+
+  // statistics of the last run
+  const std::vector<thread_stats>& stats() const { return stats_; }
+  double run_time() const { return run_time_; }
+  // sum of busy time / (threads * run time), 1.0 means no thread was idle
+  double utilization() const;
+  void print_stats(std::ostream& out) const;
+
+  // Records start and end of every task of the following runs, off by default. Must not be called during a run.
+  void set_trace(bool enabled);
+  // the recorded tasks as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev), one track per thread
+  void write_trace(std::ostream& out) const;
+
+ private:
+  struct worker_queue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  void worker_loop(size_t thread_index);
+  bool pop_task(size_t thread_index, size_t& task_index, bool& stolen);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<thread_stats> stats_;
+  double run_time_ = 0.;
+
+  struct task_event {
+    const char* name;
+    uint32_t run;
+    uint32_t task;
+    double start;  // since the trace was enabled [s]
+    double end;
+    bool stolen;
+  };
+  bool trace_ = false;
+  std::chrono::steady_clock::time_point trace_start_;
+  uint32_t traced_runs_ = 0;
+  const char* run_name_ = "task";
+  std::vector<std::vector<task_event>> events_;  // per thread, only written by the thread
+
+  std::mutex mutex_;
+  std::condition_variable start_condition_;
+  std::condition_variable done_condition_;
+  const task_function* task_ = nullptr;
+  size_t generation_ = 0;
+  size_t active_workers_ = 0;
+  bool shutdown_ = false;
+};
+
+#endif
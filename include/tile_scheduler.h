@@ -0,0 +1,32 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// order in which the tiles of an image are rendered
+enum class tile_order { scanline, morton, hilbert };
+
+// rectangle [x0, x1) x [y0, y1) of the image
+struct tile {
+  uint32_t x0, y0;
+  uint32_t x1, y1;
+};
+
+class tileScheduler {
+ public:
+  // Splits the image into tiles of tile_size x tile_size pixels, the tiles at the right and top border can be smaller.
+  // Morton and Hilbert order keep consecutive tiles close to each other, which is good for the caches when a thread
+  // renders a block of consecutive tiles.
+  static std::vector<tile> generate(uint32_t image_width, uint32_t image_height, uint32_t tile_size, tile_order order);
+
+  static uint32_t morton_index(uint32_t x, uint32_t y);
+  // index on the hilbert curve through a grid of size x size cells, size has to be a power of two
+  static uint32_t hilbert_index(uint32_t size, uint32_t x, uint32_t y);
+
+  static tile_order parse_order(const std::string& name);
+  static std::string order_name(tile_order order);
+};
+
+#endif
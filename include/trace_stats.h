@@ -0,0 +1,94 @@
+#ifndef TRACE_STATS_H
+#define TRACE_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// counters of the paths traced by a thread
+struct trace_counters {
+  // the last bucket of the path length histogram counts all longer paths
+  static constexpr size_t histogram_size = 32;
+
+  uint64_t paths = 0;  // camera samples, one primary ray each
+  uint64_t rays = 0;   // primary and scattered rays
+  uint64_t shadow_rays = 0;
+  // only measured with traceStats::set_timing(true) [s]
+  double intersect_time = 0.;
+  double scatter_time = 0.;
+
+  // RAYTRACING_COUNTERS
+  uint64_t node_visits = 0;         // bvh nodes taken from the traversal stack
+  uint64_t intersection_tests = 0;  // ray primitive tests
+  uint64_t hits = 0;
+  uint64_t bounces[4] = {};  // scatter calls by material_type
+  uint64_t occluded_shadow_rays = 0;
+  uint64_t total_internal_reflections = 0;
+  uint64_t unit_sphere_rejections = 0;  // rejected candidates of random_in_unit_sphere
+  // reasons the paths ended
+  uint64_t escaped = 0;
+  uint64_t absorbed = 0;
+  uint64_t roulette = 0;
+  uint64_t max_depth_reached = 0;
+  uint64_t path_length[histogram_size] = {};  // rays of the ended paths
+
+  trace_counters& operator+=(const trace_counters& other);
+
+  // rays per path
+  double average_depth() const { return paths > 0 ? static_cast<double>(rays) / paths : 0.; }
+
+  void count_path_end(uint64_t trace_counters::*reason, uint32_t length) {
+    ++(this->*reason);
+    ++path_length[length < histogram_size ? length : histogram_size - 1];
+  }
+};
+
+// Every thread counts into its own trace_counters, so counting is an increment without synchronization.
+// collect() sums the counters of all threads, it must not be called while rays are traced.
+class traceStats {
+ public:
+  static trace_counters& local() {
+    static thread_local trace_counters* counters = register_thread();
+    return *counters;
+  }
+
+  static trace_counters collect();
+  static void reset();
+
+  // counters and path length histogram as text, the detailed counters only with RAYTRACING_COUNTERS
+  static void print(std::ostream& out, const trace_counters& counters);
+
+  // Timing of the intersection and scatter stages, two clock reads per ray and stage. Off by default.
+  static void set_timing(bool enabled) { timing_ = enabled; }
+  static bool timing() { return timing_; }
+
+  // calls f and adds its run time to time if the timing is enabled
+  template <class F>
+  static bool timed(double& time, F&& f) {
+    if (!timing_) return f();
+
+    const auto start = std::chrono::steady_clock::now();
+    bool result = f();
+    time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+  }
+
+ private:
+  static trace_counters* register_thread();
+
+  static inline bool timing_ = false;
+};
+
+// The detailed counters are only compiled in with the cmake option RAYTRACING_COUNTERS, without it the macros are
+// empty. paths, rays and the stage times are always counted.
+#ifdef RAYTRACING_COUNTERS
+#define TRACE_COUNT(counter) (++traceStats::local().counter)
+#define TRACE_ADD(counter, n) (traceStats::local().counter += (n))
+#define TRACE_PATH_END(reason, length) traceStats::local().count_path_end(&trace_counters::reason, (length))
+#else
+#define TRACE_COUNT(counter) static_cast<void>(0)
+#define TRACE_ADD(counter, n) static_cast<void>(0)
+#define TRACE_PATH_END(reason, length) static_cast<void>(0)
+#endif
+
+#endif
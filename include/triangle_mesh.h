@@ -0,0 +1,95 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "hittable.h"
+#include "mapped_file.h"
+
+// Indexed triangle mesh with one material. The vertices are float triples and every triangle is three indices into
+// them, the triangles are stored in the leaf order of the mesh's own bvh. The buffers are either owned vectors or
+// point into a mapped binary mesh file, so a mesh is one object in the world no matter how many triangles it has.
+// The ray triangle test is the watertight test of Woop, Benthin and Wald (JCGT 2013): rays through a shared edge or
+// vertex hit one of the triangles, no ray slips through the mesh.
+class triangle_mesh : public hittable {
+ public:
+  // builds the bvh and reorders the triangles into its leaf order
+  triangle_mesh(std::vector<float> vertices, std::vector<uint32_t> indices, uint32_t mat_index);
+  // mesh in a mapped file, the buffers and the nodes are those of an earlier build
+  triangle_mesh(std::shared_ptr<const mapped_file> mapping, const float* vertices, size_t num_vertices,
+                const uint32_t* indices, size_t num_triangles, const bvh_node* nodes, size_t num_nodes,
+                uint32_t mat_index);
+  virtual ~triangle_mesh() {}
+
+  virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const;
+  virtual bool occluded(const ray& r, real t_min, real t_max) const;
+  virtual bool bounding_box(aabb& output_box) const;
+
+  size_t num_vertices() const { return num_vertices_; }
+  size_t num_triangles() const { return num_triangles_; }
+  const float* vertices() const { return vertices_; }
+  const uint32_t* indices() const { return indices_; }
+  const bvh_tree& tree() const { return tree_; }
+  uint32_t mat_index() const { return mat_index_; }
+
+  // file the mesh was loaded from, written into saved scenes
+  const std::string& source() const { return source_; }
+  void set_source(const std::string& source) { source_ = source; }
+
+ private:
+  // ray sheared and scaled so that its direction is the z axis, shared by all triangle tests of one ray
+  struct sheared_ray {
+    explicit sheared_ray(const ray& r);
+
+    point3 origin;
+    int kx, ky, kz;
+    real sx, sy, sz;
+  };
+
+  // t of the hit of triangle in (t_min, t_max) or 0
+  real intersect(const sheared_ray& r, uint32_t triangle, real t_min, real t_max) const;
+  point3 vertex(uint32_t index) const {
+    return point3(vertices_[3 * index], vertices_[3 * index + 1], vertices_[3 * index + 2]);
+  }
+
+  std::vector<float> vertex_storage_;
+  std::vector<uint32_t> index_storage_;
+  std::shared_ptr<const mapped_file> mapping_;
+  const float* vertices_;
+  const uint32_t* indices_;
+  size_t num_vertices_;
+  size_t num_triangles_;
+  bvh_tree tree_;
+  uint32_t mat_index_;
+  std::string source_;
+};
+
+// Wavefront OBJ files and the binary mesh format. Of the OBJ statements only the vertex positions (v) and the faces
+// (f, polygons are split into fans) are read, texture coordinates, normals, groups and materials are ignored.
+// The binary format is a header, the float vertices, the indices and the bvh nodes. It is mapped and used in place,
+// loading costs no parsing, no bvh build and no copy, only a check of the indices. The nodes depend on the precision of
+// the renderer, a file of another precision is loaded with a new build. Errors throw std::runtime_error.
+class meshLoader {
+ public:
+  struct load_stats {
+    double load_time = 0.;  // [s]
+    bool from_cache = false;
+  };
+
+  // Loads a binary mesh (.rtmesh) directly. Any other file is read as OBJ through the binary cache
+  // <filename>.rtmesh if it is newer, else the OBJ file is parsed and the cache written.
+  static std::shared_ptr<triangle_mesh> load(const std::string& filename, uint32_t mat_index, bool use_cache = true,
+                                             load_stats* stats = nullptr);
+
+  static std::shared_ptr<triangle_mesh> load_obj(const std::string& filename, uint32_t mat_index);
+  static std::shared_ptr<triangle_mesh> load_binary(const std::string& filename, uint32_t mat_index);
+  static void save_binary(const triangle_mesh& mesh, const std::string& filename);
+
+  static std::string cache_filename(const std::string& filename) { return filename + ".rtmesh"; }
+};
+
+#endif
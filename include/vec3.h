@@ -1,6 +1,7 @@
 #ifndef VEC3_H
 #define VEC3_H
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -9,72 +10,130 @@
 #ifdef USE_EIGEN
 #include <Eigen/Dense>
 
-using vec3 = Eigen::Vector3d;
+template <class T>
+using vec3_t = Eigen::Matrix<T, 3, 1>;
+
+using vec3 = vec3_t<real>;
 
 inline vec3 unit_vector(vec3 v) { return v.normalized(); }
-inline double dot(const vec3 &u, const vec3 &v) { return u.dot(v); }
+inline real dot(const vec3 &u, const vec3 &v) { return u.dot(v); }
 inline vec3 cross(const vec3 &u, const vec3 &v) { return u.cross(v); }
 #else
-class vec3 {
+template <class T>
+class vec3_t {
  public:
-  vec3() : e{0, 0, 0} {}
-  vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+  using Scalar = T;
+
+  vec3_t() : e{0, 0, 0} {}
+  vec3_t(T e0, T e1, T e2) : e{e0, e1, e2} {}
+
+  T x() const { return e[0]; }
+  T y() const { return e[1]; }
+  T z() const { return e[2]; }
 
-  double x() const { return e[0]; }
-  double y() const { return e[1]; }
-  double z() const { return e[2]; }
+  vec3_t cwiseProduct(const vec3_t &v) const { return {e[0] * v[0], e[1] * v[1], e[2] * v[2]}; }
+  vec3_t cwiseMax(const vec3_t &v) const {
+    return {std::max(e[0], v[0]), std::max(e[1], v[1]), std::max(e[2], v[2])};
+  }
+  T maxCoeff() const { return std::max(e[0], std::max(e[1], e[2])); }
 
-  vec3 cwiseProduct(const vec3 &v) { return {e[0] * v[0], e[1] * v[1], e[2] * v[2]}; }
+  template <class U>
+  vec3_t<U> cast() const {
+    return vec3_t<U>(static_cast<U>(e[0]), static_cast<U>(e[1]), static_cast<U>(e[2]));
+  }
 
-  vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-  double operator[](int i) const { return e[i]; }
-  double &operator[](int i) { return e[i]; }
+  vec3_t operator-() const { return vec3_t(-e[0], -e[1], -e[2]); }
+  T operator[](int i) const { return e[i]; }
+  T &operator[](int i) { return e[i]; }
 
-  vec3 &operator+=(const vec3 &v) {
+  vec3_t &operator+=(const vec3_t &v) {
     e[0] += v.e[0];
     e[1] += v.e[1];
     e[2] += v.e[2];
     return *this;
   }
 
-  vec3 &operator*=(const double t) {
+  vec3_t &operator*=(const T t) {
     e[0] *= t;
     e[1] *= t;
     e[2] *= t;
     return *this;
   }
 
-  vec3 &operator/=(const double t) { return *this *= 1 / t; }
+  vec3_t &operator/=(const T t) { return *this *= 1 / t; }
 
-  double norm() const { return std::sqrt(squaredNorm()); }
+  T norm() const { return std::sqrt(squaredNorm()); }
 
-  double squaredNorm() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
+  T squaredNorm() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
 
   public:
-  double e[3];
+  T e[3];
 };
 
-inline vec3 operator+(const vec3 &u, const vec3 &v) { return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]); }
+// the scalar arguments are not deduced, so literals and other floating point types are converted to T
 
-inline vec3 operator-(const vec3 &u, const vec3 &v) { return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]); }
+template <class T>
+inline vec3_t<T> operator+(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return vec3_t<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+}
 
-inline vec3 operator*(const vec3 &u, const vec3 &v) { return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]); }
+template <class T>
+inline vec3_t<T> operator-(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return vec3_t<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+}
 
-inline vec3 operator*(double t, const vec3 &v) { return vec3(t * v.e[0], t * v.e[1], t * v.e[2]); }
+template <class T>
+inline vec3_t<T> operator*(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return vec3_t<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+}
 
-inline vec3 operator*(const vec3 &v, double t) { return t * v; }
+template <class T>
+inline vec3_t<T> operator*(typename vec3_t<T>::Scalar t, const vec3_t<T> &v) {
+  return vec3_t<T>(t * v.e[0], t * v.e[1], t * v.e[2]);
+}
 
-inline vec3 operator/(vec3 v, double t) { return (1 / t) * v; }
+template <class T>
+inline vec3_t<T> operator*(const vec3_t<T> &v, typename vec3_t<T>::Scalar t) {
+  return t * v;
+}
 
-inline double dot(const vec3 &u, const vec3 &v) { return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2]; }
+template <class T>
+inline vec3_t<T> operator/(vec3_t<T> v, typename vec3_t<T>::Scalar t) {
+  return (1 / t) * v;
+}
 
-inline vec3 cross(const vec3 &u, const vec3 &v) {
-  return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1], u.e[2] * v.e[0] - u.e[0] * v.e[2], u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <class T>
+inline bool operator==(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return u.e[0] == v.e[0] && u.e[1] == v.e[1] && u.e[2] == v.e[2];
 }
 
-inline std::ostream &operator<<(std::ostream &out, const vec3 &v) { return out << v[0] << ' ' << v[1] << ' ' << v[2]; }
+template <class T>
+inline bool operator!=(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return !(u == v);
+}
+
+template <class T>
+inline T dot(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
+}
+
+template <class T>
+inline vec3_t<T> cross(const vec3_t<T> &u, const vec3_t<T> &v) {
+  return vec3_t<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1], u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                   u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+}
 
-inline vec3 unit_vector(vec3 v) { return v / v.norm(); }
+template <class T>
+inline std::ostream &operator<<(std::ostream &out, const vec3_t<T> &v) {
+  return out << v[0] << ' ' << v[1] << ' ' << v[2];
+}
+
+template <class T>
+inline vec3_t<T> unit_vector(vec3_t<T> v) {
+  return v / v.norm();
+}
+
+using vec3 = vec3_t<real>;
 #endif
 
 // Type aliases for vec3
@@ -84,12 +143,12 @@ using color = vec3;   // RGB color
 // vec3 Utility Functions
 inline vec3 reflect(const vec3 &v, const vec3 &n) { return v - 2 * dot(v, n) * n; }
 
-vec3 refract(const vec3 &uv, const vec3 &n, double etai_over_etat);
+vec3 refract(const vec3 &uv, const vec3 &n, real etai_over_etat);
 
-inline static vec3 random_vec3() { return vec3(random_double(), random_double(), random_double()); }
+inline static vec3 random_vec3() { return vec3(random_real(), random_real(), random_real()); }
 
-inline static vec3 random_vec3(double min, double max) {
-  return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+inline static vec3 random_vec3(real min, real max) {
+  return vec3(random_real(min, max), random_real(min, max), random_real(min, max));
 }
 
 extern vec3 random_in_unit_sphere();
@@ -97,4 +156,4 @@ extern vec3 random_unit_vector();
 extern vec3 random_in_hemisphere(const vec3 &normal);
 extern vec3 random_in_unit_disk();
 
-#endif
\ No newline at end of file
+#endif
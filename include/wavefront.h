@@ -0,0 +1,116 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "camera.h"
+#include "color.h"
+#include "hittable.h"
+#include "material.h"
+#include "thread_pool.h"
+
+// Breadth first path tracer as alternative to the depth first raytrace::ray_color.
+// One wave traces one sample of every pixel. All rays of a wave are kept in a structure of arrays queue and each
+// bounce runs in stages over the whole queue:
+//   intersect -> partition the hits by material type -> scatter per material type -> compact the surviving rays
+// The scatter stage calls the same material type for long runs of rays, so the branch predictor and instruction cache
+// see one material at a time instead of a random mix.
+// Experimental: on the default scene it is slower than raytrace, see raytracing_bench wavefront.
+// With set_ray_sorting the secondary rays are sorted before the intersect stage, see sort_rays.
+class wavefrontTrace {
+ public:
+  wavefrontTrace(std::shared_ptr<hittable> world, std::shared_ptr<const material_table> materials, size_t image_width,
+                 size_t image_height, size_t samples_per_pixel, uint8_t max_depth,
+                 std::shared_ptr<threadPool> pool = std::make_shared<threadPool>());
+
+  ImageWrapper calcImage(const camera& cam, std::string image_filename);
+
+  // key of the random numbers like raytrace::set_frame, the same frame gives the same samples as raytrace with the
+  // independent sampler
+  void set_frame(uint64_t frame) { frame_ = frame; }
+
+  // Sorts the scattered rays of every bounce by direction octant and the Morton code of their origin before they are
+  // intersected, so consecutive rays of a thread visit the same bvh nodes and spheres. Off by default. The image is
+  // the same with and without sorting, the results go back to the pixels of the rays and the random streams are keyed
+  // by pixel.
+  void set_ray_sorting(bool enabled) { sort_rays_ = enabled; }
+  bool ray_sorting() const { return sort_rays_; }
+
+  // number of rays (primary and scattered) traced in the last call of calcImage
+  size_t rays_traced() const { return rays_traced_; }
+
+ private:
+  struct ray_queue {
+    aligned_vector<real> origin[3];
+    aligned_vector<real> direction[3];
+    aligned_vector<real> throughput[3];
+    std::vector<uint32_t> pixel;
+
+    size_t size() const { return pixel.size(); }
+    void resize(size_t n);
+
+    void set(size_t i, const ray& r, const color& weight, uint32_t pixel_index);
+    void copy(size_t i, const ray_queue& from, size_t from_index);
+    ray get_ray(size_t i) const;
+  };
+
+  // result of the intersect stage, same indices as the ray queue
+  struct hit_queue {
+    aligned_vector<real> p[3];
+    aligned_vector<real> normal[3];
+    std::vector<uint8_t> front_face;
+    std::vector<uint32_t> mat_index;
+    std::vector<uint8_t> type;  // material_type or miss
+
+    void resize(size_t n);
+    hit_record get_record(size_t i) const;
+  };
+
+  static constexpr uint8_t miss = static_cast<uint8_t>(material_type::count);
+  static constexpr size_t chunk_size = 1024;
+  // bits per axis of the origin cell in the sort key, the 3 bits of the octant above the 3 * cell_bits Morton code
+  static constexpr uint32_t cell_bits = 4;
+  static constexpr size_t num_buckets = size_t(1) << (3 + 3 * cell_bits);
+
+  void generate_primary_rays(const camera& cam);
+  void sort_rays();
+  void intersect();
+  void partition();
+  void scatter();
+  void compact();
+
+  template <class MATERIAL>
+  void scatter_material(size_t begin, size_t end);
+
+  template <class FUNC>
+  void parallel_for(size_t n, FUNC&& func);
+
+  std::shared_ptr<hittable> world_;
+  std::shared_ptr<const material_table> materials_;
+  size_t image_width_;
+  size_t image_height_;
+  size_t samples_per_pixel_;
+  uint8_t max_depth_;
+  std::shared_ptr<threadPool> pool_;
+
+  ray_queue rays_;
+  ray_queue next_rays_;
+  hit_queue hits_;
+  std::vector<uint32_t> order_;  // ray indices sorted by material type
+  size_t type_begin_[static_cast<size_t>(material_type::count) + 1];
+  std::vector<uint8_t> alive_;   // per position in order_, ray was scattered
+  std::vector<uint32_t> sort_keys_;
+  std::vector<uint32_t> bucket_begin_;
+  aabb scene_box_;
+  bool sort_rays_ = false;
+  std::vector<color> accumulated_;
+  size_t rays_traced_ = 0;
+  uint64_t frame_ = 0;
+  size_t sample_ = 0;  // sample of the current wave
+  uint32_t bounce_ = 0;
+};
+
+#endif
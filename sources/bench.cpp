@@ -0,0 +1,1860 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bvh.h"
+#include "camera.h"
+#include "denoiser.h"
+#include "distributed.h"
+#include "hittable_list.h"
+#include "image_formats.h"
+#include "image_writer.h"
+#include "instance.h"
+#include "packet_tracer.h"
+#include "perf_counters.h"
+#include "random_world.h"
+#include "sampler.h"
+#include "object_arena.h"
+#include "raytrace.h"
+#include "scene.h"
+#include "sphere.h"
+#include "stop_watch.h"
+#include "temporal.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
+#include "trace_stats.h"
+#include "triangle_mesh.h"
+#include "wavefront.h"
+
+namespace {
+constexpr double aspect_ratio = 16.0 / 9.0;
+constexpr size_t image_width = 160;
+constexpr size_t image_height = static_cast<int>(image_width / aspect_ratio);
+constexpr size_t samples_per_pixel = 4;
+constexpr uint8_t max_depth = 8;
+
+camera default_camera() {
+  const point3 lookfrom(13., 2., 3.);
+  const point3 lookat(0, 0, 0);
+  const vec3 vup(0, 1, 0);
+
+  return camera(lookfrom, lookat, vup, 20, aspect_ratio, 0.1, 10.0);
+}
+
+// rotation around the y axis like the camera orbit of main, without Eigen so it works with both vec3 types
+point3 rotate_y(const point3& p, real angle) {
+  const real c = std::cos(angle);
+  const real s = std::sin(angle);
+  return point3(c * p[0] + s * p[2], p[1], c * p[2] - s * p[0]);
+}
+
+bool has_flag(const std::vector<std::string>& args, const std::string& flag) {
+  return std::find(args.begin(), args.end(), flag) != args.end();
+}
+
+size_t option_value(const std::vector<std::string>& args, const std::string& option, size_t default_value) {
+  auto it = std::find(args.begin(), args.end(), option);
+  if (it == args.end() || ++it == args.end()) return default_value;
+
+  return std::stoul(*it);
+}
+
+std::string option_string(const std::vector<std::string>& args, const std::string& option,
+                          const std::string& default_value = "") {
+  auto it = std::find(args.begin(), args.end(), option);
+  if (it == args.end() || ++it == args.end()) return default_value;
+
+  return *it;
+}
+
+double time_frame(const std::shared_ptr<hittable>& world, const std::shared_ptr<material_table>& materials,
+                  const camera& cam) {
+  raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth);
+  stopWatch stop_watch;
+
+  stop_watch.start();
+  raytracer.calcImage(cam, "bench", false);
+  return stop_watch.stop();
+}
+
+// time per frame of the linear hittable_list against the bvh for growing scenes
+int bench_bvh(const std::vector<std::string>& args) {
+  const bool all = has_flag(args, "--all");
+  // the linear search gets really slow for big scenes, skip it there if not explicitly requested
+  constexpr size_t max_linear_objects = 10000;
+  const camera cam = default_camera();
+
+  std::cout << std::setw(10) << "objects" << std::setw(14) << "build [s]" << std::setw(14) << "bvh [s]"
+            << std::setw(14) << "linear [s]" << std::setw(10) << "speedup" << std::endl;
+
+  for (int grid_extent : {5, 11, 22, 44, 88}) {
+    auto materials = std::make_shared<material_table>();
+    auto list = std::make_shared<hittable_list>(randomWorld::generate_random_scene(*materials, grid_extent));
+
+    stopWatch stop_watch;
+    stop_watch.start();
+    auto tree = std::make_shared<bvh>(*list);
+    double build_time = stop_watch.stop();
+
+    double bvh_time = time_frame(tree, materials, cam);
+
+    std::cout << std::fixed << std::setprecision(4) << std::setw(10) << list->objects.size() << std::setw(14)
+              << build_time << std::setw(14) << bvh_time;
+
+    if (all || list->objects.size() <= max_linear_objects) {
+      double linear_time = time_frame(list, materials, cam);
+      std::cout << std::setw(14) << linear_time << std::setw(10) << std::setprecision(1) << linear_time / bvh_time;
+    } else {
+      std::cout << std::setw(14) << "-" << std::setw(10) << "-";
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
+
+// frame time and load balance for different tile sizes and orders
+int bench_tiles(const std::vector<std::string>& args) {
+  const size_t num_threads = option_value(args, "--threads", std::thread::hardware_concurrency());
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>(num_threads);
+  raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth, pool);
+
+  std::cout << pool->size() << " threads" << std::endl;
+  std::cout << std::setw(10) << "tile size" << std::setw(10) << "order" << std::setw(14) << "frame [s]"
+            << std::setw(14) << "utilization" << std::setw(10) << "stolen" << std::endl;
+
+  for (uint32_t tile_size : {4, 8, 16, 32, 64}) {
+    for (tile_order order : {tile_order::scanline, tile_order::morton, tile_order::hilbert}) {
+      raytracer.set_tiles(tile_size, order);
+
+      stopWatch stop_watch;
+      stop_watch.start();
+      raytracer.calcImage(cam, "bench", false);
+      double frame_time = stop_watch.stop();
+
+      size_t stolen = 0;
+      for (const auto& stats : pool->stats()) {
+        stolen += stats.stolen;
+      }
+
+      std::cout << std::fixed << std::setprecision(4) << std::setw(10) << tile_size << std::setw(10)
+                << tileScheduler::order_name(order) << std::setw(14) << frame_time << std::setw(13)
+                << std::setprecision(1) << 100. * pool->utilization() << "%" << std::setw(10) << stolen << std::endl;
+    }
+  }
+
+  if (has_flag(args, "--verbose")) {
+    pool->print_stats(std::cout);
+  }
+
+  return 0;
+}
+
+// intersects all rays in packets of N, returns the time and the t of the closest hit per ray (-1 for a miss)
+template <size_t N>
+double time_packets(const packetTracer& tracer, const std::vector<ray>& rays, bool use_simd,
+                    std::vector<double>& t_hit) {
+  ray_packet<N> packet;
+  packet_hit<N> hit;
+  stopWatch stop_watch;
+
+  t_hit.resize(rays.size());
+  stop_watch.start();
+  for (size_t first = 0; first + N <= rays.size(); first += N) {
+    for (size_t lane = 0; lane < N; lane++) {
+      packet.set(lane, rays[first + lane]);
+    }
+    hit.reset(infinity);
+    tracer.intersect(packet, 0.001, hit, use_simd);
+    for (size_t lane = 0; lane < N; lane++) {
+      t_hit[first + lane] = hit.hit(lane) ? hit.t[lane] : -1.;
+    }
+  }
+  return stop_watch.stop();
+}
+
+// primary ray intersection of single rays against packets with and without SIMD kernel
+int bench_packet(const std::vector<std::string>& args) {
+  constexpr size_t rays_per_pixel = 16;
+  constexpr double tolerance = 1e-9;
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  packetTracer tracer(world);
+
+  // the samples of a pixel are consecutive, like in raytrace::calcPixelPacket
+  std::vector<ray> rays;
+  rays.reserve(image_width * image_height * rays_per_pixel);
+  for (size_t j = 0; j < image_height; j++) {
+    for (size_t i = 0; i < image_width; i++) {
+      for (size_t s = 0; s < rays_per_pixel; s++) {
+        rays.push_back(
+            cam.get_ray((i + random_double()) / (image_width - 1), (j + random_double()) / (image_height - 1)));
+      }
+    }
+  }
+
+  std::vector<double> reference(rays.size());
+  stopWatch stop_watch;
+  stop_watch.start();
+  for (size_t r = 0; r < rays.size(); r++) {
+    hit_record rec;
+    reference[r] = world->hit(rays[r], 0.001, infinity, rec) ? rec.t : -1.;
+  }
+  double single_time = stop_watch.stop();
+
+  std::cout << rays.size() << " primary rays" << std::endl;
+  std::cout << std::setw(10) << "packet" << std::setw(8) << "simd" << std::setw(12) << "time [s]" << std::setw(12)
+            << "Mrays/s" << std::setw(10) << "speedup" << std::setw(12) << "max diff" << std::setw(12) << "mismatches"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(4) << std::setw(10) << 1 << std::setw(8) << "-" << std::setw(12)
+            << single_time << std::setw(12) << std::setprecision(2) << rays.size() / single_time * 1e-6
+            << std::setw(10) << 1.0 << std::endl;
+
+  for (size_t packet_size : {4, 8, 16}) {
+    for (bool use_simd : {false, true}) {
+      std::vector<double> t_hit;
+      double time = 0.;
+      switch (packet_size) {
+        case 4:
+          time = time_packets<4>(tracer, rays, use_simd, t_hit);
+          break;
+        case 8:
+          time = time_packets<8>(tracer, rays, use_simd, t_hit);
+          break;
+        default:
+          time = time_packets<16>(tracer, rays, use_simd, t_hit);
+          break;
+      }
+
+      double max_diff = 0.;
+      size_t mismatches = 0;
+      for (size_t r = 0; r < rays.size(); r++) {
+        if ((reference[r] < 0.) != (t_hit[r] < 0.)) {
+          mismatches++;
+        } else if (reference[r] >= 0.) {
+          double diff = std::abs(reference[r] - t_hit[r]);
+          max_diff = std::max(max_diff, diff);
+          if (diff > tolerance) mismatches++;
+        }
+      }
+
+      std::cout << std::setprecision(4) << std::setw(10) << packet_size << std::setw(8) << (use_simd ? "yes" : "no")
+                << std::setw(12) << time << std::setw(12) << std::setprecision(2) << rays.size() / time * 1e-6
+                << std::setw(10) << single_time / time << std::setw(12) << std::scientific << std::setprecision(1)
+                << max_diff << std::fixed << std::setw(12) << mismatches << std::endl;
+    }
+  }
+
+  if (has_flag(args, "--frame")) {
+    raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth);
+    for (size_t packet_size : {0, 4, 8, 16}) {
+      raytracer.set_packet_size(packet_size);
+      stop_watch.start();
+      raytracer.calcImage(cam, "bench", false);
+      std::cout << "frame with packet size " << packet_size << ": " << std::setprecision(4) << stop_watch.stop() << "s"
+                << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+// rays per second of the recursive raytrace against the breadth first wavefrontTrace
+int bench_wavefront(const std::vector<std::string>& args) {
+  const size_t frames = option_value(args, "--frames", 3);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>();
+
+  raytrace recursive(world, materials, image_width, image_height, samples_per_pixel, max_depth, pool);
+  // the wavefront traces every path until it leaves the scene
+  recursive.set_roulette_depth(0);
+  wavefrontTrace wavefront(world, materials, image_width, image_height, samples_per_pixel, max_depth, pool);
+
+  stopWatch stop_watch;
+  double recursive_time = 0.;
+  double wavefront_time = 0.;
+  size_t rays = 0;
+
+  for (size_t frame = 0; frame < frames; frame++) {
+    stop_watch.start();
+    recursive.calcImage(cam, "bench", false);
+    recursive_time += stop_watch.stop();
+
+    stop_watch.start();
+    wavefront.calcImage(cam, "bench");
+    wavefront_time += stop_watch.stop();
+    rays += wavefront.rays_traced();
+  }
+
+  // both trace the same paths in expectation, so the ray count of the wavefront is used for both
+  std::cout << "rays per frame " << rays / frames << std::endl;
+  std::cout << std::fixed << std::setprecision(4) << "recursive: " << recursive_time / frames << "s per frame, "
+            << std::setprecision(2) << rays / recursive_time * 1e-6 << " Mrays/s" << std::endl;
+  std::cout << std::setprecision(4) << "wavefront: " << wavefront_time / frames << "s per frame, "
+            << std::setprecision(2) << rays / wavefront_time * 1e-6 << " Mrays/s" << std::endl;
+  std::cout << "speedup " << recursive_time / wavefront_time << std::endl;
+
+  return 0;
+}
+
+// Wavefront renderer with and without sorting of the secondary rays: frame time, rays per second and the cache misses
+// per ray from the hardware counters if the system allows perf_event_open. --scale multiplies the image size, larger
+// frames give longer sorted runs.
+int bench_ray_sorting(const std::vector<std::string>& args) {
+  const size_t frames = option_value(args, "--frames", 3);
+  const size_t scale = std::max<size_t>(1, option_value(args, "--scale", 2));
+  const size_t width = scale * image_width;
+  const size_t height = scale * image_height;
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+
+  // before the pool, the counters are only inherited by threads started later
+  perfCounters perf;
+  if (!perf.any_available()) std::cout << "hardware counters not available, only the time is measured" << std::endl;
+  auto pool = std::make_shared<threadPool>();
+
+  wavefrontTrace wavefront(world, materials, width, height, samples_per_pixel, max_depth, pool);
+  std::string reference_image;
+  double unsorted_rays_per_second = 0.;
+
+  std::cout << std::setw(10) << "rays" << std::setw(12) << "frame [s]" << std::setw(12) << "Mrays/s";
+  for (size_t e = 0; e < perfCounters::event_count; e++) {
+    const auto event = static_cast<perfCounters::event>(e);
+    if (perf.available(event)) std::cout << std::setw(18) << std::string(perfCounters::name(event)) + "/ray";
+  }
+  std::cout << std::endl;
+
+  stopWatch stop_watch;
+  for (bool sorted : {false, true}) {
+    wavefront.set_ray_sorting(sorted);
+    double time = 0.;
+    size_t rays = 0;
+    perfCounters::values events{};
+    for (size_t frame = 0; frame < frames; frame++) {
+      perf.start();
+      stop_watch.start();
+      ImageWrapper image = wavefront.calcImage(cam, "bench");
+      time += stop_watch.stop();
+      const perfCounters::values frame_events = perf.stop();
+      for (size_t e = 0; e < perfCounters::event_count; e++) {
+        events[e] += frame_events[e];
+      }
+      rays += wavefront.rays_traced();
+
+      image.set_type(image_type::pfm);
+      if (!sorted && frame == 0) {
+        reference_image = image.encode();
+      } else if (image.encode() != reference_image) {
+        std::cerr << "sorted image differs from the unsorted image" << std::endl;
+        return 1;
+      }
+    }
+
+    const double rays_per_second = rays / time;
+    if (!sorted) unsorted_rays_per_second = rays_per_second;
+    std::cout << std::fixed << std::setw(10) << (sorted ? "sorted" : "unsorted") << std::setprecision(4)
+              << std::setw(12) << time / frames << std::setprecision(2) << std::setw(12) << rays_per_second * 1e-6;
+    for (size_t e = 0; e < perfCounters::event_count; e++) {
+      if (perf.available(static_cast<perfCounters::event>(e))) {
+        std::cout << std::setprecision(3) << std::setw(18) << static_cast<double>(events[e]) / rays;
+      }
+    }
+    std::cout << std::endl;
+    if (sorted) std::cout << "speedup " << rays_per_second / unsorted_rays_per_second << std::endl;
+  }
+  std::cout << "rays per frame " << wavefront.rays_traced() << ", the images are identical" << std::endl;
+
+  return 0;
+}
+
+#if defined(RAYTRACING_FLOAT)
+const std::string precision_name = "float";
+#elif defined(RAYTRACING_MIXED)
+const std::string precision_name = "mixed";
+#else
+const std::string precision_name = "double";
+#endif
+
+// The buffers of the benchmarks have the rows from bottom to top like PFM, the ones of imageEncoder from top to bottom.
+void write_pfm(const std::string& filename, size_t width, size_t height, const std::vector<color>& pixels) {
+  std::vector<float> rgb(3 * width * height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const color& pixel = pixels[(height - 1 - y) * width + x];
+      for (int c = 0; c < 3; c++) rgb[3 * (y * width + x) + c] = static_cast<float>(pixel[c]);
+    }
+  }
+  std::ofstream(filename, std::ios::binary) << imageEncoder::encode(image_type::pfm, width, height, rgb.data());
+}
+
+bool read_pfm(const std::string& filename, size_t width, size_t height, std::vector<color>& pixels) {
+  std::ifstream file(filename, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  if (!file) return false;
+
+  uint32_t file_width, file_height;
+  std::vector<float> rgb;
+  try {
+    rgb = imageEncoder::decode_pfm(content.str(), file_width, file_height);
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+  if (file_width != width || file_height != height) return false;
+
+  pixels.resize(width * height);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      const float* pixel = rgb.data() + 3 * (y * width + x);
+      pixels[(height - 1 - y) * width + x] = color(pixel[0], pixel[1], pixel[2]);
+    }
+  }
+  return true;
+}
+
+// Renders a frame into a linear buffer (mean of the samples, rows bottom to top like PFM) and writes it as PFM.
+// With --reference the result of another build, e.g. the double build, is compared with this one.
+int bench_precision(const std::vector<std::string>& args) {
+  const size_t spp = option_value(args, "--spp", 16);
+  const auto output = std::find(args.begin(), args.end(), "--output");
+  const auto reference = std::find(args.begin(), args.end(), "--reference");
+  const std::string output_file =
+      (output != args.end() && output + 1 != args.end()) ? *(output + 1) : "precision_" + precision_name + ".pfm";
+
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  // one thread, so the random numbers are drawn in the same order in every build
+  raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, std::make_shared<threadPool>(1));
+
+  std::vector<color> pixels(image_width * image_height);
+  stopWatch stop_watch;
+  stop_watch.start();
+  for (size_t j = 0; j < image_height; j++) {
+    for (size_t i = 0; i < image_width; i++) {
+      pixels[j * image_width + i] = raytracer.calcPixel(cam, i, j, spp) / static_cast<real>(spp);
+    }
+  }
+  double time = stop_watch.stop();
+
+  std::cout << "precision " << precision_name << " (sizeof(real) " << sizeof(real) << ", sizeof(precise_real) "
+            << sizeof(precise_real) << ")" << std::endl;
+  std::cout << std::fixed << std::setprecision(4) << "render time " << time << "s, " << std::setprecision(2)
+            << image_width * image_height * spp / time * 1e-6 << " Msamples/s" << std::endl;
+
+  write_pfm(output_file, image_width, image_height, pixels);
+  std::cout << "written " << output_file << std::endl;
+
+  if (reference != args.end() && reference + 1 != args.end()) {
+    std::vector<color> reference_pixels;
+    if (!read_pfm(*(reference + 1), image_width, image_height, reference_pixels)) {
+      std::cerr << "can't read reference " << *(reference + 1) << std::endl;
+      return 1;
+    }
+
+    double squared_error = 0.;
+    double max_error = 0.;
+    for (size_t p = 0; p < pixels.size(); p++) {
+      for (int c = 0; c < 3; c++) {
+        double error = std::abs(static_cast<double>(pixels[p][c]) - reference_pixels[p][c]);
+        squared_error += error * error;
+        max_error = std::max(max_error, error);
+      }
+    }
+    double rmse = std::sqrt(squared_error / (3 * pixels.size()));
+
+    std::cout << std::scientific << std::setprecision(3) << "compared to " << *(reference + 1) << ": rmse " << rmse
+              << ", max error " << max_error << std::fixed << std::setprecision(1) << ", psnr "
+              << 20. * std::log10(1. / rmse) << "dB" << std::endl;
+  }
+
+  return 0;
+}
+
+// root mean square error of the displayed (gamma corrected) values against a reference
+double display_rmse(const std::vector<pixel_estimate>& pixels, const std::vector<pixel_estimate>& reference) {
+  double squared_error = 0.;
+  for (size_t p = 0; p < pixels.size(); p++) {
+    for (int c = 0; c < 3; c++) {
+      double value = std::sqrt(std::max(0., static_cast<double>(pixels[p].sum[c]) / pixels[p].count));
+      double reference_value = std::sqrt(std::max(0., static_cast<double>(reference[p].sum[c]) / reference[p].count));
+      squared_error += (value - reference_value) * (value - reference_value);
+    }
+  }
+  return std::sqrt(squared_error / (3 * pixels.size()));
+}
+
+// Time to quality of adaptive sampling against fixed samples per pixel. The error is measured against a high spp
+// reference, the time fixed spp needs for the error of an adaptive run is interpolated log-log.
+int bench_adaptive(const std::vector<std::string>& args) {
+  const size_t reference_spp = option_value(args, "--reference-spp", 512);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>();
+  stopWatch stop_watch;
+
+  raytrace reference_tracer(world, materials, image_width, image_height, reference_spp, max_depth, pool);
+  reference_tracer.render(cam);
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+
+  const std::vector<size_t> spps = {4, 8, 16, 32, 64};
+  std::vector<double> fixed_time, fixed_error;
+
+  std::cout << std::setw(10) << "mode" << std::setw(8) << "spp" << std::setw(10) << "max spp" << std::setw(12)
+            << "time [s]" << std::setw(12) << "rmse" << std::setw(22) << "fixed time same rmse" << std::setw(10)
+            << "speedup" << std::endl;
+
+  for (size_t spp : spps) {
+    raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, pool);
+    stop_watch.start();
+    raytracer.render(cam);
+    fixed_time.push_back(stop_watch.stop());
+    fixed_error.push_back(display_rmse(raytracer.pixel_estimates(), reference));
+
+    std::cout << std::fixed << std::setw(10) << "fixed" << std::setw(8) << spp << std::setw(10) << spp
+              << std::setprecision(4) << std::setw(12) << fixed_time.back() << std::setw(12) << fixed_error.back()
+              << std::endl;
+  }
+
+  for (size_t spp : spps) {
+    raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, pool);
+    adaptive_settings settings;
+    settings.enabled = true;
+    settings.min_samples = std::max<size_t>(4, spp / 2);
+    settings.max_samples = 16 * spp;
+    raytracer.set_adaptive(settings);
+
+    stop_watch.start();
+    raytracer.render(cam);
+    double time = stop_watch.stop();
+    double error = display_rmse(raytracer.pixel_estimates(), reference);
+
+    size_t total_samples = 0;
+    uint32_t max_samples = 0;
+    for (const auto& estimate : raytracer.pixel_estimates()) {
+      total_samples += estimate.count;
+      max_samples = std::max(max_samples, estimate.count);
+    }
+
+    std::cout << std::setw(10) << "adaptive" << std::setw(8) << std::setprecision(1)
+              << static_cast<double>(total_samples) / reference.size() << std::setw(10) << max_samples
+              << std::setprecision(4) << std::setw(12) << time << std::setw(12) << error;
+
+    // interpolate between the fixed runs enclosing the error
+    for (size_t k = 0; k + 1 < spps.size(); k++) {
+      if (fixed_error[k] >= error && error >= fixed_error[k + 1]) {
+        double f = std::log(fixed_error[k] / error) / std::log(fixed_error[k] / fixed_error[k + 1]);
+        double equal_time = std::exp(std::log(fixed_time[k]) + f * std::log(fixed_time[k + 1] / fixed_time[k]));
+        std::cout << std::setw(22) << equal_time << std::setw(10) << std::setprecision(2) << equal_time / time;
+        break;
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
+
+// Throughput of the counter based generator against the previous thread_local minstd_rand with a
+// uniform_real_distribution per call, and check that a frame doesn't depend on the number of threads
+int bench_rng(const std::vector<std::string>& args) {
+  const size_t count = option_value(args, "--count", 100000000);
+  stopWatch stop_watch;
+
+  std::cout << std::setw(24) << "generator" << std::setw(12) << "time [s]" << std::setw(14) << "M numbers/s"
+            << std::setw(12) << "mean" << std::endl;
+  const auto report = [&](const char* name, double time, double sum) {
+    std::cout << std::fixed << std::setw(24) << name << std::setprecision(4) << std::setw(12) << time
+              << std::setprecision(1) << std::setw(14) << count / time / 1e6 << std::setprecision(5) << std::setw(12)
+              << sum / count << std::endl;
+  };
+
+  {
+    static thread_local std::minstd_rand generator;
+    double sum = 0.;
+    stop_watch.start();
+    for (size_t n = 0; n < count; n++) {
+      std::uniform_real_distribution<double> distribution(0.0, 1.0);
+      sum += distribution(generator);
+    }
+    report("minstd_rand", stop_watch.stop(), sum);
+  }
+
+  {
+    counterRng generator;
+    generator.set_stream(counterRng::key(0, 0, 0));
+    double sum = 0.;
+    stop_watch.start();
+    for (size_t n = 0; n < count; n++) {
+      sum += generator.uniform<double>();
+    }
+    report("counterRng", stop_watch.stop(), sum);
+  }
+
+  {
+    constexpr size_t lanes = 8;
+    uint64_t keys[lanes];
+    double numbers[lanes];
+    for (size_t lane = 0; lane < lanes; lane++) {
+      keys[lane] = counterRng::key(0, 0, lane);
+    }
+    double sum = 0.;
+    stop_watch.start();
+    for (size_t n = 0; n < count; n += lanes) {
+      counterRng::uniform(keys, n / lanes, numbers);
+      for (size_t lane = 0; lane < lanes; lane++) {
+        sum += numbers[lane];
+      }
+    }
+    report("counterRng 8 lanes", stop_watch.stop(), sum);
+  }
+
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  adaptive_settings settings;
+  settings.enabled = true;
+
+  std::cout << std::endl << std::setw(10) << "threads" << std::setw(12) << "fixed" << std::setw(12) << "adaptive"
+            << std::endl;
+  std::vector<pixel_estimate> reference[2];
+  for (size_t num_threads : {1, 2, 4, 7}) {
+    raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth,
+                       std::make_shared<threadPool>(num_threads));
+    std::cout << std::setw(10) << num_threads;
+    for (int adaptive = 0; adaptive < 2; adaptive++) {
+      settings.enabled = adaptive;
+      raytracer.set_adaptive(settings);
+      raytracer.render(cam);
+
+      const auto& estimates = raytracer.pixel_estimates();
+      if (reference[adaptive].empty()) reference[adaptive] = estimates;
+      const bool identical = std::equal(estimates.begin(), estimates.end(), reference[adaptive].begin(),
+                                        [](const pixel_estimate& a, const pixel_estimate& b) {
+                                          return a.count == b.count && a.sum == b.sum;
+                                        });
+      std::cout << std::setw(12) << (identical ? "identical" : "DIFFERENT");
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
+
+// Frame loop with the image written on the render thread after every frame against the asynchronous writer queue
+int bench_writer(const std::vector<std::string>& args) {
+  const size_t num_frames = option_value(args, "--frames", 20);
+  const size_t queue_capacity = option_value(args, "--queue", 2);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth);
+  stopWatch stop_watch, frame_watch;
+
+  std::cout << std::setw(8) << "mode" << std::setw(12) << "total [s]" << std::setw(12) << "render [s]" << std::setw(12)
+            << "encode [s]" << std::setw(12) << "write [s]" << std::setw(12) << "wait [s]" << std::endl;
+  const auto report = [&](const char* mode, double total, double render, double encode, double write, double wait) {
+    std::cout << std::fixed << std::setprecision(4) << std::setw(8) << mode << std::setw(12) << total << std::setw(12)
+              << render << std::setw(12) << encode << std::setw(12) << write << std::setw(12) << wait << std::endl;
+  };
+
+  {
+    double render = 0., encode = 0., write = 0.;
+    stop_watch.start();
+    for (size_t frame = 0; frame < num_frames; frame++) {
+      raytracer.set_frame(frame);
+      frame_watch.start();
+      ImageWrapper image = raytracer.calcImage(cam, "bench_writer" + std::to_string(frame), false);
+      render += frame_watch.stop();
+
+      frame_watch.start();
+      const std::string data = image.encode();
+      encode += frame_watch.stop();
+
+      frame_watch.start();
+      ImageWrapper::write_file(image.filename(), data);
+      write += frame_watch.stop();
+    }
+    report("sync", stop_watch.stop(), render, encode, write, encode + write);
+  }
+
+  {
+    double render = 0., wait = 0.;
+    imageWriter writer(queue_capacity);
+    stop_watch.start();
+    for (size_t frame = 0; frame < num_frames; frame++) {
+      raytracer.set_frame(frame);
+      frame_watch.start();
+      ImageWrapper image = raytracer.calcImage(cam, "bench_writer" + std::to_string(frame), false);
+      render += frame_watch.stop();
+
+      wait += writer.push(std::move(image));
+    }
+    frame_watch.start();
+    writer.finish();
+    wait += frame_watch.stop();
+    const double total = stop_watch.stop();
+
+    double encode = 0., write = 0.;
+    for (const auto& stats : writer.stats()) {
+      encode += stats.encode_time;
+      write += stats.write_time;
+    }
+    report("async", total, render, encode, write, wait);
+  }
+
+  return 0;
+}
+
+// Bytes and time per frame of the image writers, "p3 operator<<" is the previous writer which printed the color
+// vectors with operator<<
+int bench_image(const std::vector<std::string>& args) {
+  const size_t num_frames = option_value(args, "--frames", 20);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth);
+  ImageWrapper image = raytracer.calcImage(cam, "bench_image", false);
+  stopWatch stop_watch;
+
+  std::cout << std::setw(16) << "type" << std::setw(12) << "bytes" << std::setw(14) << "encode [ms]" << std::setw(14)
+            << "write [ms]" << std::setw(12) << "MB/s" << std::endl;
+  const auto report = [&](const std::string& name, size_t bytes, double encode_time, double write_time) {
+    std::cout << std::fixed << std::setw(16) << name << std::setw(12) << bytes << std::setprecision(3)
+              << std::setw(14) << 1e3 * encode_time / num_frames << std::setw(14) << 1e3 * write_time / num_frames
+              << std::setprecision(1) << std::setw(12) << 1e-6 * bytes * num_frames / (encode_time + write_time)
+              << std::endl;
+  };
+
+  {
+    // the 8 bit values of the frame like the previous write_color stored them
+    std::vector<color> pixels;
+    for (const auto& estimate : raytracer.pixel_estimates()) {
+      color value = estimate.sum / static_cast<real>(estimate.count);
+      pixels.emplace_back(static_cast<int>(256 * clamp(std::sqrt(value[0]), 0.0, 0.999)),
+                          static_cast<int>(256 * clamp(std::sqrt(value[1]), 0.0, 0.999)),
+                          static_cast<int>(256 * clamp(std::sqrt(value[2]), 0.0, 0.999)));
+    }
+    size_t bytes = 0;
+    stop_watch.start();
+    for (size_t frame = 0; frame < num_frames; frame++) {
+      std::ofstream file("bench_image_old.p3");
+      file << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+      for (const auto& pixel : pixels) {
+        file << pixel << " ";
+      }
+      bytes = file.tellp();
+    }
+    double time = stop_watch.stop();
+    std::remove("bench_image_old.p3");
+    report("p3 operator<<", bytes, 0., time);
+  }
+
+  for (image_type type : {image_type::p3, image_type::p6, image_type::pfm, image_type::hdr}) {
+    image.set_type(type);
+    std::string data;
+    double encode_time = 0., write_time = 0.;
+    for (size_t frame = 0; frame < num_frames; frame++) {
+      stop_watch.start();
+      data = image.encode();
+      encode_time += stop_watch.stop();
+
+      stop_watch.start();
+      ImageWrapper::write_file(image.filename(), data);
+      write_time += stop_watch.stop();
+    }
+    std::remove(image.filename().c_str());
+    report(imageEncoder::type_name(type), data.size(), encode_time, write_time);
+  }
+
+  return 0;
+}
+
+// Load time of a scene with about count spheres from the text file and from the binary cache
+int bench_scene(const std::vector<std::string>& args) {
+  const size_t count = option_value(args, "--count", 1000000);
+  const std::string text_file = "bench_scene.scene";
+  const std::string cache_file = sceneLoader::cache_filename(text_file);
+
+  scene generated;
+  const int grid_extent = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count)) / 2));
+  *generated.world = randomWorld::generate_random_scene(*generated.materials, grid_extent);
+  sceneLoader::save_text(generated, text_file);
+  sceneLoader::save_binary(generated, cache_file);
+
+  std::cout << generated.world->objects.size() << " spheres, " << generated.materials->size() << " materials"
+            << std::endl;
+  std::cout << std::setw(8) << "file" << std::setw(14) << "bytes" << std::setw(14) << "load [s]" << std::setw(14)
+            << "M objects/s" << std::endl;
+
+  stopWatch stop_watch;
+  for (const std::string& file : {text_file, cache_file}) {
+    stop_watch.start();
+    scene loaded = file == text_file ? sceneLoader::load_text(file) : sceneLoader::load_binary(file);
+    double time = stop_watch.stop();
+
+    if (loaded.world->objects.size() != generated.world->objects.size()) {
+      std::cerr << file << " has the wrong number of objects" << std::endl;
+      return 1;
+    }
+    std::cout << std::fixed << std::setw(8) << (file == text_file ? "text" : "cache") << std::setw(14)
+              << std::filesystem::file_size(file) << std::setprecision(4) << std::setw(14) << time
+              << std::setprecision(2) << std::setw(14) << loaded.world->objects.size() / time * 1e-6 << std::endl;
+  }
+
+  std::remove(text_file.c_str());
+  std::remove(cache_file.c_str());
+  return 0;
+}
+
+// UV sphere of radius 1 around (0, 1, 0) with about target_triangles triangles, counterclockwise seen from outside
+void uv_sphere(size_t target_triangles, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+  // rings between the poles and segments around them, 2 * segments * (rings - 1) triangles
+  const size_t rings = std::max<size_t>(3, static_cast<size_t>(std::sqrt(target_triangles / 4.)));
+  const size_t segments = 2 * rings;
+  vertices = {0, 2, 0};
+  for (size_t ring = 1; ring < rings; ring++) {
+    const double theta = pi * ring / rings;
+    for (size_t segment = 0; segment < segments; segment++) {
+      const double phi = 2 * pi * segment / segments;
+      vertices.insert(vertices.end(), {static_cast<float>(std::sin(theta) * std::cos(phi)),
+                                       static_cast<float>(1 + std::cos(theta)),
+                                       static_cast<float>(std::sin(theta) * std::sin(phi))});
+    }
+  }
+  vertices.insert(vertices.end(), {0, 0, 0});
+
+  const auto vertex = [&](size_t ring, size_t segment) {
+    return static_cast<uint32_t>(1 + (ring - 1) * segments + segment % segments);
+  };
+  const uint32_t south = static_cast<uint32_t>(1 + (rings - 1) * segments);
+  indices.clear();
+  for (size_t segment = 0; segment < segments; segment++) {
+    indices.insert(indices.end(), {0, vertex(1, segment + 1), vertex(1, segment)});
+    for (size_t ring = 1; ring + 1 < rings; ring++) {
+      indices.insert(indices.end(), {vertex(ring, segment), vertex(ring, segment + 1), vertex(ring + 1, segment + 1),
+                                     vertex(ring, segment), vertex(ring + 1, segment + 1), vertex(ring + 1, segment)});
+    }
+    indices.insert(indices.end(), {south, vertex(rings - 1, segment), vertex(rings - 1, segment + 1)});
+  }
+}
+
+// UV sphere of about --triangles triangles written as OBJ: OBJ import with bvh build against the mapped binary mesh,
+// the bytes per triangle, rays aimed exactly at the vertices and edge midpoints from the center (every one has to hit
+// the closed mesh) and the rays per second of a frame with the mesh against the same frame with an analytic sphere.
+int bench_mesh(const std::vector<std::string>& args) {
+  const size_t target_triangles = option_value(args, "--triangles", 1000000);
+  const std::string obj_file = "bench_mesh.obj";
+  const std::string binary_file = meshLoader::cache_filename(obj_file);
+  const point3 center(0, 1, 0);
+
+  {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    uv_sphere(target_triangles, vertices, indices);
+    std::ofstream obj(obj_file);
+    for (size_t k = 0; k < vertices.size(); k += 3) {
+      obj << "v " << vertices[k] << " " << vertices[k + 1] << " " << vertices[k + 2] << "\n";
+    }
+    for (size_t k = 0; k < indices.size(); k += 3) {
+      obj << "f " << indices[k] + 1 << " " << indices[k + 1] + 1 << " " << indices[k + 2] + 1 << "\n";
+    }
+  }
+
+  auto materials = std::make_shared<material_table>();
+  const uint32_t ground = materials->add(lambertian(color(0.5, 0.5, 0.5)));
+  const uint32_t red = materials->add(lambertian(color(0.7, 0.2, 0.1)));
+
+  stopWatch stop_watch;
+  stop_watch.start();
+  std::shared_ptr<triangle_mesh> mesh = meshLoader::load_obj(obj_file, red);
+  const double obj_time = stop_watch.stop();
+  meshLoader::save_binary(*mesh, binary_file);
+  stop_watch.start();
+  std::shared_ptr<triangle_mesh> mapped = meshLoader::load_binary(binary_file, red);
+  const double binary_time = stop_watch.stop();
+
+  const size_t bytes = mesh->num_vertices() * 3 * sizeof(float) + mesh->num_triangles() * 3 * sizeof(uint32_t) +
+                       mesh->tree().num_nodes() * sizeof(bvh_node);
+  std::cout << mesh->num_triangles() << " triangles, " << mesh->num_vertices() << " vertices, " << std::fixed
+            << std::setprecision(1) << static_cast<double>(bytes) / mesh->num_triangles() << " bytes per triangle"
+            << std::endl;
+  std::cout << std::setprecision(4) << "OBJ " << std::filesystem::file_size(obj_file) << " bytes, import and bvh build "
+            << obj_time << "s" << std::endl;
+  std::cout << "binary " << std::filesystem::file_size(binary_file) << " bytes, load " << binary_time * 1e3 << "ms"
+            << std::endl;
+
+  // the shared vertices and edges of the triangles are the critical rays of a watertight test
+  size_t leaks = 0;
+  size_t aimed = 0;
+  hit_record rec;
+  for (size_t triangle = 0; triangle < mapped->num_triangles(); triangle++) {
+    const uint32_t* corners = mapped->indices() + 3 * triangle;
+    for (int k = 0; k < 3; k++) {
+      const float* a = mapped->vertices() + 3 * corners[k];
+      const float* b = mapped->vertices() + 3 * corners[(k + 1) % 3];
+      for (const point3& target : {point3(a[0], a[1], a[2]), point3((a[0] + b[0]) / 2, (a[1] + b[1]) / 2,
+                                                                    (a[2] + b[2]) / 2)}) {
+        aimed++;
+        if (!mapped->hit(ray(center, target - center), 0.001, infinity, rec)) leaks++;
+      }
+    }
+  }
+  std::cout << "rays at vertices and edges from the inside: " << leaks << " of " << aimed << " missed" << std::endl;
+
+  const camera cam = default_camera();
+  auto pool = std::make_shared<threadPool>();
+  for (bool use_mesh : {false, true}) {
+    hittable_list objects;
+    objects.add(std::make_shared<sphere>(point3(0, -1000, 0), 1000, ground));
+    if (use_mesh) {
+      objects.add(mapped);
+    } else {
+      objects.add(std::make_shared<sphere>(center, 1, red));
+    }
+    raytrace raytracer(std::make_shared<bvh>(objects), materials, image_width, image_height, samples_per_pixel,
+                       max_depth, pool);
+    traceStats::reset();
+    stop_watch.start();
+    raytracer.render(cam);
+    const double time = stop_watch.stop();
+    const trace_counters counters = traceStats::collect();
+    std::cout << std::setw(8) << (use_mesh ? "mesh" : "sphere") << ": " << std::setprecision(4) << time
+              << "s per frame, " << std::setprecision(2) << counters.rays / time * 1e-6 << " Mrays/s" << std::endl;
+  }
+
+  std::remove(obj_file.c_str());
+  std::remove(binary_file.c_str());
+  return leaks == 0 ? 0 : 1;
+}
+
+// About --instances copies of a UV sphere mesh of --triangles triangles, each rotated, scaled, translated onto a
+// grid and with its own material: heap bytes, build time and render time of the instances against copies of the mesh
+// with the transform baked into the vertices. The copies are only built up to 2M triangles, the instances are
+// measured at that count and at the full count.
+int bench_instances(const std::vector<std::string>& args) {
+  const size_t count = option_value(args, "--instances", 100000);
+  const size_t target_triangles = option_value(args, "--triangles", 5000);
+  const size_t max_flattened_triangles = 2000000;
+  constexpr size_t num_materials = 16;
+
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  uv_sphere(target_triangles, vertices, indices);
+
+  auto materials = std::make_shared<material_table>();
+  const uint32_t ground = materials->add(lambertian(color(0.5, 0.5, 0.5)));
+  for (size_t m = 0; m < num_materials; m++) {
+    if (m % 4 == 3) {
+      materials->add(metal(random_vec3(.5, 1), random_double(0, .5)));
+    } else {
+      materials->add(lambertian(random_vec3().cwiseProduct(random_vec3())));
+    }
+  }
+
+  // like the small spheres of the random scene, with a random orientation and size
+  const int grid_extent = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count)) / 2));
+  std::vector<affine_transform> transforms;
+  std::vector<uint32_t> instance_materials;
+  for (int a = -grid_extent; a < grid_extent; a++) {
+    for (int b = -grid_extent; b < grid_extent; b++) {
+      const real size = random_real(0.15, 0.25);
+      transforms.push_back(affine_transform::translation(vec3(a + 0.9 * random_real(), 0, b + 0.9 * random_real())) *
+                           affine_transform::rotation(random_vec3(-1, 1), random_real(0, 360)) *
+                           affine_transform::scaling(vec3(size, size, size)));
+      instance_materials.push_back(1 + static_cast<uint32_t>(random_real() * num_materials) % num_materials);
+    }
+  }
+
+  stopWatch stop_watch;
+  auto geometry = std::make_shared<const triangle_mesh>(vertices, indices, ground);
+  const size_t mesh_bytes = geometry->num_vertices() * 3 * sizeof(float) +
+                            geometry->num_triangles() * 3 * sizeof(uint32_t) +
+                            geometry->tree().num_nodes() * sizeof(bvh_node);
+  const size_t num_flattened = std::min(transforms.size(), max_flattened_triangles / geometry->num_triangles());
+  std::cout << "mesh of " << geometry->num_triangles() << " triangles, " << std::fixed << std::setprecision(1)
+            << mesh_bytes * 1e-3 << " kB" << std::endl;
+  std::cout << std::setw(10) << "scene" << std::setw(11) << "objects" << std::setw(14) << "heap [MB]" << std::setw(12)
+            << "bytes/obj" << std::setw(12) << "build [s]" << std::setw(12) << "frame [s]" << std::setw(10)
+            << "Mrays/s" << std::endl;
+
+  const camera cam = default_camera();
+  auto pool = std::make_shared<threadPool>();
+  for (auto [instanced, num_objects] : {std::pair<bool, size_t>{false, num_flattened}, {true, num_flattened},
+                                        {true, transforms.size()}}) {
+    const size_t heap_before = mallinfo2().uordblks;
+    stop_watch.start();
+    hittable_list objects;
+    objects.objects.reserve(num_objects + 1);
+    objects.add(std::make_shared<sphere>(point3(0, -1000, 0), 1000, ground));
+    auto arena = objectArena::create();
+    arena->reserve<instance>(instanced ? num_objects : 0);
+    for (size_t n = 0; n < num_objects; n++) {
+      if (instanced) {
+        objects.add(arena->make<instance>(geometry, transforms[n], instance_materials[n]));
+      } else {
+        std::vector<float> baked(vertices.size());
+        for (size_t k = 0; k < vertices.size(); k += 3) {
+          const point3 p = transforms[n].apply_point(point3(vertices[k], vertices[k + 1], vertices[k + 2]));
+          baked[k] = p[0];
+          baked[k + 1] = p[1];
+          baked[k + 2] = p[2];
+        }
+        objects.add(std::make_shared<triangle_mesh>(std::move(baked), indices, instance_materials[n]));
+      }
+    }
+    auto world = std::make_shared<bvh>(objects);
+    const double build_time = stop_watch.stop();
+    const size_t heap = mallinfo2().uordblks - heap_before;
+    arena.reset();
+    objects.clear();
+
+    raytrace raytracer(world, materials, image_width, image_height, samples_per_pixel, max_depth, pool);
+    traceStats::reset();
+    stop_watch.start();
+    raytracer.render(cam);
+    const double time = stop_watch.stop();
+    const trace_counters counters = traceStats::collect();
+    std::cout << std::setw(10) << (instanced ? "instanced" : "copies") << std::setw(11) << num_objects
+              << std::setprecision(1) << std::setw(14) << heap * 1e-6 << std::setw(12)
+              << static_cast<double>(heap) / num_objects << std::setprecision(3) << std::setw(12) << build_time
+              << std::setprecision(4) << std::setw(12) << time << std::setprecision(2) << std::setw(10)
+              << counters.rays / time * 1e-6 << std::endl;
+  }
+  std::cout << std::setprecision(1) << transforms.size() << " copies would need "
+            << transforms.size() * mesh_bytes * 1e-9 << " GB" << std::endl;
+
+  return 0;
+}
+
+// Scene construction with one make_shared per sphere against the objectArena: heap bytes, build time and the time
+// to intersect random rays with a bvh over the spheres
+int bench_arena(const std::vector<std::string>& args) {
+  const size_t count = option_value(args, "--count", 1000000);
+  const size_t num_rays = option_value(args, "--rays", 1000000);
+  const int grid_extent = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count)) / 2));
+
+  std::vector<point3> centers;
+  for (int a = -grid_extent; a < grid_extent; a++) {
+    for (int b = -grid_extent; b < grid_extent; b++) {
+      centers.emplace_back(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+    }
+  }
+  std::vector<ray> rays;
+  for (size_t n = 0; n < num_rays; n++) {
+    point3 origin(random_double(-grid_extent, grid_extent), 2., random_double(-grid_extent, grid_extent));
+    rays.emplace_back(origin, vec3(random_double(-1, 1), -1., random_double(-1, 1)));
+  }
+
+  std::cout << centers.size() << " spheres, " << rays.size() << " rays" << std::endl;
+  std::cout << std::setw(12) << "allocation" << std::setw(14) << "heap [MB]" << std::setw(16) << "bytes/sphere"
+            << std::setw(12) << "build [s]" << std::setw(12) << "bvh [s]" << std::setw(12) << "rays [s]" << std::endl;
+
+  for (bool use_arena : {false, true}) {
+    stopWatch stop_watch;
+    const size_t heap_before = mallinfo2().uordblks;
+    stop_watch.start();
+
+    hittable_list world;
+    world.objects.reserve(centers.size());
+    if (use_arena) {
+      auto arena = objectArena::create();
+      arena->reserve<sphere>(centers.size());
+      for (const point3& center : centers) {
+        world.add(arena->make<sphere>(center, 0.2, 0));
+      }
+    } else {
+      for (const point3& center : centers) {
+        world.add(std::make_shared<sphere>(center, 0.2, 0));
+      }
+    }
+    const double build_time = stop_watch.stop();
+    const size_t heap = mallinfo2().uordblks - heap_before;
+
+    stop_watch.start();
+    bvh tree(world);
+    const double bvh_time = stop_watch.stop();
+
+    size_t hits = 0;
+    hit_record rec;
+    stop_watch.start();
+    for (const ray& r : rays) {
+      hits += tree.hit(r, 0.001, infinity, rec);
+    }
+    const double ray_time = stop_watch.stop();
+
+    std::cout << std::fixed << std::setw(12) << (use_arena ? "arena" : "make_shared") << std::setprecision(1)
+              << std::setw(14) << heap * 1e-6 << std::setw(16) << static_cast<double>(heap) / centers.size()
+              << std::setprecision(4) << std::setw(12) << build_time << std::setw(12) << bvh_time << std::setw(12)
+              << ray_time << "  (" << hits << " hits)" << std::endl;
+  }
+
+  return 0;
+}
+
+// Camera orbit like the application: every frame rendered from scratch against temporal reuse of the previous frame.
+// The error of the last frame is measured against a high spp reference.
+int bench_temporal(const std::vector<std::string>& args) {
+  const size_t num_frames = option_value(args, "--frames", 20);
+  const size_t spp = option_value(args, "--spp", 32);
+  const size_t reference_spp = option_value(args, "--reference-spp", 512);
+  constexpr real rotation_angle_delta = 0.01;
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  raytrace raytracer(world, materials, image_width, image_height, spp, max_depth);
+  stopWatch stop_watch;
+
+  const auto frame_camera = [](size_t frame) {
+    const point3 lookfrom = rotate_y(point3(13., 2., 3.), frame * rotation_angle_delta);
+    return camera(lookfrom, point3(0, 0, 0), vec3(0, 1, 0), 20, aspect_ratio, 0.1, 10.0);
+  };
+
+  raytrace reference_tracer(world, materials, image_width, image_height, reference_spp, max_depth);
+  reference_tracer.set_frame(num_frames + 1000);
+  reference_tracer.render(frame_camera(num_frames - 1));
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+
+  double fresh_time = 0.;
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    raytracer.set_frame(frame);
+    stop_watch.start();
+    raytracer.render(frame_camera(frame));
+    fresh_time += stop_watch.stop();
+  }
+  const double fresh_error = display_rmse(raytracer.pixel_estimates(), reference);
+
+  temporal_settings settings;
+  settings.fresh_samples = option_value(args, "--fresh", std::max<size_t>(1, spp / 4));
+  settings.max_history = option_value(args, "--history", 4 * spp);
+  temporalReuse temporal(raytracer, settings);
+
+  std::cout << std::setw(8) << "frame" << std::setw(12) << "time [s]" << std::setw(10) << "reused" << std::setw(10)
+            << "rejected" << std::setw(14) << "not reusable" << std::setw(8) << "spp" << std::setw(10) << "history"
+            << std::endl;
+  double temporal_time = 0.;
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    raytracer.set_frame(frame);
+    stop_watch.start();
+    temporal.render(frame_camera(frame));
+    double time = stop_watch.stop();
+    temporal_time += time;
+
+    const auto& stats = temporal.stats();
+    std::cout << std::fixed << std::setw(8) << frame << std::setprecision(4) << std::setw(12) << time
+              << std::setprecision(1) << std::setw(9) << 100. * stats.reuse_ratio() << "%" << std::setw(9)
+              << 100. * stats.rejected / stats.pixels << "%" << std::setw(13)
+              << 100. * stats.not_reusable / stats.pixels << "%" << std::setw(8) << stats.samples_per_pixel()
+              << std::setw(10) << stats.history << std::endl;
+  }
+
+  std::vector<pixel_estimate> temporal_pixels(reference.size());
+  for (size_t index = 0; index < temporal_pixels.size(); index++) {
+    temporal_pixels[index].sum = temporal.mean(index);
+    temporal_pixels[index].count = 1;
+  }
+  const double temporal_error = display_rmse(temporal_pixels, reference);
+
+  std::cout << std::fixed << std::setprecision(4) << "from scratch: " << fresh_time << "s, rmse of the last frame "
+            << fresh_error << std::endl;
+  std::cout << "temporal:     " << temporal_time << "s, rmse of the last frame " << temporal_error << ", speedup "
+            << std::setprecision(2) << fresh_time / temporal_time << std::endl;
+
+  return 0;
+}
+
+// Default scene with the max depth of the application, russian roulette off against roulette after 1 to 8 rays:
+// frame time (best of --repeat), rays per second, average path length and the error against a reference without
+// roulette. The efficiency is 1 / (squared error * time) relative to no roulette.
+int bench_roulette(const std::vector<std::string>& args) {
+  const size_t spp = option_value(args, "--spp", 16);
+  const size_t depth = option_value(args, "--depth", render_settings().max_depth);
+  const size_t reference_spp = option_value(args, "--reference-spp", 1024);
+  const size_t repeat = std::max<size_t>(1, option_value(args, "--repeat", 3));
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>();
+
+  raytrace reference_tracer(world, materials, image_width, image_height, reference_spp, depth, pool);
+  reference_tracer.set_roulette_depth(0);
+  reference_tracer.set_frame(1000);
+  reference_tracer.render(cam);
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+
+  std::cout << std::setw(10) << "roulette" << std::setw(12) << "frame [s]" << std::setw(12) << "Mrays/s"
+            << std::setw(14) << "rays/path" << std::setw(10) << "rmse" << std::setw(12) << "efficiency" << std::endl;
+  raytrace raytracer(world, materials, image_width, image_height, spp, depth, pool);
+  stopWatch stop_watch;
+  double base_efficiency = 0.;
+  for (uint32_t roulette_depth : {0, 1, 2, 3, 5, 8}) {
+    raytracer.set_roulette_depth(roulette_depth);
+    double frame_time = infinity;
+    trace_counters counters;
+    for (size_t r = 0; r < repeat; r++) {
+      traceStats::reset();
+      stop_watch.start();
+      raytracer.render(cam);
+      frame_time = std::min(frame_time, stop_watch.stop());
+      counters = traceStats::collect();
+    }
+    const double error = display_rmse(raytracer.pixel_estimates(), reference);
+    const double efficiency = 1. / (error * error * frame_time);
+    if (roulette_depth == 0) base_efficiency = efficiency;
+
+    std::cout << std::fixed << std::setw(10) << (roulette_depth == 0 ? "off" : std::to_string(roulette_depth))
+              << std::setprecision(4) << std::setw(12) << frame_time << std::setprecision(2) << std::setw(12)
+              << counters.rays / frame_time * 1e-6 << std::setprecision(3) << std::setw(14) << counters.average_depth()
+              << std::setprecision(4) << std::setw(10) << error << std::setprecision(2) << std::setw(12)
+              << efficiency / base_efficiency << std::endl;
+  }
+
+  return 0;
+}
+
+// Default scene at the size and depth of the application, rendered at 1 to 50 spp with and without the a-trous
+// denoiser. For every spp the render time without and with the guide buffers, the filter time and the error against a
+// high spp reference. The noisy spp for the error of the denoised --spp frame are extrapolated with
+// error ~ 1 / sqrt(spp) from 50 spp, the end-to-end speedup is the time of those spp against render and filter.
+int bench_denoise(const std::vector<std::string>& args) {
+  const size_t target_spp = option_value(args, "--spp", 8);
+  const size_t reference_spp = option_value(args, "--reference-spp", 512);
+  denoise_settings settings;
+  settings.iterations = option_value(args, "--iterations", settings.iterations);
+  settings.sigma_color = std::stof(option_string(args, "--sigma-color", std::to_string(settings.sigma_color)));
+  settings.sigma_normal = std::stof(option_string(args, "--sigma-normal", std::to_string(settings.sigma_normal)));
+  settings.sigma_depth = std::stof(option_string(args, "--sigma-depth", std::to_string(settings.sigma_depth)));
+  settings.sigma_albedo = std::stof(option_string(args, "--sigma-albedo", std::to_string(settings.sigma_albedo)));
+  const std::string output = option_string(args, "--output");
+  const render_settings size;
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>();
+  stopWatch stop_watch;
+
+  raytrace reference_tracer(world, materials, size.image_width, size.image_height, reference_spp, size.max_depth,
+                            pool);
+  reference_tracer.set_frame(1000);
+  reference_tracer.render(cam);
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+
+  std::cout << size.image_width << "x" << size.image_height << " pixels, depth " << size.max_depth << ", "
+            << settings.iterations << " filter passes" << std::endl;
+  std::cout << std::setw(6) << "spp" << std::setw(12) << "render [s]" << std::setw(14) << "+features [s]"
+            << std::setw(13) << "filter [ms]" << std::setw(10) << "rmse" << std::setw(16) << "denoised rmse"
+            << std::endl;
+
+  atrousDenoiser denoiser(settings);
+  double target_time = 0.;
+  double target_error = 0.;
+  double last_time = 0.;
+  double last_error = 0.;
+  size_t last_spp = 0;
+  std::vector<size_t> spp_list = {1, 2, 4, 8, 16, 32, 50};
+  if (std::find(spp_list.begin(), spp_list.end(), target_spp) == spp_list.end()) {
+    spp_list.insert(std::upper_bound(spp_list.begin(), spp_list.end(), target_spp), target_spp);
+  }
+  for (size_t spp : spp_list) {
+    raytrace raytracer(world, materials, size.image_width, size.image_height, spp, size.max_depth, pool);
+    stop_watch.start();
+    raytracer.render(cam);
+    const double render_time = stop_watch.stop();
+    const double error = display_rmse(raytracer.pixel_estimates(), reference);
+
+    raytracer.set_features(true);
+    stop_watch.start();
+    raytracer.render(cam);
+    const double features_time = stop_watch.stop();
+    const std::vector<color> colors = denoiser.filter(size.image_width, size.image_height,
+                                                      raytracer.pixel_estimates(), raytracer.features(), *pool);
+    std::vector<pixel_estimate> denoised(colors.size());
+    for (size_t p = 0; p < colors.size(); p++) {
+      denoised[p].sum = colors[p];
+      denoised[p].count = 1;
+    }
+    const double denoised_error = display_rmse(denoised, reference);
+
+    std::cout << std::fixed << std::setw(6) << spp << std::setprecision(4) << std::setw(12) << render_time
+              << std::setw(14) << features_time << std::setprecision(2) << std::setw(13)
+              << denoiser.last_time() * 1e3 << std::setprecision(4) << std::setw(10) << error << std::setw(16)
+              << denoised_error << std::endl;
+
+    if (spp == target_spp) {
+      target_time = features_time + denoiser.last_time();
+      target_error = denoised_error;
+      if (!output.empty()) write_pfm(output, size.image_width, size.image_height, colors);
+    }
+    last_time = render_time;
+    last_error = error;
+    last_spp = spp;
+  }
+
+  const double filter_pixels = static_cast<double>(size.image_width) * size.image_height * settings.iterations;
+  std::cout << std::setprecision(1) << "filter: " << filter_pixels / denoiser.last_time() * 1e-6
+            << " Mpixels/s per pass with " << pool->size() << " threads" << std::endl;
+  const double equal_spp = last_spp * (last_error / target_error) * (last_error / target_error);
+  std::cout << "denoised " << target_spp << " spp: rmse " << std::setprecision(4) << target_error << " in "
+            << target_time << "s, without the denoiser about " << std::setprecision(0) << equal_spp << " spp in "
+            << std::setprecision(2) << last_time / last_spp * equal_spp << "s, speedup "
+            << last_time / last_spp * equal_spp / target_time << std::endl;
+
+  return 0;
+}
+
+// display_rmse of the error blurred with a 3x3 binomial kernel: the error a viewer sees from a distance. Noise which
+// differs from pixel to pixel like blue noise is mostly removed, clumps of equal error stay.
+double lowpass_rmse(const std::vector<pixel_estimate>& pixels, const std::vector<pixel_estimate>& reference,
+                    size_t width, size_t height) {
+  std::vector<double> error(pixels.size() * 3);
+  for (size_t p = 0; p < pixels.size(); p++) {
+    for (int c = 0; c < 3; c++) {
+      error[3 * p + c] = std::sqrt(std::max(0., static_cast<double>(pixels[p].sum[c]) / pixels[p].count)) -
+                         std::sqrt(std::max(0., static_cast<double>(reference[p].sum[c]) / reference[p].count));
+    }
+  }
+
+  constexpr double kernel[3] = {0.25, 0.5, 0.25};
+  double squared_error = 0.;
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      for (int c = 0; c < 3; c++) {
+        double blurred = 0.;
+        for (int dj = -1; dj <= 1; dj++) {
+          for (int di = -1; di <= 1; di++) {
+            // clamped at the border
+            const size_t y = std::min(height - 1, static_cast<size_t>(std::max<long>(0, long(j) + dj)));
+            const size_t x = std::min(width - 1, static_cast<size_t>(std::max<long>(0, long(i) + di)));
+            blurred += kernel[dj + 1] * kernel[di + 1] * error[3 * (y * width + x) + c];
+          }
+        }
+        squared_error += blurred * blurred;
+      }
+    }
+  }
+  return std::sqrt(squared_error / (3 * pixels.size()));
+}
+
+// Convergence of the samplers on the default scene: error against a high spp reference of independent samples from 1
+// to --spp samples per pixel, the error after a 3x3 blur (see lowpass_rmse) and the frame time. The samples
+// independent numbers need for the error of a sampler at --spp are extrapolated with error ~ 1 / sqrt(spp).
+int bench_samplers(const std::vector<std::string>& args) {
+  const size_t reference_spp = option_value(args, "--reference-spp", 1024);
+  const size_t max_spp = option_value(args, "--spp", 64);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  auto world = std::make_shared<bvh>(randomWorld::generate_random_scene(*materials));
+  auto pool = std::make_shared<threadPool>();
+
+  raytrace reference_tracer(world, materials, image_width, image_height, reference_spp, max_depth, pool);
+  reference_tracer.set_frame(1000);
+  reference_tracer.render(cam);
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+
+  std::cout << std::setw(12) << "sampler" << std::setw(6) << "spp" << std::setw(12) << "frame [s]" << std::setw(10)
+            << "rmse" << std::setw(14) << "3x3 blurred" << std::endl;
+  stopWatch stop_watch;
+  double independent_error = 0.;
+  double independent_time = 0.;
+  std::vector<std::pair<sampler_type, double>> final_errors;
+  for (sampler_type sampler :
+       {sampler_type::independent, sampler_type::sobol, sampler_type::halton, sampler_type::blue_noise}) {
+    double error = 0.;
+    double time = 0.;
+    for (size_t spp = 1; spp <= max_spp; spp *= 2) {
+      raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, pool);
+      raytracer.set_sampler(sampler);
+      stop_watch.start();
+      raytracer.render(cam);
+      time = stop_watch.stop();
+      error = display_rmse(raytracer.pixel_estimates(), reference);
+
+      std::cout << std::fixed << std::setw(12) << lowDiscrepancy::type_name(sampler) << std::setw(6) << spp
+                << std::setprecision(4) << std::setw(12) << time << std::setw(10) << error << std::setw(14)
+                << lowpass_rmse(raytracer.pixel_estimates(), reference, image_width, image_height) << std::endl;
+    }
+    if (sampler == sampler_type::independent) {
+      independent_error = error;
+      independent_time = time;
+    }
+    final_errors.emplace_back(sampler, error);
+    std::cout << std::setprecision(2) << "  " << time / independent_time << "x the time of independent samples"
+              << std::endl;
+  }
+
+  for (const auto& [sampler, error] : final_errors) {
+    const double equal_spp = max_spp * (independent_error / error) * (independent_error / error);
+    std::cout << std::setw(12) << lowDiscrepancy::type_name(sampler) << ": rmse " << std::setprecision(4) << error
+              << " at " << max_spp << " spp, independent samples need about " << std::setprecision(0) << equal_spp
+              << " spp" << std::endl;
+  }
+
+  return 0;
+}
+
+// Random scene at night, lit by three small spheres, rendered with and without next event estimation. For every spp
+// the error against a light sampled reference, the mean brightness (the same for both, both are unbiased) and the
+// time to the error of light sampling at the highest spp, extrapolated with error ~ 1 / sqrt(spp).
+int bench_lights(const std::vector<std::string>& args) {
+  const size_t reference_spp = option_value(args, "--reference-spp", 256);
+  const size_t max_spp = option_value(args, "--spp", 32);
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  hittable_list objects = randomWorld::generate_random_scene(*materials);
+  objects.add(std::make_shared<sphere>(point3(2, 3, 2), 0.25, materials->add(diffuse_light(color(60, 54, 45)))));
+  objects.add(std::make_shared<sphere>(point3(-3, 2, -1), 0.2, materials->add(diffuse_light(color(10, 20, 50)))));
+  objects.add(std::make_shared<sphere>(point3(6, 0.5, 1.5), 0.1, materials->add(diffuse_light(color(80, 20, 10)))));
+  auto world = std::make_shared<bvh>(objects);
+  auto pool = std::make_shared<threadPool>();
+
+  raytrace reference_tracer(world, materials, image_width, image_height, reference_spp, max_depth, pool);
+  reference_tracer.set_background(color(0, 0, 0));
+  reference_tracer.set_frame(1000);
+  reference_tracer.render(cam);
+  const std::vector<pixel_estimate> reference = reference_tracer.pixel_estimates();
+  std::cout << reference_tracer.lights().size() << " lights, reference with " << reference_spp << " spp" << std::endl;
+
+  const auto mean = [](const std::vector<pixel_estimate>& pixels) {
+    double sum = 0.;
+    for (const auto& pixel : pixels) {
+      sum += (pixel.sum[0] + pixel.sum[1] + pixel.sum[2]) / (3 * pixel.count);
+    }
+    return sum / pixels.size();
+  };
+
+  std::cout << std::setw(16) << "light sampling" << std::setw(6) << "spp" << std::setw(12) << "frame [s]"
+            << std::setw(10) << "rmse" << std::setw(10) << "mean" << std::endl;
+  stopWatch stop_watch;
+  double target_error = 0.;
+  double time_to_target[2] = {};
+  for (bool light_sampling : {true, false}) {
+    double time = 0.;
+    double error = 0.;
+    for (size_t spp = 1; spp <= max_spp; spp *= 2) {
+      raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, pool);
+      raytracer.set_background(color(0, 0, 0));
+      raytracer.set_light_sampling(light_sampling);
+      stop_watch.start();
+      raytracer.render(cam);
+      time = stop_watch.stop();
+      error = display_rmse(raytracer.pixel_estimates(), reference);
+
+      std::cout << std::fixed << std::setw(16) << (light_sampling ? "on" : "off") << std::setw(6) << spp
+                << std::setprecision(4) << std::setw(12) << time << std::setw(10) << error << std::setw(10)
+                << mean(raytracer.pixel_estimates()) << std::endl;
+    }
+    if (light_sampling) target_error = error;
+    time_to_target[light_sampling] = time * (error / target_error) * (error / target_error);
+  }
+
+  std::cout << std::setprecision(4) << "time to rmse " << target_error << ": " << time_to_target[1]
+            << "s with light sampling, " << std::setprecision(2) << time_to_target[0] << "s without, speedup "
+            << time_to_target[0] / time_to_target[1] << std::endl;
+
+  return 0;
+}
+
+// Moving spheres version of the random scene: the small spheres drift over the ground, reflected at the edge of the
+// grid, and bounce, the big ones stay. Every frame the bvh is updated and the frame rendered, once with a full build
+// every frame, once only refitted and once with the rebuilds of bvh_update_settings. Per frame the refit (with the
+// bounding boxes), rebuild and trace time; at the end the SAH cost of the tree against a fresh build.
+int bench_moving(const std::vector<std::string>& args) {
+  const size_t count = option_value(args, "--count", 100000);
+  const size_t num_frames = option_value(args, "--frames", 60);
+  const size_t spp = option_value(args, "--spp", samples_per_pixel);
+  const bool verbose = has_flag(args, "--verbose");
+  const camera cam = default_camera();
+  auto materials = std::make_shared<material_table>();
+  const int grid_extent = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count)) / 2));
+  const hittable_list objects = randomWorld::generate_random_scene(*materials, grid_extent);
+  auto pool = std::make_shared<threadPool>();
+
+  struct motion {
+    std::shared_ptr<sphere> s;
+    point3 start;
+    vec3 velocity;  // per frame
+    real phase;
+  };
+  std::vector<motion> moving;
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<real> uniform(0, 1);
+  for (const auto& object : objects.objects) {
+    auto s = std::dynamic_pointer_cast<sphere>(object);
+    if (!s || s->radius >= 1) continue;
+    const real angle = 2 * pi * uniform(generator);
+    const real speed = real(0.1) * uniform(generator);
+    const vec3 velocity = speed * vec3(std::cos(angle), 0, std::sin(angle));
+    moving.push_back(motion{s, s->center, velocity, 2 * pi * uniform(generator)});
+  }
+  // position at frame: the distance travelled is folded back into the grid like a reflection at its edges
+  const auto place = [&](const motion& m, size_t frame) {
+    const real extent = grid_extent + 1;
+    const auto fold = [&](real x) {
+      const real period = 4 * extent;
+      real y = std::fmod(x + extent, period);
+      if (y < 0) y += period;
+      return y < 2 * extent ? y - extent : 3 * extent - y;
+    };
+    const point3 p = m.start + static_cast<real>(frame) * m.velocity;
+    const real height = real(0.5) * std::abs(std::sin(m.phase + real(0.1) * frame));
+    m.s->center = point3(fold(p.x()), m.start.y() + height, fold(p.z()));
+  };
+
+  std::cout << objects.objects.size() << " spheres, " << moving.size() << " moving, " << num_frames << " frames, "
+            << spp << " spp" << std::endl;
+  std::cout << std::setw(10) << "update" << std::setw(13) << "refit [ms]" << std::setw(14) << "rebuild [ms]"
+            << std::setw(13) << "trace [ms]" << std::setw(13) << "frame [ms]" << std::setw(10) << "builds"
+            << std::setw(10) << "subtrees" << std::setw(14) << "cost / fresh" << std::endl;
+
+  const real never = std::numeric_limits<real>::max();
+  const std::pair<const char*, bvh_update_settings> modes[] = {
+      {"rebuild", bvh_update_settings{0, 0}}, {"refit", bvh_update_settings{never, never}}, {"heuristic", {}}};
+  stopWatch stop_watch;
+  for (const auto& [name, settings] : modes) {
+    for (const motion& m : moving) place(m, 0);
+    stop_watch.start();
+    auto world = std::make_shared<bvh>(objects);
+    const double build_time = stop_watch.stop();
+    raytrace raytracer(world, materials, image_width, image_height, spp, max_depth, pool);
+
+    double refit_time = 0.;
+    double rebuild_time = 0.;
+    double trace_time = 0.;
+    size_t builds = 0;
+    size_t subtrees = 0;
+    for (size_t frame = 1; frame <= num_frames; frame++) {
+      for (const motion& m : moving) place(m, frame);
+      const bvh_update_stats stats = raytracer.update_world(settings);
+      raytracer.set_frame(frame);
+      stop_watch.start();
+      raytracer.render(cam);
+      const double frame_trace_time = stop_watch.stop();
+
+      refit_time += stats.refit_time;
+      rebuild_time += stats.rebuild_time;
+      trace_time += frame_trace_time;
+      builds += stats.full_rebuild;
+      subtrees += stats.rebuilt_subtrees;
+      if (verbose) {
+        std::cout << std::fixed << std::setprecision(3) << "  " << name << " frame " << frame << ": refit "
+                  << stats.refit_time * 1e3 << "ms, rebuild " << stats.rebuild_time * 1e3 << "ms, trace "
+                  << frame_trace_time * 1e3 << "ms, cost ratio " << stats.cost_ratio
+                  << (stats.full_rebuild ? ", full rebuild" : "") << ", " << stats.rebuilt_subtrees << " subtrees"
+                  << std::endl;
+      }
+    }
+
+    // a fresh tree over the final positions
+    std::vector<aabb> boxes;
+    for (const auto& object : world->objects()) {
+      aabb box;
+      object->bounding_box(box);
+      boxes.push_back(box);
+    }
+    bvh_tree fresh;
+    fresh.build(boxes);
+
+    const double frames = static_cast<double>(num_frames);
+    std::cout << std::fixed << std::setw(10) << name << std::setprecision(3) << std::setw(13)
+              << refit_time / frames * 1e3 << std::setw(14) << rebuild_time / frames * 1e3 << std::setw(13)
+              << trace_time / frames * 1e3 << std::setw(13) << (refit_time + rebuild_time + trace_time) / frames * 1e3
+              << std::setw(10) << builds << std::setw(10) << subtrees << std::setprecision(3) << std::setw(14)
+              << world->tree().sah_cost() / fresh.sah_cost() << std::endl;
+    if (std::string(name) == "rebuild") {
+      std::cout << std::setw(10) << "" << " initial build " << std::setprecision(3) << build_time * 1e3 << "ms"
+                << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+// Coordinator with 1 to --workers local worker processes ("raytracing --worker" from the directory of the benchmark),
+// each with --threads render threads. The scaling efficiency is the time of one worker / (workers * time).
+// The first frame is compared with the frame of a render in this process.
+int bench_distributed(const std::vector<std::string>& args) {
+  const size_t max_workers = option_value(args, "--workers", 4);
+  const size_t num_frames = option_value(args, "--frames", 16);
+  const size_t threads = option_value(args, "--threads", 1);
+  constexpr real rotation_angle_delta = 0.01;
+
+  scene s;
+  *s.world = randomWorld::generate_random_scene(*s.materials);
+  s.settings.image_width = image_width;
+  s.settings.image_height = image_height;
+  s.settings.samples_per_pixel = option_value(args, "--spp", 16);
+  s.settings.max_depth = max_depth;
+
+  std::vector<frame_job> frames;
+  for (size_t frame = 0; frame < num_frames; frame++) {
+    const point3 lookfrom = rotate_y(s.view.lookfrom, frame * rotation_angle_delta);
+    frames.push_back(frame_job{frame, lookfrom, "distributed" + std::to_string(frame)});
+  }
+
+  raytrace raytracer(std::make_shared<bvh>(*s.world), s.materials, image_width, image_height,
+                     s.settings.samples_per_pixel, max_depth);
+  raytracer.set_frame(frames[0].frame);
+  ImageWrapper reference = raytracer.calcImage(s.make_camera(frames[0].lookfrom), "reference", false);
+  reference.set_type(image_type::pfm);
+
+  distributed_settings settings;
+  settings.tile_size = option_value(args, "--tile-size", settings.tile_size);
+  settings.threads_per_worker = threads;
+  settings.worker_command = {(std::filesystem::read_symlink("/proc/self/exe").parent_path() / "raytracing").string(),
+                             "--worker"};
+
+  std::cout << std::setw(8) << "workers" << std::setw(12) << "start [s]" << std::setw(12) << "render [s]"
+            << std::setw(10) << "frames/s" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+            << std::setw(8) << "busy" << std::setw(8) << "jobs" << std::setw(8) << "same" << std::endl;
+  stopWatch stop_watch;
+  double single_worker_time = 0.;
+  for (size_t workers = 1; workers <= max_workers; workers++) {
+    settings.workers = workers;
+    stop_watch.start();
+    distributedRender renderer(s, settings);
+    const double start_time = stop_watch.stop();
+
+    bool same = true;
+    renderer.render(frames, [&](ImageWrapper image, const frame_job& job) {
+      if (job.frame == frames[0].frame) {
+        image.set_type(image_type::pfm);
+        same = image.encode() == reference.encode();
+      }
+    });
+
+    const auto& stats = renderer.stats();
+    if (workers == 1) single_worker_time = stats.wall_time;
+    const double speedup = single_worker_time / stats.wall_time;
+    std::cout << std::fixed << std::setw(8) << workers << std::setprecision(4) << std::setw(12) << start_time
+              << std::setw(12) << stats.wall_time << std::setprecision(2) << std::setw(10)
+              << num_frames / stats.wall_time << std::setw(10) << speedup << std::setprecision(1) << std::setw(11)
+              << 100. * speedup / workers << "%" << std::setw(7) << 100. * stats.efficiency() << "%" << std::setw(8)
+              << stats.jobs << std::setw(8) << (same ? "yes" : "no") << std::endl;
+  }
+
+  return 0;
+}
+
+struct suite_case {
+  std::string name;
+  int grid_extent;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct suite_result {
+  std::string name;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t objects = 0;
+  double frame_time = 0.;  // best of the repetitions [s]
+  double primary_rays_per_second = 0.;
+  double rays_per_second = 0.;
+  double average_depth = 0.;
+  // shares of the thread time of the timed frame, the clock reads slow the timed frame down
+  double intersect_share = 0.;
+  double scatter_share = 0.;
+  double other_share = 0.;
+  double encode_time = 0.;
+  double write_time = 0.;
+};
+
+// number after "key": in the object of the case with the name, nothing if the baseline doesn't have it. No NaN,
+// -ffast-math removes the checks for it.
+std::optional<double> baseline_value(const std::string& json, const std::string& name, const std::string& key) {
+  const size_t object = json.find("\"name\": \"" + name + "\"");
+  if (object == std::string::npos) return std::nullopt;
+  const size_t end = json.find('}', object);
+  const size_t value = json.find("\"" + key + "\": ", object);
+  if (value == std::string::npos || value > end) return std::nullopt;
+  return std::stod(json.substr(value + key.size() + 4));
+}
+
+// Fixed scenes of several sizes, the random world with a seeded generator. Reports primary and total rays per second
+// (best of --repeat frames), the average path depth and the shares of intersection, scatter and the rest of the frame,
+// measured in an extra timed frame, plus encode and write time of the image as JSON.
+// With --baseline <json of an earlier run> the rays per second are compared, a drop of more than --tolerance percent
+// is a regression and the exit code is 2.
+int bench_suite(const std::vector<std::string>& args) {
+  const size_t spp = option_value(args, "--spp", 8);
+  const size_t depth = option_value(args, "--depth", 16);
+  const size_t repeat = std::max<size_t>(1, option_value(args, "--repeat", 5));
+  const uint64_t seed = option_value(args, "--seed", 1);
+  const double tolerance = option_value(args, "--tolerance", 10) / 100.;
+  const std::string output = option_string(args, "--output");
+  const std::string baseline_file = option_string(args, "--baseline");
+  auto pool = std::make_shared<threadPool>(option_value(args, "--threads", std::thread::hardware_concurrency()));
+
+  std::string baseline;
+  if (!baseline_file.empty()) {
+    std::ifstream file(baseline_file);
+    if (!file) {
+      std::cerr << "can't open " << baseline_file << std::endl;
+      return 1;
+    }
+    baseline.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  const std::vector<suite_case> cases = {
+      {"small", 5, 160, 90}, {"medium", 11, 320, 180}, {"large", 22, 480, 270}};
+  std::vector<suite_result> results;
+  for (const suite_case& c : cases) {
+    random_stream(seed);
+    auto materials = std::make_shared<material_table>();
+    hittable_list list = randomWorld::generate_random_scene(*materials, c.grid_extent);
+    auto world = std::make_shared<bvh>(list);
+    raytrace raytracer(world, materials, c.width, c.height, spp, depth, pool);
+    const camera cam(point3(13., 2., 3.), point3(0, 0, 0), vec3(0, 1, 0), 20, real(c.width) / c.height, 0.1, 10.0);
+    raytracer.set_frame(seed);
+
+    suite_result result;
+    result.name = c.name;
+    result.width = c.width;
+    result.height = c.height;
+    result.objects = list.objects.size();
+
+    stopWatch stop_watch;
+    trace_counters counters;
+    result.frame_time = infinity;
+    for (size_t r = 0; r < repeat; r++) {
+      traceStats::reset();
+      stop_watch.start();
+      raytracer.render(cam);
+      result.frame_time = std::min(result.frame_time, stop_watch.stop());
+      counters = traceStats::collect();
+    }
+    result.primary_rays_per_second = counters.paths / result.frame_time;
+    result.rays_per_second = counters.rays / result.frame_time;
+    result.average_depth = counters.average_depth();
+
+    traceStats::reset();
+    traceStats::set_timing(true);
+    ImageWrapper image = raytracer.calcImage(cam, "bench_suite", false);
+    traceStats::set_timing(false);
+    counters = traceStats::collect();
+    double busy_time = 0.;
+    for (const auto& stats : pool->stats()) {
+      busy_time += stats.busy_time;
+    }
+    result.intersect_share = counters.intersect_time / busy_time;
+    result.scatter_share = counters.scatter_time / busy_time;
+    result.other_share = std::max(0., 1. - result.intersect_share - result.scatter_share);
+
+    stop_watch.start();
+    const std::string data = image.encode();
+    result.encode_time = stop_watch.stop();
+    stop_watch.start();
+    ImageWrapper::write_file(image.filename(), data);
+    result.write_time = stop_watch.stop();
+    std::filesystem::remove(image.filename());
+
+    results.push_back(result);
+  }
+
+  bool regression = false;
+  std::ostringstream json;
+  json << std::setprecision(6) << "{\n  \"spp\": " << spp << ",\n  \"max_depth\": " << depth
+       << ",\n  \"threads\": " << pool->size() << ",\n  \"seed\": " << seed << ",\n  \"cases\": [\n";
+  for (size_t k = 0; k < results.size(); k++) {
+    const suite_result& r = results[k];
+    json << "    {\"name\": \"" << r.name << "\", \"width\": " << r.width << ", \"height\": " << r.height
+         << ", \"objects\": " << r.objects << ", \"frame_time\": " << r.frame_time
+         << ", \"primary_rays_per_second\": " << r.primary_rays_per_second
+         << ", \"rays_per_second\": " << r.rays_per_second << ", \"average_depth\": " << r.average_depth
+         << ", \"intersect_share\": " << r.intersect_share << ", \"scatter_share\": " << r.scatter_share
+         << ", \"other_share\": " << r.other_share << ", \"encode_time\": " << r.encode_time
+         << ", \"write_time\": " << r.write_time;
+    if (!baseline.empty()) {
+      const std::optional<double> reference = baseline_value(baseline, r.name, "rays_per_second");
+      if (reference) {
+        const double change = r.rays_per_second / *reference - 1.;
+        const bool slower = change < -tolerance;
+        regression |= slower;
+        json << ", \"baseline_rays_per_second\": " << *reference << ", \"change\": " << change
+             << ", \"regression\": " << (slower ? "true" : "false");
+        std::cerr << r.name << ": " << std::fixed << std::setprecision(1) << 100. * change << "% rays per second"
+                  << (slower ? " -> regression" : "") << std::endl;
+      }
+    }
+    json << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+  }
+  json << "  ]\n}\n";
+
+  if (output.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream file(output);
+    file << json.str();
+    if (!file) {
+      std::cerr << "can't write " << output << std::endl;
+      return 1;
+    }
+  }
+
+  return regression ? 2 : 0;
+}
+
+const std::map<std::string, std::function<int(const std::vector<std::string>&)>> benchmarks = {
+    {"bvh", bench_bvh},
+    {"tiles", bench_tiles},
+    {"packet", bench_packet},
+    {"wavefront", bench_wavefront},
+    {"sorting", bench_ray_sorting},
+    {"precision", bench_precision},
+    {"adaptive", bench_adaptive},
+    {"rng", bench_rng},
+    {"writer", bench_writer},
+    {"image", bench_image},
+    {"scene", bench_scene},
+    {"arena", bench_arena},
+    {"mesh", bench_mesh},
+    {"instances", bench_instances},
+    {"temporal", bench_temporal},
+    {"roulette", bench_roulette},
+    {"lights", bench_lights},
+    {"denoise", bench_denoise},
+    {"samplers", bench_samplers},
+    {"moving", bench_moving},
+    {"distributed", bench_distributed},
+    {"suite", bench_suite},
+};
+
+void usage(const char* name) {
+  std::cout << "Usage: " << name << " <benchmark> [options]\nBenchmarks:";
+  for (const auto& benchmark : benchmarks) {
+    std::cout << " " << benchmark.first;
+  }
+  std::cout << std::endl;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2 || benchmarks.find(argv[1]) == benchmarks.end()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::vector<std::string> args(argv + 2, argv + argc);
+
+  return benchmarks.at(argv[1])(args);
+}
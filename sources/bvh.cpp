@@ -0,0 +1,479 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+constexpr size_t num_bins = 16;
+// relative costs of a node traversal step and a primitive intersection for the surface area heuristic
+constexpr double traversal_cost = 1.0;
+constexpr double intersection_cost = 2.0;
+// below this depth the SAH is used, deeper down the primitives are split at the median to bound the depth
+constexpr uint32_t max_sah_depth = 32;
+
+struct sah_bin {
+  aabb box;
+  uint32_t count = 0;
+};
+
+// objects per task when the bounding boxes are collected in parallel
+constexpr size_t boxes_per_task = 4096;
+
+double surface_area(const bvh_node& node) {
+  const real dx = node.bounds_max[0] - node.bounds_min[0];
+  const real dy = node.bounds_max[1] - node.bounds_min[1];
+  const real dz = node.bounds_max[2] - node.bounds_min[2];
+  return 2. * (dx * dy + dy * dz + dz * dx);
+}
+
+// SAH cost of a single node times the surface of the root box
+double node_cost(const bvh_node& node) {
+  return (node.is_leaf() ? intersection_cost * node.count : traversal_cost) * surface_area(node);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+void bvh_tree::build(const std::vector<aabb>& primitive_boxes) {
+  nodes_.clear();
+  external_nodes_ = nullptr;
+  num_external_nodes_ = 0;
+  primitive_indices_.resize(primitive_boxes.size());
+  std::iota(primitive_indices_.begin(), primitive_indices_.end(), 0);
+
+  if (primitive_boxes.empty()) return;
+
+  std::vector<point3> centroids;
+  centroids.reserve(primitive_boxes.size());
+  for (const auto& box : primitive_boxes) {
+    centroids.push_back(box.centroid());
+  }
+
+  nodes_.reserve(2 * primitive_boxes.size());
+  build_recursive(nodes_, primitive_boxes, centroids, 0, primitive_boxes.size(), 0);
+  nodes_.shrink_to_fit();
+  find_subtrees();
+}
+
+void bvh_tree::reference(const bvh_node* nodes, size_t count) {
+  std::vector<bvh_node>().swap(nodes_);
+  std::vector<uint32_t>().swap(primitive_indices_);
+  subtrees_.clear();
+  top_nodes_.clear();
+  external_nodes_ = nodes;
+  num_external_nodes_ = count;
+}
+
+aabb bvh_tree::bounds() const {
+  if (empty()) return aabb();
+
+  const bvh_node& root = nodes()[0];
+  return aabb(point3(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+              point3(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+}
+
+uint32_t bvh_tree::build_recursive(std::vector<bvh_node>& nodes, const std::vector<aabb>& boxes,
+                                   const std::vector<point3>& centroids, uint32_t begin, uint32_t end,
+                                   uint32_t depth) {
+  const uint32_t node_index = nodes.size();
+  nodes.emplace_back();
+
+  aabb bounds;
+  aabb centroid_bounds;
+  for (uint32_t i = begin; i < end; i++) {
+    bounds.grow(boxes[primitive_indices_[i]]);
+    centroid_bounds.grow(centroids[primitive_indices_[i]]);
+  }
+
+  for (int a = 0; a < 3; a++) {
+    nodes[node_index].bounds_min[a] = bounds.minimum[a];
+    nodes[node_index].bounds_max[a] = bounds.maximum[a];
+  }
+
+  const uint32_t count = end - begin;
+  auto make_leaf = [&]() {
+    nodes[node_index].offset = begin;
+    nodes[node_index].count = count;
+    nodes[node_index].axis = 0;
+    return node_index;
+  };
+
+  if (count == 1) return make_leaf();
+
+  // find the cheapest split of the binned centroids over all three axes
+  double best_cost = std::numeric_limits<double>::max();
+  int best_axis = -1;
+  size_t best_bin = 0;
+
+  if (depth < max_sah_depth) {
+    for (int axis = 0; axis < 3; axis++) {
+      real c_min = centroid_bounds.minimum[axis];
+      real c_extent = centroid_bounds.maximum[axis] - c_min;
+      if (c_extent <= 1e-12) continue;
+
+      std::array<sah_bin, num_bins> bins;
+      real scale = num_bins / c_extent;
+      for (uint32_t i = begin; i < end; i++) {
+        uint32_t prim = primitive_indices_[i];
+        size_t b = std::min(num_bins - 1, static_cast<size_t>((centroids[prim][axis] - c_min) * scale));
+        bins[b].count++;
+        bins[b].box.grow(boxes[prim]);
+      }
+
+      // sweep from the right to get the cost of all right sides, then from the left to evaluate the splits
+      std::array<double, num_bins> right_cost;
+      aabb right_box;
+      uint32_t right_count = 0;
+      for (size_t b = num_bins - 1; b > 0; b--) {
+        right_box.grow(bins[b].box);
+        right_count += bins[b].count;
+        right_cost[b] = right_count * right_box.surface_area();
+      }
+
+      aabb left_box;
+      uint32_t left_count = 0;
+      for (size_t b = 0; b < num_bins - 1; b++) {
+        left_box.grow(bins[b].box);
+        left_count += bins[b].count;
+        if (left_count == 0 || left_count == count) continue;
+
+        double cost = left_count * left_box.surface_area() + right_cost[b + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = b;
+        }
+      }
+    }
+  }
+
+  uint32_t mid;
+  int split_axis;
+
+  if (best_axis >= 0) {
+    double leaf_cost = intersection_cost * count;
+    double split_cost = traversal_cost + intersection_cost * best_cost / bounds.surface_area();
+    if (count <= max_leaf_size && leaf_cost <= split_cost) return make_leaf();
+
+    real c_min = centroid_bounds.minimum[best_axis];
+    real scale = num_bins / (centroid_bounds.maximum[best_axis] - c_min);
+    auto split_it = std::partition(primitive_indices_.begin() + begin, primitive_indices_.begin() + end,
+                                   [&](uint32_t prim) {
+                                     const real offset = (centroids[prim][best_axis] - c_min) * scale;
+                                     return std::min(num_bins - 1, static_cast<size_t>(offset)) <= best_bin;
+                                   });
+    mid = split_it - primitive_indices_.begin();
+    split_axis = best_axis;
+  } else {
+    // all centroids at the same position or the tree is getting too deep
+    if (count <= max_leaf_size) return make_leaf();
+
+    split_axis = centroid_bounds.longest_axis();
+    mid = begin + count / 2;
+    std::nth_element(primitive_indices_.begin() + begin, primitive_indices_.begin() + mid,
+                     primitive_indices_.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centroids[a][split_axis] < centroids[b][split_axis]; });
+  }
+
+  build_recursive(nodes, boxes, centroids, begin, mid, depth + 1);
+  uint32_t right_index = build_recursive(nodes, boxes, centroids, mid, end, depth + 1);
+
+  nodes[node_index].offset = right_index;
+  nodes[node_index].count = 0;
+  nodes[node_index].axis = split_axis;
+
+  return node_index;
+}
+
+void bvh_tree::find_subtrees() {
+  subtrees_.clear();
+  top_nodes_.clear();
+  if (nodes_.empty()) return;
+
+  // the nodes of a subtree end after its last leaf, the end of the subtree of its right child
+  const auto subtree_end = [&](uint32_t index) {
+    while (!nodes_[index].is_leaf()) index = nodes_[index].offset;
+    return index + 1;
+  };
+  const std::function<void(uint32_t, uint32_t)> visit = [&](uint32_t index, uint32_t depth) {
+    if (depth == refit_depth || nodes_[index].is_leaf()) {
+      const uint32_t end = subtree_end(index);
+      const double area = surface_area(nodes_[index]);
+      subtrees_.push_back(subtree{index, end, depth, area > 0. ? nodes_cost(index, end) / area : 0.});
+      return;
+    }
+    top_nodes_.push_back(index);
+    visit(index + 1, depth + 1);
+    visit(nodes_[index].offset, depth + 1);
+  };
+  visit(0, 0);
+
+  build_cost_ = sah_cost();
+}
+
+double bvh_tree::nodes_cost(uint32_t begin, uint32_t end) const {
+  double cost = 0.;
+  for (uint32_t index = begin; index < end; index++) cost += node_cost(nodes_[index]);
+  return cost;
+}
+
+double bvh_tree::sah_cost() const {
+  if (empty()) return 0.;
+  const double root_area = surface_area(nodes()[0]);
+  double cost = 0.;
+  for (size_t index = 0; index < num_nodes(); index++) cost += node_cost(nodes()[index]);
+  return root_area > 0. ? cost / root_area : 0.;
+}
+
+double bvh_tree::refit_node(const std::vector<aabb>& boxes, uint32_t index) {
+  bvh_node& node = nodes_[index];
+  aabb box;
+  if (node.is_leaf()) {
+    for (uint32_t i = node.offset; i < node.offset + node.count; i++) box.grow(boxes[primitive_indices_[i]]);
+  } else {
+    for (const bvh_node* child : {&nodes_[index + 1], &nodes_[node.offset]}) {
+      box.grow(aabb(point3(child->bounds_min[0], child->bounds_min[1], child->bounds_min[2]),
+                    point3(child->bounds_max[0], child->bounds_max[1], child->bounds_max[2])));
+    }
+  }
+  for (int a = 0; a < 3; a++) {
+    node.bounds_min[a] = box.minimum[a];
+    node.bounds_max[a] = box.maximum[a];
+  }
+  return node_cost(node);
+}
+
+double bvh_tree::refit_nodes(const std::vector<aabb>& boxes, uint32_t begin, uint32_t end) {
+  double cost = 0.;
+  for (uint32_t index = end; index-- > begin;) cost += refit_node(boxes, index);
+  return cost;
+}
+
+bvh_update_stats bvh_tree::update(const std::vector<aabb>& primitive_boxes, threadPool& pool,
+                                  const bvh_update_settings& settings) {
+  if (external_nodes_ != nullptr || primitive_indices_.size() != primitive_boxes.size()) {
+    throw std::invalid_argument("the bvh can only be updated with the boxes of the primitives it was built from");
+  }
+  bvh_update_stats stats;
+  if (nodes_.empty()) return stats;
+
+  auto start = std::chrono::steady_clock::now();
+  // bottom up: the subtrees in parallel, then the nodes above them, whose children are all refitted by then
+  std::vector<double> subtree_costs(subtrees_.size());
+  pool.run(
+      subtrees_.size(),
+      [&](size_t index, size_t) {
+        const subtree& s = subtrees_[index];
+        subtree_costs[index] = refit_nodes(primitive_boxes, s.root, s.end);
+      },
+      "refit");
+  double cost = std::accumulate(subtree_costs.begin(), subtree_costs.end(), 0.);
+  for (auto it = top_nodes_.rbegin(); it != top_nodes_.rend(); ++it) cost += refit_node(primitive_boxes, *it);
+  const double root_area = surface_area(nodes_[0]);
+  stats.cost_ratio = root_area > 0. && build_cost_ > 0. ? cost / root_area / build_cost_ : 1.;
+  stats.refit_time = seconds_since(start);
+
+  start = std::chrono::steady_clock::now();
+  if (stats.cost_ratio > settings.full_rebuild_ratio) {
+    build(primitive_boxes);
+    stats.full_rebuild = true;
+  } else {
+    std::vector<size_t> rebuilt;
+    for (size_t index = 0; index < subtrees_.size(); index++) {
+      const subtree& s = subtrees_[index];
+      const double area = surface_area(nodes_[s.root]);
+      const bool degraded = area > 0. && subtree_costs[index] / area > settings.partial_rebuild_ratio * s.build_cost;
+      // a single leaf can't get better
+      if (s.end - s.root > 1 && degraded) {
+        rebuilt.push_back(index);
+      }
+    }
+    if (!rebuilt.empty()) rebuild_subtrees(primitive_boxes, rebuilt, pool);
+    stats.rebuilt_subtrees = rebuilt.size();
+  }
+  stats.rebuild_time = seconds_since(start);
+  return stats;
+}
+
+void bvh_tree::rebuild_subtrees(const std::vector<aabb>& boxes, const std::vector<size_t>& rebuilt,
+                                threadPool& pool) {
+  // the primitives of a subtree are the contiguous range of its leaves
+  std::vector<point3> centroids(boxes.size());
+  std::vector<std::vector<bvh_node>> rebuilt_nodes(rebuilt.size());
+  pool.run(
+      rebuilt.size(),
+      [&](size_t index, size_t) {
+        const subtree& s = subtrees_[rebuilt[index]];
+        uint32_t begin = std::numeric_limits<uint32_t>::max();
+        uint32_t end = 0;
+        for (uint32_t node = s.root; node < s.end; node++) {
+          if (!nodes_[node].is_leaf()) continue;
+          begin = std::min(begin, nodes_[node].offset);
+          end = std::max(end, nodes_[node].offset + nodes_[node].count);
+        }
+        for (uint32_t i = begin; i < end; i++) {
+          centroids[primitive_indices_[i]] = boxes[primitive_indices_[i]].centroid();
+        }
+        rebuilt_nodes[index].reserve(2 * (end - begin));
+        build_recursive(rebuilt_nodes[index], boxes, centroids, begin, end, s.depth);
+      },
+      "rebuild");
+
+  // The node indices behind a rebuilt subtree move by the difference of its old and new size. shifts[k] is the
+  // shift of the indices from the end of the k-th rebuilt subtree on.
+  std::vector<uint32_t> ends;
+  std::vector<int64_t> shifts;
+  int64_t shift = 0;
+  for (size_t k = 0; k < rebuilt.size(); k++) {
+    const subtree& s = subtrees_[rebuilt[k]];
+    shift += static_cast<int64_t>(rebuilt_nodes[k].size()) - (s.end - s.root);
+    ends.push_back(s.end);
+    shifts.push_back(shift);
+  }
+  const auto new_index = [&](uint32_t index) {
+    const size_t k = std::upper_bound(ends.begin(), ends.end(), index) - ends.begin();
+    return static_cast<uint32_t>(index + (k == 0 ? 0 : shifts[k - 1]));
+  };
+
+  std::vector<bvh_node> nodes;
+  nodes.reserve(nodes_.size() + std::max<int64_t>(0, shift));
+  size_t k = 0;
+  for (uint32_t index = 0; index < nodes_.size();) {
+    if (k < rebuilt.size() && index == subtrees_[rebuilt[k]].root) {
+      const uint32_t base = nodes.size();
+      for (bvh_node node : rebuilt_nodes[k]) {
+        if (!node.is_leaf()) node.offset += base;
+        nodes.push_back(node);
+      }
+      index = subtrees_[rebuilt[k]].end;
+      k++;
+    } else {
+      bvh_node node = nodes_[index];
+      if (!node.is_leaf()) node.offset = new_index(node.offset);
+      nodes.push_back(node);
+      index++;
+    }
+  }
+  nodes_.swap(nodes);
+
+  // the nodes above the subtrees are unchanged, so the subtrees are the same, only the rebuilt ones got a new cost
+  std::vector<subtree> previous;
+  previous.swap(subtrees_);
+  const double build_cost = build_cost_;
+  find_subtrees();
+  build_cost_ = build_cost;
+  for (size_t index = 0; index < subtrees_.size(); index++) {
+    if (!std::binary_search(rebuilt.begin(), rebuilt.end(), index)) {
+      subtrees_[index].build_cost = previous[index].build_cost;
+    }
+  }
+}
+
+bvh::bvh(const std::vector<std::shared_ptr<hittable>>& objects) {
+  std::vector<aabb> boxes;
+  aabb box;
+
+  for (const auto& object : objects) {
+    if (object->bounding_box(box)) {
+      bounded_.push_back(object);
+      boxes.push_back(box);
+    } else {
+      unbounded_.push_back(object);
+    }
+  }
+
+  tree_.build(boxes);
+  sort_objects();
+}
+
+void bvh::sort_objects() {
+  objects_.clear();
+  leaves_.clear();
+  objects_.reserve(bounded_.size());
+  leaves_.reserve(bounded_.size());
+  for (uint32_t index : tree_.primitive_indices()) {
+    objects_.push_back(bounded_[index]);
+    leaves_.push_back(bounded_[index].get());
+  }
+}
+
+bvh_update_stats bvh::update(threadPool& pool, const bvh_update_settings& settings) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<aabb> boxes(bounded_.size());
+  std::atomic<bool> lost_box{false};
+  pool.run(
+      (bounded_.size() + boxes_per_task - 1) / boxes_per_task,
+      [&](size_t task, size_t) {
+        const size_t end = std::min(bounded_.size(), (task + 1) * boxes_per_task);
+        for (size_t index = task * boxes_per_task; index < end; index++) {
+          if (!bounded_[index]->bounding_box(boxes[index])) lost_box = true;
+        }
+      },
+      "bounding boxes");
+  if (lost_box) throw std::runtime_error("an object of the bvh lost its bounding box");
+  const double boxes_time = seconds_since(start);
+
+  bvh_update_stats stats = tree_.update(boxes, pool, settings);
+  // the boxes are part of the refit
+  stats.refit_time += boxes_time;
+  if (stats.full_rebuild || stats.rebuilt_subtrees > 0) sort_objects();
+  return stats;
+}
+
+bool bvh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+  hit_record temp_rec;
+  real closest_so_far = t_max;
+
+  bool hit_anything = false;
+  for (const auto& object : unbounded_) {
+    if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+      hit_anything = true;
+      closest_so_far = temp_rec.t;
+      rec = temp_rec;
+    }
+  }
+
+  bool hit_tree = tree_.traverse(r, t_min, closest_so_far, [&](uint32_t first, uint32_t count, real& closest) {
+    bool hit_leaf = false;
+    TRACE_ADD(intersection_tests, count);
+    for (uint32_t i = first; i < first + count; i++) {
+      if (leaves_[i]->hit(r, t_min, closest, temp_rec)) {
+        hit_leaf = true;
+        closest = temp_rec.t;
+        rec = temp_rec;
+      }
+    }
+    return hit_leaf;
+  });
+
+  return hit_anything || hit_tree;
+}
+
+bool bvh::occluded(const ray& r, real t_min, real t_max) const {
+  for (const auto& object : unbounded_) {
+    if (object->occluded(r, t_min, t_max)) return true;
+  }
+
+  return tree_.traverse_any(r, t_min, t_max, [&](uint32_t first, uint32_t count) {
+    TRACE_ADD(intersection_tests, count);
+    for (uint32_t i = first; i < first + count; i++) {
+      if (leaves_[i]->occluded(r, t_min, t_max)) return true;
+    }
+    return false;
+  });
+}
+
+bool bvh::bounding_box(aabb& output_box) const {
+  if (!unbounded_.empty() || tree_.empty()) return false;
+
+  output_box = tree_.bounds();
+  return true;
+}
@@ -0,0 +1,143 @@
+#include "denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+// B3 spline, the 1D kernel of every pass
+constexpr float kernel[5] = {1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16};
+// the albedos are clamped to min_albedo before the color is divided by them, so black surfaces don't blow up
+// their noise
+constexpr float min_albedo = 0.01f;
+
+// pointers to the planes of the filter at one pixel
+struct plane_pointers {
+  const float* color[3];
+  const float* normal[3];
+  const float* albedo[3];
+  const float* depth;
+};
+
+struct edge_scales {
+  float color;
+  float normal;
+  float albedo;
+  const float* depth;  // per center pixel
+};
+
+// Adds the taps of count centers in a row to their weighted sums. The sums don't alias the planes, so the loop is
+// vectorized without run time checks, exp included.
+void add_taps(const plane_pointers& center, const plane_pointers& tap, const edge_scales& scales, float weight,
+              size_t count, float* __restrict sum_r, float* __restrict sum_g, float* __restrict sum_b,
+              float* __restrict sum_w) {
+  for (size_t x = 0; x < count; x++) {
+    const float dr = center.color[0][x] - tap.color[0][x];
+    const float dg = center.color[1][x] - tap.color[1][x];
+    const float db = center.color[2][x] - tap.color[2][x];
+    const float dnx = center.normal[0][x] - tap.normal[0][x];
+    const float dny = center.normal[1][x] - tap.normal[1][x];
+    const float dnz = center.normal[2][x] - tap.normal[2][x];
+    const float dar = center.albedo[0][x] - tap.albedo[0][x];
+    const float dag = center.albedo[1][x] - tap.albedo[1][x];
+    const float dab = center.albedo[2][x] - tap.albedo[2][x];
+    const float distance = (dr * dr + dg * dg + db * db) * scales.color +
+                           (dnx * dnx + dny * dny + dnz * dnz) * scales.normal +
+                           std::abs(center.depth[x] - tap.depth[x]) * scales.depth[x] +
+                           (dar * dar + dag * dag + dab * dab) * scales.albedo;
+    const float w = weight * std::exp(-distance);
+    sum_r[x] += w * tap.color[0][x];
+    sum_g[x] += w * tap.color[1][x];
+    sum_b[x] += w * tap.color[2][x];
+    sum_w[x] += w;
+  }
+}
+}  // namespace
+
+std::vector<color> atrousDenoiser::filter(size_t width, size_t height, const std::vector<pixel_estimate>& estimates,
+                                          const std::vector<pixel_features>& features, threadPool& pool) {
+  const auto start = std::chrono::steady_clock::now();
+  const size_t num_pixels = width * height;
+
+  for (int c = 0; c < 3; c++) {
+    color_[0][c].resize(num_pixels);
+    color_[1][c].resize(num_pixels);
+    albedo_[c].resize(num_pixels);
+    normal_[c].resize(num_pixels);
+  }
+  depth_.resize(num_pixels);
+  depth_scale_.resize(num_pixels);
+
+  for (size_t p = 0; p < num_pixels; p++) {
+    const real inv_count = estimates[p].count > 0 ? real(1) / estimates[p].count : 0;
+    for (int c = 0; c < 3; c++) {
+      albedo_[c][p] = std::max(static_cast<float>(features[p].albedo[c] * inv_count), min_albedo);
+      color_[0][c][p] = static_cast<float>(estimates[p].sum[c] * inv_count) / albedo_[c][p];
+      normal_[c][p] = static_cast<float>(features[p].normal[c] * inv_count);
+    }
+    depth_[p] = static_cast<float>(features[p].depth * inv_count);
+    depth_scale_[p] = 1.f / (settings_.sigma_depth * depth_[p] + 1e-4f);
+  }
+
+  const float normal_scale = 1.f / (settings_.sigma_normal * settings_.sigma_normal);
+  const float albedo_scale = 1.f / (settings_.sigma_albedo * settings_.sigma_albedo);
+
+  for (uint32_t iteration = 0; iteration < settings_.iterations; iteration++) {
+    const std::vector<float>* in = color_[iteration % 2];
+    std::vector<float>* out = color_[(iteration + 1) % 2];
+    const long step = 1l << iteration;
+    const float sigma_color = settings_.sigma_color / static_cast<float>(step);
+    const float color_scale = 1.f / (sigma_color * sigma_color);
+
+    pool.run(
+        height,
+        [&](size_t y, size_t) {
+          // weighted sums of the row, the taps are added for all pixels of the row at once
+          static thread_local std::vector<float> sums[4];
+          for (auto& sum : sums) sum.assign(width, 0.f);
+
+          const size_t row = y * width;
+          const auto planes_at = [&](size_t index) {
+            return plane_pointers{{in[0].data() + index, in[1].data() + index, in[2].data() + index},
+                                  {normal_[0].data() + index, normal_[1].data() + index, normal_[2].data() + index},
+                                  {albedo_[0].data() + index, albedo_[1].data() + index, albedo_[2].data() + index},
+                                  depth_.data() + index};
+          };
+
+          for (int ky = 0; ky < 5; ky++) {
+            const long tap_y = static_cast<long>(y) + (ky - 2) * step;
+            if (tap_y < 0 || tap_y >= static_cast<long>(height)) continue;
+
+            for (int kx = 0; kx < 5; kx++) {
+              // the taps outside of the image are left out, the pixels with all taps inside are one contiguous range
+              const long dx = (kx - 2) * step;
+              const long x0 = std::max(0l, -dx);
+              const long x1 = std::min(static_cast<long>(width), static_cast<long>(width) - dx);
+              if (x0 >= x1) continue;
+
+              const edge_scales scales{color_scale, normal_scale, albedo_scale, depth_scale_.data() + row + x0};
+              add_taps(planes_at(row + x0), planes_at(tap_y * width + x0 + dx), scales, kernel[ky] * kernel[kx],
+                       x1 - x0, sums[0].data() + x0, sums[1].data() + x0, sums[2].data() + x0, sums[3].data() + x0);
+            }
+          }
+
+          // the center tap is always inside, so the weight sum isn't 0
+          for (size_t x = 0; x < width; x++) {
+            const float inv_weight = 1.f / sums[3][x];
+            out[0][row + x] = sums[0][x] * inv_weight;
+            out[1][row + x] = sums[1][x] * inv_weight;
+            out[2][row + x] = sums[2][x] * inv_weight;
+          }
+        },
+        "denoise");
+  }
+
+  const std::vector<float>* filtered = color_[settings_.iterations % 2];
+  std::vector<color> colors(num_pixels);
+  for (size_t p = 0; p < num_pixels; p++) {
+    colors[p] = color(filtered[0][p] * albedo_[0][p], filtered[1][p] * albedo_[1][p], filtered[2][p] * albedo_[2][p]);
+  }
+
+  last_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return colors;
+}
@@ -0,0 +1,456 @@
+#include "distributed.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "bvh.h"
+#include "raytrace.h"
+#include "stop_watch.h"
+#include "thread_pool.h"
+
+namespace {
+const char message_magic[4] = {'R', 'T', 'D', 'W'};
+
+enum class message_type : uint32_t { hello = 1, job = 2, result = 3, quit = 4 };
+
+struct message_header {
+  char magic[4];
+  message_type type;
+  uint64_t size;  // bytes of the payload
+};
+
+// followed by the scene text
+struct hello_message {
+  uint32_t threads;
+  uint32_t fail_after;
+  uint32_t roulette_depth;  // default_roulette_depth: the default of the raytracer
+  sampler_type sampler;
+};
+
+constexpr uint32_t default_roulette_depth = UINT32_MAX;
+
+struct job_message {
+  uint64_t job;
+  uint64_t frame;
+  double lookfrom[3];
+  uint32_t x0, y0, x1, y1;
+};
+
+// followed by 3 floats per pixel of the region, rows from bottom to top
+struct result_message {
+  uint64_t job;
+  double render_time;
+};
+
+double now() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// false if the connection is closed before all bytes are read or written
+bool read_all(int fd, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t count = ::read(fd, bytes, size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    // a closed connection is an error and no SIGPIPE, the coordinator handles it like a crashed worker
+    ssize_t count = ::send(fd, bytes, size, MSG_NOSIGNAL);
+    if (count < 0 && errno == ENOTSOCK) count = ::write(fd, bytes, size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+bool write_message(int fd, message_type type, const void* payload, size_t size, const void* data = nullptr,
+                   size_t data_size = 0) {
+  message_header header;
+  std::copy(message_magic, message_magic + 4, header.magic);
+  header.type = type;
+  header.size = size + data_size;
+  return write_all(fd, &header, sizeof(header)) && write_all(fd, payload, size) &&
+         write_all(fd, data, data_size);
+}
+
+bool read_header(int fd, message_header& header) {
+  return read_all(fd, &header, sizeof(header)) && std::equal(message_magic, message_magic + 4, header.magic);
+}
+
+size_t pixels(const tile& region) { return size_t(region.x1 - region.x0) * (region.y1 - region.y0); }
+}  // namespace
+
+double distributedRender::run_stats::efficiency() const {
+  double render_time = 0.;
+  for (const auto& w : workers) {
+    render_time += w.render_time;
+  }
+  return wall_time > 0. ? render_time / (workers.size() * wall_time) : 0.;
+}
+
+distributedRender::distributedRender(const scene& s, const distributed_settings& settings)
+    : settings_(settings), render_settings_(s.settings) {
+  if (settings_.workers == 0) throw std::invalid_argument("at least one worker is needed");
+  if (settings_.worker_command.empty()) throw std::invalid_argument("no worker command");
+  if (settings_.threads_per_worker == 0) {
+    settings_.threads_per_worker = std::max<size_t>(1, std::thread::hardware_concurrency() / settings_.workers);
+  }
+
+  std::ostringstream scene_text;
+  sceneLoader::write_text(s, scene_text);
+
+  workers_.resize(settings_.workers);
+  stats_.workers.resize(settings_.workers);
+  try {
+    for (size_t index = 0; index < workers_.size(); index++) {
+      start_worker(index, scene_text.str());
+    }
+  } catch (...) {
+    for (auto& w : workers_) {
+      stop_worker(w, true);
+    }
+    throw;
+  }
+}
+
+distributedRender::~distributedRender() {
+  for (auto& w : workers_) {
+    stop_worker(w, false);
+  }
+}
+
+void distributedRender::start_worker(size_t index, const std::string& scene_text) {
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    throw std::runtime_error("can't create the socket of a worker");
+  }
+
+  // everything the child needs is prepared before the fork, it only calls async signal safe functions
+  std::vector<char*> argv;
+  for (const auto& arg : settings_.worker_command) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    throw std::runtime_error("can't start a worker");
+  }
+  if (pid == 0) {
+    // dup2 clears close on exec of the copies
+    if (::dup2(fds[1], STDIN_FILENO) < 0 || ::dup2(fds[1], STDOUT_FILENO) < 0) ::_exit(127);
+    ::execvp(argv[0], argv.data());
+    ::_exit(127);
+  }
+  ::close(fds[1]);
+
+  worker& w = workers_[index];
+  w.fd = fds[0];
+  w.pid = pid;
+  w.alive = true;
+  stats_.workers[index].pid = pid;
+
+  hello_message message{};
+  message.threads = settings_.threads_per_worker;
+  message.fail_after = index == 0 ? settings_.fail_after : 0;
+  message.roulette_depth = settings_.roulette_depth.value_or(default_roulette_depth);
+  message.sampler = settings_.sampler;
+  // a worker which couldn't be started fails with the first result
+  write_message(w.fd, message_type::hello, &message, sizeof(message), scene_text.data(), scene_text.size());
+}
+
+void distributedRender::stop_worker(worker& w, bool kill) {
+  if (w.fd < 0) return;
+
+  // a worker in the middle of a job is killed, an idle one stops when it reads the quit message
+  if (!kill && w.alive && w.in_flight.empty()) {
+    write_message(w.fd, message_type::quit, nullptr, 0);
+  } else {
+    ::kill(w.pid, SIGKILL);
+  }
+  ::close(w.fd);
+  w.fd = -1;
+  w.alive = false;
+
+  int status;
+  while (::waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {
+  }
+}
+
+void distributedRender::render(const std::vector<frame_job>& frames, const frame_callback& on_frame) {
+  frames_ = &frames;
+  jobs_.clear();
+  pending_.clear();
+  frames_in_progress_.clear();
+  stats_.frames = 0;
+  stats_.jobs = 0;
+  stats_.retried = 0;
+  for (auto& w : stats_.workers) {
+    w.jobs = 0;
+    w.pixels = 0;
+    w.render_time = 0.;
+  }
+
+  const uint32_t width = render_settings_.image_width;
+  const uint32_t height = render_settings_.image_height;
+  const uint32_t tile_size = settings_.tile_size;
+  const bool split = tile_size > 0 && size_t(width) * height > size_t(tile_size) * tile_size;
+  const std::vector<tile> regions =
+      split ? tileScheduler::generate(width, height, tile_size, tile_order::scanline)
+            : std::vector<tile>{tile{0, 0, width, height}};
+
+  for (size_t frame_index = 0; frame_index < frames.size(); frame_index++) {
+    for (const tile& region : regions) {
+      pending_.push_back(jobs_.size());
+      jobs_.push_back(job{frame_index, region});
+    }
+    frames_in_progress_[frame_index].missing_tiles = regions.size();
+  }
+  stats_.jobs = jobs_.size();
+
+  stopWatch stop_watch;
+  stop_watch.start();
+
+  while (!frames_in_progress_.empty()) {
+    std::vector<pollfd> fds;
+    std::vector<size_t> fd_workers;
+    for (size_t index = 0; index < workers_.size(); index++) {
+      worker& w = workers_[index];
+      while (w.alive && w.in_flight.size() < settings_.jobs_per_worker && !pending_.empty()) {
+        const uint64_t job_id = pending_.front();
+        pending_.pop_front();
+        send_job(index, job_id);
+      }
+      if (w.alive) {
+        fds.push_back(pollfd{w.fd, POLLIN, 0});
+        fd_workers.push_back(index);
+      }
+    }
+    if (fds.empty()) throw std::runtime_error("all workers failed");
+
+    const int timeout_ms = settings_.job_timeout > 0. ? 100 : -1;
+    if (::poll(fds.data(), fds.size(), timeout_ms) < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("poll of the workers failed");
+    }
+
+    for (size_t k = 0; k < fds.size(); k++) {
+      if (fds[k].revents != 0 && workers_[fd_workers[k]].alive) receive_result(fd_workers[k], on_frame);
+    }
+
+    if (settings_.job_timeout > 0.) {
+      const double time = now();
+      for (size_t index = 0; index < workers_.size(); index++) {
+        const worker& w = workers_[index];
+        if (w.alive && !w.in_flight.empty() && time - w.last_progress > settings_.job_timeout) {
+          fail_worker(index, "no result within " + std::to_string(settings_.job_timeout) + "s");
+        }
+      }
+    }
+  }
+
+  stats_.wall_time = stop_watch.stop();
+  frames_ = nullptr;
+}
+
+void distributedRender::send_job(size_t worker_index, uint64_t job_id) {
+  worker& w = workers_[worker_index];
+  job& j = jobs_[job_id];
+  const frame_job& frame = (*frames_)[j.frame_index];
+
+  job_message message;
+  message.job = job_id;
+  message.frame = frame.frame;
+  for (int c = 0; c < 3; c++) {
+    message.lookfrom[c] = frame.lookfrom[c];
+  }
+  message.x0 = j.region.x0;
+  message.y0 = j.region.y0;
+  message.x1 = j.region.x1;
+  message.y1 = j.region.y1;
+
+  if (w.in_flight.empty()) w.last_progress = now();
+  w.in_flight.push_back(job_id);
+  j.attempts++;
+
+  if (!write_message(w.fd, message_type::job, &message, sizeof(message))) {
+    fail_worker(worker_index, "connection closed");
+  }
+}
+
+void distributedRender::receive_result(size_t worker_index, const frame_callback& on_frame) {
+  worker& w = workers_[worker_index];
+
+  message_header header;
+  result_message message;
+  if (!read_header(w.fd, header) || header.type != message_type::result || w.in_flight.empty() ||
+      !read_all(w.fd, &message, sizeof(message))) {
+    fail_worker(worker_index, "connection closed");
+    return;
+  }
+
+  // the worker answers the jobs in the order they were sent
+  const uint64_t job_id = w.in_flight.front();
+  const job& j = jobs_[job_id];
+  const size_t num_pixels = pixels(j.region);
+  if (message.job != job_id || header.size != sizeof(message) + 3 * num_pixels * sizeof(float)) {
+    fail_worker(worker_index, "unexpected result");
+    return;
+  }
+
+  std::vector<float> tile_pixels(3 * num_pixels);
+  if (!read_all(w.fd, tile_pixels.data(), tile_pixels.size() * sizeof(float))) {
+    fail_worker(worker_index, "connection closed");
+    return;
+  }
+  w.in_flight.pop_front();
+  w.last_progress = now();
+
+  worker_stats& stats = stats_.workers[worker_index];
+  stats.jobs++;
+  stats.pixels += num_pixels;
+  stats.render_time += message.render_time;
+
+  const uint32_t width = render_settings_.image_width;
+  const uint32_t height = render_settings_.image_height;
+  frame_buffer& buffer = frames_in_progress_.at(j.frame_index);
+  if (buffer.pixels.empty()) buffer.pixels.resize(3ul * width * height);
+
+  const float* source = tile_pixels.data();
+  for (uint32_t y = j.region.y0; y < j.region.y1; y++) {
+    const size_t row_pixels = 3 * (j.region.x1 - j.region.x0);
+    std::copy(source, source + row_pixels, &buffer.pixels[3 * (size_t(y) * width + j.region.x0)]);
+    source += row_pixels;
+  }
+
+  if (--buffer.missing_tiles > 0) return;
+
+  const frame_job& frame = (*frames_)[j.frame_index];
+  ImageWrapper image(frame.filename, width, height);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      const float* pixel = &buffer.pixels[3 * (size_t(y) * width + x)];
+      image.write_color(x, y, color(pixel[0], pixel[1], pixel[2]), 1);
+    }
+  }
+  frames_in_progress_.erase(j.frame_index);
+  stats_.frames++;
+
+  on_frame(std::move(image), frame);
+}
+
+void distributedRender::fail_worker(size_t worker_index, const std::string& reason) {
+  worker& w = workers_[worker_index];
+  std::cerr << "worker " << w.pid << " failed: " << reason;
+  if (!w.in_flight.empty()) std::cerr << ", " << w.in_flight.size() << " jobs are sent to the other workers";
+  std::cerr << std::endl;
+
+  // the jobs go to the front of the queue, so their frames are finished first
+  stop_worker(w, true);
+  const std::deque<uint64_t> in_flight = std::move(w.in_flight);
+  w.in_flight.clear();
+  stats_.workers[worker_index].failed = true;
+
+  for (auto it = in_flight.rbegin(); it != in_flight.rend(); ++it) {
+    if (jobs_[*it].attempts >= settings_.max_attempts) {
+      throw std::runtime_error("job " + std::to_string(*it) + " failed on " + std::to_string(jobs_[*it].attempts) +
+                               " workers");
+    }
+    pending_.push_front(*it);
+    stats_.retried++;
+  }
+}
+
+int distributedRender::worker_main(int in, int out) {
+  try {
+    message_header header;
+    hello_message hello_data;
+    if (!read_header(in, header) || header.type != message_type::hello || header.size < sizeof(hello_data) ||
+        !read_all(in, &hello_data, sizeof(hello_data))) {
+      throw std::runtime_error("no scene from the coordinator");
+    }
+    std::string scene_text(header.size - sizeof(hello_data), '\0');
+    if (!read_all(in, scene_text.data(), scene_text.size())) throw std::runtime_error("scene is truncated");
+
+    std::istringstream stream(scene_text);
+    const scene s = sceneLoader::read_text(stream, "scene of the coordinator");
+    const render_settings& settings = s.settings;
+    raytrace raytracer(std::make_shared<bvh>(*s.world), s.materials, settings.image_width, settings.image_height,
+                       settings.samples_per_pixel, settings.max_depth,
+                       std::make_shared<threadPool>(std::max<uint32_t>(1, hello_data.threads)));
+    raytracer.set_background(s.background);
+    if (hello_data.roulette_depth != default_roulette_depth) raytracer.set_roulette_depth(hello_data.roulette_depth);
+    raytracer.set_sampler(hello_data.sampler);
+
+    std::vector<float> tile_pixels;
+    size_t finished_jobs = 0;
+    while (read_header(in, header)) {
+      if (header.type == message_type::quit) return 0;
+
+      job_message message;
+      if (header.type != message_type::job || header.size != sizeof(message) ||
+          !read_all(in, &message, sizeof(message))) {
+        throw std::runtime_error("unexpected message from the coordinator");
+      }
+
+      // a crash after some jobs, the coordinator has to retry the unanswered ones
+      if (hello_data.fail_after > 0 && finished_jobs == hello_data.fail_after) return 3;
+
+      stopWatch stop_watch;
+      stop_watch.start();
+      const tile region{message.x0, message.y0, message.x1, message.y1};
+      raytracer.set_frame(message.frame);
+      raytracer.render(s.make_camera(point3(message.lookfrom[0], message.lookfrom[1], message.lookfrom[2])), region);
+
+      const auto& estimates = raytracer.pixel_estimates();
+      tile_pixels.clear();
+      for (uint32_t y = region.y0; y < region.y1; y++) {
+        for (uint32_t x = region.x0; x < region.x1; x++) {
+          const pixel_estimate& estimate = estimates[size_t(y) * settings.image_width + x];
+          // the same rounding as ImageWrapper::write_color, the frames are bit identical to a local render
+          const double scale = 1.0 / estimate.count;
+          for (int c = 0; c < 3; c++) {
+            tile_pixels.push_back(static_cast<float>(scale * estimate.sum[c]));
+          }
+        }
+      }
+
+      result_message answer{message.job, stop_watch.stop()};
+      if (!write_message(out, message_type::result, &answer, sizeof(answer), tile_pixels.data(),
+                         tile_pixels.size() * sizeof(float))) {
+        return 1;
+      }
+      finished_jobs++;
+    }
+    // the coordinator closed the connection
+    return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "worker: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -1,10 +1,13 @@
 #include "hittable_list.h"
 
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+#include "trace_stats.h"
+
+bool hittable_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
   hit_record temp_rec;
   bool hit_anything = false;
-  double closest_so_far = t_max;
+  real closest_so_far = t_max;
 
+  TRACE_ADD(intersection_tests, objects.size());
   for (const auto& object : objects) {
     if (object->hit(r, t_min, closest_so_far, temp_rec)) {
       hit_anything = true;
@@ -14,4 +17,26 @@ bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& re
   }
 
   return hit_anything;
-}
\ No newline at end of file
+}
+
+bool hittable_list::occluded(const ray& r, real t_min, real t_max) const {
+  for (const auto& object : objects) {
+    TRACE_COUNT(intersection_tests);
+    if (object->occluded(r, t_min, t_max)) return true;
+  }
+  return false;
+}
+
+bool hittable_list::bounding_box(aabb& output_box) const {
+  if (objects.empty()) return false;
+
+  aabb temp_box;
+  output_box = aabb();
+
+  for (const auto& object : objects) {
+    if (!object->bounding_box(temp_box)) return false;
+    output_box.grow(temp_box);
+  }
+
+  return true;
+}
@@ -0,0 +1,255 @@
+#include "image_formats.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef USE_PNG
+#include <png++/png.hpp>
+#endif
+
+namespace {
+// gamma 2, in double because -ffast-math approximates the float sqrt, which changes values at the rounding boundaries
+uint8_t to_8bit(float linear) {
+  double value = std::sqrt(std::max(0., static_cast<double>(linear)));
+  return static_cast<uint8_t>(256 * std::min(value, 0.999));
+}
+
+void append(std::string& out, const void* data, size_t size) { out.append(static_cast<const char*>(data), size); }
+
+std::string netpbm_header(const char* magic, uint32_t width, uint32_t height, const char* maximum) {
+  return std::string(magic) + "\n" + std::to_string(width) + " " + std::to_string(height) + "\n" + maximum + "\n";
+}
+
+void encode_p3(std::string& out, uint32_t width, uint32_t height, const float* pixels) {
+  out = netpbm_header("P3", width, height, "255");
+  out.reserve(out.size() + 12ul * width * height);
+
+  // one pixel per line, lines of netpbm files should be shorter than 70 characters; "255 255 255\n" at most
+  std::vector<char> row(12ul * width);
+  for (uint32_t y = 0; y < height; y++) {
+    char* position = row.data();
+    const float* pixel = pixels + 3ul * width * y;
+    for (uint32_t c = 0; c < 3 * width; c++) {
+      position = std::to_chars(position, row.data() + row.size(), to_8bit(pixel[c])).ptr;
+      *position++ = (c % 3 == 2) ? '\n' : ' ';
+    }
+    append(out, row.data(), position - row.data());
+  }
+}
+
+void encode_p6(std::string& out, uint32_t width, uint32_t height, const float* pixels) {
+  out = netpbm_header("P6", width, height, "255");
+  out.reserve(out.size() + 3ul * width * height);
+
+  std::vector<uint8_t> row(3ul * width);
+  for (uint32_t y = 0; y < height; y++) {
+    const float* pixel = pixels + 3ul * width * y;
+    for (size_t c = 0; c < row.size(); c++) {
+      row[c] = to_8bit(pixel[c]);
+    }
+    append(out, row.data(), row.size());
+  }
+}
+
+void encode_pfm(std::string& out, uint32_t width, uint32_t height, const float* pixels) {
+  // negative scale: little endian
+  out = netpbm_header("PF", width, height, "-1.0");
+  out.reserve(out.size() + 3ul * sizeof(float) * width * height);
+
+  // the rows of PFM go from bottom to top
+  for (uint32_t y = height; y-- > 0;) {
+    append(out, pixels + 3ul * width * y, 3ul * sizeof(float) * width);
+  }
+}
+
+// shared exponent of the largest component and 8 bit mantissas
+void to_rgbe(const float* rgb, uint8_t* rgbe) {
+  float maximum = std::max({rgb[0], rgb[1], rgb[2]});
+  if (maximum < 1e-32f) {
+    rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+    return;
+  }
+
+  int exponent;
+  float scale = std::frexp(maximum, &exponent) * 256.f / maximum;
+  for (int c = 0; c < 3; c++) {
+    rgbe[c] = static_cast<uint8_t>(std::max(0.f, rgb[c]) * scale);
+  }
+  rgbe[3] = static_cast<uint8_t>(exponent + 128);
+}
+
+// run length encoding of one component of a scanline: runs of at least 4 equal bytes are written as 128 + length and
+// the byte, everything else as literal runs with the length and the bytes, both at most 127 bytes long
+void encode_rle(std::string& out, const uint8_t* data, size_t size) {
+  constexpr size_t min_run = 4;
+  size_t position = 0;
+
+  while (position < size) {
+    // find the next run which is long enough
+    size_t run_begin = position;
+    size_t run_length = 0;
+    while (run_begin < size) {
+      run_length = 1;
+      while (run_begin + run_length < size && run_length < 127 && data[run_begin + run_length] == data[run_begin]) {
+        run_length++;
+      }
+      if (run_length >= min_run) break;
+      run_begin += run_length;
+    }
+    if (run_begin >= size) run_length = 0;
+
+    // literals before the run
+    while (position < run_begin) {
+      size_t count = std::min<size_t>(128, run_begin - position);
+      out.push_back(static_cast<char>(count));
+      append(out, data + position, count);
+      position += count;
+    }
+
+    if (run_length >= min_run) {
+      out.push_back(static_cast<char>(128 + run_length));
+      out.push_back(static_cast<char>(data[run_begin]));
+      position += run_length;
+    }
+  }
+}
+
+void encode_hdr(std::string& out, uint32_t width, uint32_t height, const float* pixels) {
+  out = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(height) + " +X " + std::to_string(width) + "\n";
+  out.reserve(out.size() + 4ul * width * height);
+
+  // run length encoded scanlines are only defined for widths from 8 to 32767
+  const bool rle = width >= 8 && width < 32768;
+  std::vector<uint8_t> rgbe(4ul * width);
+  std::vector<uint8_t> component(width);
+  for (uint32_t y = 0; y < height; y++) {
+    const float* pixel = pixels + 3ul * width * y;
+    for (uint32_t x = 0; x < width; x++) {
+      to_rgbe(pixel + 3 * x, &rgbe[4 * x]);
+    }
+
+    if (!rle) {
+      append(out, rgbe.data(), rgbe.size());
+      continue;
+    }
+
+    const uint8_t scanline_header[4] = {2, 2, static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width & 0xff)};
+    append(out, scanline_header, sizeof(scanline_header));
+    for (int c = 0; c < 4; c++) {
+      for (uint32_t x = 0; x < width; x++) {
+        component[x] = rgbe[4 * x + c];
+      }
+      encode_rle(out, component.data(), width);
+    }
+  }
+}
+
+#ifdef USE_PNG
+void encode_png(std::string& out, uint32_t width, uint32_t height, const float* pixels) {
+  png::image<png::rgb_pixel> image(width, height);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      const float* pixel = pixels + 3ul * (width * y + x);
+      image.set_pixel(x, y, png::rgb_pixel(to_8bit(pixel[0]), to_8bit(pixel[1]), to_8bit(pixel[2])));
+    }
+  }
+
+  std::ostringstream stream;
+  image.write_stream(stream);
+  out = stream.str();
+}
+#endif
+}  // namespace
+
+std::string imageEncoder::encode(image_type type, uint32_t width, uint32_t height, const float* pixels) {
+  std::string out;
+
+  switch (type) {
+    case image_type::png:
+#ifdef USE_PNG
+      encode_png(out, width, height, pixels);
+      break;
+#else
+      throw std::invalid_argument("png output needs png++");
+#endif
+    case image_type::p3:
+      encode_p3(out, width, height, pixels);
+      break;
+    case image_type::p6:
+      encode_p6(out, width, height, pixels);
+      break;
+    case image_type::pfm:
+      encode_pfm(out, width, height, pixels);
+      break;
+    case image_type::hdr:
+      encode_hdr(out, width, height, pixels);
+      break;
+  }
+
+  return out;
+}
+
+std::vector<float> imageEncoder::decode_pfm(const std::string& content, uint32_t& width, uint32_t& height) {
+  std::istringstream header(content);
+  std::string magic;
+  double scale;
+  header >> magic >> width >> height >> scale;
+  // a single whitespace character ends the header
+  header.get();
+  if (!header || magic != "PF" || scale >= 0) throw std::runtime_error("no little endian color PFM");
+
+  const size_t offset = header.tellg();
+  const size_t row_size = 3ul * sizeof(float) * width;
+  if (content.size() - offset != row_size * height) throw std::runtime_error("wrong size of the PFM pixels");
+
+  std::vector<float> pixels(3ul * width * height);
+  for (uint32_t y = 0; y < height; y++) {
+    std::memcpy(pixels.data() + 3ul * width * (height - 1 - y), content.data() + offset + row_size * y, row_size);
+  }
+  return pixels;
+}
+
+image_type imageEncoder::parse_type(const std::string& name) {
+  if (name == "png") return image_type::png;
+  if (name == "p3") return image_type::p3;
+  if (name == "p6") return image_type::p6;
+  if (name == "pfm") return image_type::pfm;
+  if (name == "hdr") return image_type::hdr;
+
+  throw std::invalid_argument("unknown image type " + name);
+}
+
+std::string imageEncoder::type_name(image_type type) {
+  switch (type) {
+    case image_type::png:
+      return "png";
+    case image_type::p3:
+      return "p3";
+    case image_type::pfm:
+      return "pfm";
+    case image_type::hdr:
+      return "hdr";
+    default:
+      return "p6";
+  }
+}
+
+std::string imageEncoder::extension(image_type type) {
+  switch (type) {
+    case image_type::png:
+      return ".png";
+    case image_type::p3:
+      return ".p3";
+    case image_type::pfm:
+      return ".pfm";
+    case image_type::hdr:
+      return ".hdr";
+    default:
+      return ".ppm";
+  }
+}
@@ -0,0 +1,101 @@
+#include "image_writer.h"
+
+#include <algorithm>
+
+#include "stop_watch.h"
+
+imageWriter::imageWriter(size_t queue_capacity, size_t num_threads)
+    : queue_capacity_(std::max<size_t>(1, queue_capacity)) {
+  num_threads = std::max<size_t>(1, num_threads);
+
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&imageWriter::worker_loop, this);
+  }
+}
+
+imageWriter::~imageWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_condition_.notify_all();
+
+  // the workers empty the queue before they stop
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+double imageWriter::push(ImageWrapper image) {
+  stopWatch stop_watch;
+  stop_watch.start();
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_condition_.wait(lock, [this] { return queue_.size() < queue_capacity_ || error_; });
+    rethrow_error();
+    queue_.push_back(std::move(image));
+  }
+  work_condition_.notify_one();
+
+  return stop_watch.stop();
+}
+
+void imageWriter::finish() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  space_condition_.wait(lock, [this] { return (queue_.empty() && in_progress_ == 0) || error_; });
+  rethrow_error();
+}
+
+std::vector<imageWriter::frame_stats> imageWriter::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void imageWriter::rethrow_error() {
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void imageWriter::worker_loop() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_condition_.wait(lock, [this] { return !queue_.empty() || shutdown_; });
+    if (queue_.empty()) return;
+
+    ImageWrapper image = std::move(queue_.front());
+    queue_.pop_front();
+    in_progress_++;
+    lock.unlock();
+    space_condition_.notify_all();
+
+    frame_stats stats;
+    stats.filename = image.filename();
+    std::exception_ptr error;
+    try {
+      stopWatch stop_watch;
+      stop_watch.start();
+      const std::string data = image.encode();
+      stats.encode_time = stop_watch.stop();
+
+      stop_watch.start();
+      ImageWrapper::write_file(stats.filename, data);
+      stats.write_time = stop_watch.stop();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    in_progress_--;
+    if (error) {
+      error_ = error;
+    } else {
+      stats_.push_back(stats);
+    }
+    lock.unlock();
+    space_condition_.notify_all();
+  }
+}
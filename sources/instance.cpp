@@ -0,0 +1,32 @@
+#include "instance.h"
+
+#include <algorithm>
+
+bool instance::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+  if (!geometry_->hit(to_object(r), t_min, t_max, rec)) return false;
+
+  rec.p = r.at(rec.t);
+  // normals transform with the transposed inverse, the sign of dot(direction, normal) and so front_face is kept
+  rec.normal = unit_vector(world_to_object_.apply_transposed(rec.normal));
+  if (mat_index_ != keep_material) rec.mat_index = mat_index_;
+  return true;
+}
+
+bool instance::occluded(const ray& r, real t_min, real t_max) const {
+  return geometry_->occluded(to_object(r), t_min, t_max);
+}
+
+bool instance::bounding_box(aabb& output_box) const {
+  aabb object_box;
+  if (!geometry_->bounding_box(object_box)) return false;
+
+  // the inverse of the inverse is off in the last digits, padded like the triangle boxes of triangle_mesh
+  const aabb box = object_to_world().apply_box(object_box);
+  real magnitude = 0;
+  for (int a = 0; a < 3; a++) {
+    magnitude = std::max({magnitude, std::abs(box.min()[a]), std::abs(box.max()[a])});
+  }
+  const vec3 pad(real(1e-6) * magnitude, real(1e-6) * magnitude, real(1e-6) * magnitude);
+  output_box = aabb(box.min() - pad, box.max() + pad);
+  return true;
+}
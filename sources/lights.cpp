@@ -0,0 +1,68 @@
+#include "lights.h"
+
+#include "bvh.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+lightSampler::lightSampler(const hittable& world, const material_table& materials) { collect(world, materials); }
+
+void lightSampler::collect(const hittable& object, const material_table& materials) {
+  if (const auto* list = dynamic_cast<const hittable_list*>(&object)) {
+    for (const auto& child : list->objects) collect(*child, materials);
+  } else if (const auto* tree = dynamic_cast<const bvh*>(&object)) {
+    for (const auto& child : tree->objects()) collect(*child, materials);
+  } else if (const auto* s = dynamic_cast<const sphere*>(&object)) {
+    if (const auto* light = std::get_if<diffuse_light>(&materials[s->mat_index])) {
+      lights_.push_back(sphere_light{s->center, s->radius, s->mat_index, light->emit});
+    }
+  }
+}
+
+real lightSampler::cone_size(const sphere_light& light, const point3& p) {
+  const real distance_squared = (light.center - p).squaredNorm();
+  const real radius_squared = light.radius * light.radius;
+  if (distance_squared <= radius_squared) return 0;
+
+  // 1 - cos written as sin^2 / (1 + cos), small lights would cancel out all digits of 1 - cos
+  const real sin_squared = radius_squared / distance_squared;
+  return sin_squared / (1 + std::sqrt(1 - sin_squared));
+}
+
+bool lightSampler::sample(const point3& p, light_sample& sample) const {
+  const size_t index = std::min(lights_.size() - 1, static_cast<size_t>(random_real() * lights_.size()));
+  const sphere_light& light = lights_[index];
+
+  const real size = cone_size(light, p);
+  const real r1 = random_real();
+  const real r2 = random_real();
+  if (size <= 0) return false;
+
+  const vec3 to_center = light.center - p;
+  const real distance = to_center.norm();
+  const vec3 w = to_center / distance;
+  const vec3 v = unit_vector(cross(w, std::abs(w[0]) > real(0.9) ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+  const vec3 u = cross(w, v);
+
+  const real cos_theta = 1 - r1 * size;
+  const real sin_theta = std::sqrt(std::max(real(0), 1 - cos_theta * cos_theta));
+  const real phi = 2 * pi * r2;
+  sample.direction = std::cos(phi) * sin_theta * u + std::sin(phi) * sin_theta * v + cos_theta * w;
+  // near intersection of the direction with the sphere
+  const real half_chord_squared = light.radius * light.radius - distance * distance * sin_theta * sin_theta;
+  sample.distance = distance * cos_theta - std::sqrt(std::max(real(0), half_chord_squared));
+  sample.emitted = light.emit;
+  sample.pdf = 1 / (2 * pi * size * lights_.size());
+  return true;
+}
+
+real lightSampler::pdf(const point3& origin, const hit_record& rec) const {
+  for (const sphere_light& light : lights_) {
+    // the light with the material of the hit and the hit point on its surface
+    if (light.mat_index != rec.mat_index) continue;
+    if (std::abs((rec.p - light.center).norm() - light.radius) > real(1e-3) * light.radius) continue;
+
+    const real size = cone_size(light, origin);
+    return size > 0 ? 1 / (2 * pi * size * lights_.size()) : 0;
+  }
+  return 0;
+}
@@ -1,74 +1,382 @@
 #include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
 
+#include <unistd.h>
+
+#include "adaptive_sampling.h"
+#include "bvh.h"
 #include "camera.h"
 #include "color.h"
+#include "distributed.h"
 #include "hittable_list.h"
+#include "image_writer.h"
 #include "material.h"
+#include "progressive.h"
 #include "random_world.h"
 #include "raytrace.h"
 #include "rtweekend.h"
+#include "sampler.h"
+#include "scene.h"
 #include "sphere.h"
 #include "stop_watch.h"
+#include "temporal.h"
+#include "thread_pool.h"
+#include "trace_stats.h"
 
-static void log(double delta_time, size_t image_number, size_t num_rotation_steps) {
+static void log(double delta_time, double utilization, size_t image_number, size_t num_rotation_steps,
+                const imageWriter::frame_stats* written = nullptr,
+                const temporalReuse::frame_stats* reuse = nullptr) {
   double finished_in = delta_time * (num_rotation_steps - image_number);
   std::cout << "Finished " << image_number << " of " << num_rotation_steps << " -> calc time " << std::fixed << std::setprecision(3)
-            << std::setfill('0') << delta_time << "s, sequence will be finished in " << std::setprecision(1) << finished_in
-            << "s == " << finished_in / 60. << "m == " << finished_in / 3600. << "h\r" << std::flush;
+            << std::setfill('0') << delta_time << "s, threads busy " << std::setprecision(1) << 100. * utilization
+            << "%, sequence will be finished in " << finished_in << "s == " << finished_in / 60. << "m == "
+            << finished_in / 3600. << "h";
+  if (written) {
+    std::cout << ", last image encoded in " << std::setprecision(3) << written->encode_time << "s, written in "
+              << written->write_time << "s";
+  }
+  if (reuse) {
+    std::cout << ", reused " << std::setprecision(1) << 100. * reuse->reuse_ratio() << "% of the pixels, "
+              << reuse->samples_per_pixel() << " samples per pixel";
+  }
+  std::cout << "\r" << std::flush;
+}
+
+static void log_writer(const std::vector<imageWriter::frame_stats>& stats, double render_time, double wait_time) {
+  double encode_time = 0.;
+  double write_time = 0.;
+  for (const auto& frame : stats) {
+    encode_time += frame.encode_time;
+    write_time += frame.write_time;
+  }
+  const double frames = std::max<size_t>(1, stats.size());
+  std::cout << std::fixed << std::setprecision(4) << "Per frame: render " << render_time / frames << "s, encode "
+            << encode_time / frames << "s, write " << write_time / frames << "s, render threads waited for the writer "
+            << wait_time / frames << "s" << std::endl;
 }
 
-int main() {
-  constexpr double aspect_ratio = 16.0 / 9.0;
-  constexpr size_t image_width = 320;
-  constexpr size_t image_height = static_cast<int>(image_width / aspect_ratio);
-  constexpr size_t samples_per_pixel = 50;
-  constexpr uint8_t max_depth = 50;
-  // const uint32_t num_threads = std::thread::hardware_concurrency();
+static std::atomic<bool> stop_requested{false};
+
+static void request_stop(int) { stop_requested = true; }
+
+// Refines a single image pass by pass. With a checkpoint file the state is saved after every pass and when the job is
+// terminated (SIGINT/SIGTERM), --resume continues from the checkpoint with the same result as an uninterrupted run.
+static int progressive(raytrace& raytracer, const camera& cam, size_t num_passes, size_t preview_interval,
+                       const std::string& checkpoint, bool resume, image_type type) {
+  progressiveRender renderer(raytracer);
+  if (resume) {
+    try {
+      renderer.load_checkpoint(checkpoint);
+    } catch (const std::runtime_error& e) {
+      std::cerr << "can't resume: " << e.what() << std::endl;
+      return 1;
+    }
+    std::cout << "Resuming after pass " << renderer.passes() << std::endl;
+  }
+
+  std::signal(SIGINT, request_stop);
+  std::signal(SIGTERM, request_stop);
+
+  while (renderer.passes() < num_passes && !stop_requested) {
+    stopWatch stop_watch;
+    stop_watch.start();
+
+    renderer.add_pass(cam);
+    if (!checkpoint.empty()) renderer.save_checkpoint(checkpoint);
+    if (preview_interval > 0 && renderer.passes() % preview_interval == 0) renderer.image("preview", type).write();
+
+    log(stop_watch.stop(), raytracer.thread_pool().utilization(), renderer.passes(), num_passes);
+  }
+
+  renderer.image("progressive", type).write();
+  std::cout << "\n" << (stop_requested ? "Stopped" : "Done") << " after " << renderer.passes() << " passes, "
+            << renderer.samples_per_pixel() << " samples per pixel." << std::endl;
+
+  return 0;
+}
 
-  const point3 lower_left_corner(-2.0, -1.0, -1.0);
-  const vec3 horizontal(4.0, 0.0, 0.0);
-  const vec3 vertical(0.0, 2.0, 0.0);
-  const point3 origin(0.0, 0.0, 0.0);
+static void log_workers(const distributedRender::run_stats& stats) {
+  std::cout << std::fixed << std::setprecision(3) << stats.frames << " frames in " << stats.wall_time << "s, "
+            << stats.jobs << " jobs, " << stats.retried << " retried" << std::endl;
+  for (const auto& worker : stats.workers) {
+    std::cout << "  worker " << worker.pid << ": " << worker.jobs << " jobs, " << worker.pixels << " pixels, rendered "
+              << std::setprecision(3) << worker.render_time << "s" << (worker.failed ? ", failed" : "") << std::endl;
+  }
+  std::cout << "Workers busy " << std::setprecision(1) << 100. * stats.efficiency() << "% of the time" << std::endl;
+}
 
-  const hittable_list world = randomWorld::generate_random_scene();
+// prints the counters of the paths (--counters) and writes the tiles of the threads as Chrome trace JSON (--trace)
+static void write_profile(const threadPool& pool, const trace_counters* counters, const std::string& trace_file) {
+  if (counters) traceStats::print(std::cout, *counters);
+  if (!trace_file.empty()) {
+    std::ofstream file(trace_file);
+    pool.write_trace(file);
+    if (!file) std::cerr << "can't write " << trace_file << std::endl;
+  }
+}
 
-  const point3 lookfrom(13., 2., 3.);
-  const point3 lookat(0, 0, 0);
-  const vec3 vup(0, 1, 0);
-  constexpr double dist_to_focus = 10.0;
-  constexpr double aperture = 0.1;
+// The frames are rendered by worker processes, each started as "raytracing --worker" with the protocol on stdin and
+// stdout. The frames are written as they are finished.
+static int distributed(const scene& world_scene, const std::vector<frame_job>& frames,
+                       const distributed_settings& settings, image_type type) {
+  distributedRender renderer(world_scene, settings);
+  imageWriter writer;
+  stopWatch stop_watch;
+  stop_watch.start();
+  size_t finished = 0;
 
-  raytrace raytracer(world, image_width, image_height, samples_per_pixel, max_depth);
+  renderer.render(frames, [&](ImageWrapper image, const frame_job&) {
+    image.set_type(type);
+    writer.push(std::move(image));
+    finished++;
+    double elapsed = stop_watch.stop();
+    double finished_in = elapsed / finished * (frames.size() - finished);
+    std::cout << "Finished " << finished << " of " << frames.size() << " with " << settings.workers
+              << " workers, sequence will be finished in " << std::fixed << std::setprecision(1) << finished_in
+              << "s\r" << std::flush;
+  });
 
-  constexpr double rotation_angle_delta = 0.01;
+  writer.finish();
+  std::cout << std::endl;
+  log_workers(renderer.stats());
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_passes = 0;
+  size_t preview_interval = 0;
+  std::string checkpoint;
+  bool resume = false;
+  image_type type = default_image_type;
+  std::string scene_file;
+  std::string save_scene_file;
+  bool temporal = false;
+  distributed_settings distribution;
+  distribution.workers = 0;
+  bool worker = false;
+  bool print_counters = false;
+  std::optional<uint32_t> roulette_depth;
+  std::string trace_file;
+  // samples per pixel of the denoised frames
+  std::optional<size_t> denoise_samples;
+  sampler_type sampler = sampler_type::independent;
+  adaptive_settings adaptive;
+  std::optional<uint32_t> max_samples;
+  for (int arg = 1; arg < argc; arg++) {
+    if (!std::strcmp(argv[arg], "--progressive") && arg + 1 < argc) {
+      num_passes = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--preview-interval") && arg + 1 < argc) {
+      preview_interval = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--checkpoint") && arg + 1 < argc) {
+      checkpoint = argv[++arg];
+    } else if (!std::strcmp(argv[arg], "--resume")) {
+      resume = true;
+    } else if (!std::strcmp(argv[arg], "--scene") && arg + 1 < argc) {
+      scene_file = argv[++arg];
+    } else if (!std::strcmp(argv[arg], "--save-scene") && arg + 1 < argc) {
+      save_scene_file = argv[++arg];
+    } else if (!std::strcmp(argv[arg], "--temporal")) {
+      temporal = true;
+    } else if (!std::strcmp(argv[arg], "--workers") && arg + 1 < argc) {
+      distribution.workers = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--tile-size") && arg + 1 < argc) {
+      distribution.tile_size = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--fail-worker-after") && arg + 1 < argc) {
+      distribution.fail_after = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--roulette-depth") && arg + 1 < argc) {
+      roulette_depth = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--denoise") && arg + 1 < argc) {
+      denoise_samples = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--sampler") && arg + 1 < argc) {
+      sampler = lowDiscrepancy::parse_type(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--adaptive") && arg + 1 < argc) {
+      adaptive.enabled = true;
+      adaptive.noise_threshold = std::stod(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--max-samples") && arg + 1 < argc) {
+      max_samples = std::stoul(argv[++arg]);
+    } else if (!std::strcmp(argv[arg], "--counters")) {
+      print_counters = true;
+    } else if (!std::strcmp(argv[arg], "--trace") && arg + 1 < argc) {
+      trace_file = argv[++arg];
+    } else if (!std::strcmp(argv[arg], "--worker")) {
+      worker = true;
+    } else if (!std::strcmp(argv[arg], "--format") && arg + 1 < argc) {
+      type = imageEncoder::parse_type(argv[++arg]);
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--scene file] [--save-scene file] [--format png|p3|p6|pfm|hdr]"
+                << " [--temporal] [--progressive passes [--preview-interval n] [--checkpoint file [--resume]]]"
+                << " [--workers n [--tile-size pixels] [--fail-worker-after jobs]] [--roulette-depth rays]"
+                << " [--denoise samples] [--sampler independent|sobol|halton|blue-noise]"
+                << " [--adaptive threshold [--max-samples n]] [--counters] [--trace file]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // the scene comes from the coordinator
+  if (worker) return distributedRender::worker_main(STDIN_FILENO, STDOUT_FILENO);
+
+  if (max_samples && !adaptive.enabled) {
+    std::cerr << "--max-samples needs --adaptive" << std::endl;
+    return 1;
+  }
+  if (max_samples) adaptive.max_samples = *max_samples;
+  // the workers render tiles and the temporal reuse its own sample counts, both with fixed samples per pixel
+  if (adaptive.enabled && (distribution.workers > 0 || temporal)) {
+    std::cerr << "--adaptive can't be combined with --workers or --temporal" << std::endl;
+    return 1;
+  }
+
+  // without a scene file the random scene with the default settings is rendered
+  scene world_scene;
+  if (!scene_file.empty()) {
+    sceneLoader::load_stats stats;
+    world_scene = sceneLoader::load(scene_file, true, &stats);
+    std::cout << "Loaded " << scene_file << (stats.from_cache ? " from the cache" : "") << " in " << std::fixed
+              << std::setprecision(3) << stats.load_time << "s, " << world_scene.world->objects.size() << " objects, "
+              << world_scene.materials->size() << " materials" << std::endl;
+  } else {
+    *world_scene.world = randomWorld::generate_random_scene(*world_scene.materials);
+  }
+  if (!save_scene_file.empty()) {
+    sceneLoader::save_text(world_scene, save_scene_file);
+    return 0;
+  }
+
+  constexpr real rotation_angle_delta = 0.01;
 #ifdef USE_EIGEN
   size_t num_rotation_steps = size_t(M_PI / rotation_angle_delta);
 #else
   size_t num_rotation_steps = 1;
 #endif
+  const auto orbit_lookfrom = [&](size_t image_number) {
+    Eigen::AngleAxis<real> rotation(image_number * rotation_angle_delta, vec3(0, 1., 0));
+    const camera_settings& view = world_scene.view;
+    return point3(view.lookat + rotation * (view.lookfrom - view.lookat));
+  };
+
+  if (distribution.workers > 0) {
+    // The workers render tiles of the plain frame sequence. The denoiser needs the guide buffers of the whole frame,
+    // the other modes the raytracer, its counters or its threads in this process.
+    const std::pair<bool, const char*> unsupported[] = {
+        {denoise_samples.has_value(), "--denoise"}, {temporal, "--temporal"},
+        {num_passes > 0, "--progressive"},          {preview_interval > 0, "--preview-interval"},
+        {!checkpoint.empty(), "--checkpoint"},      {resume, "--resume"},
+        {print_counters, "--counters"},             {!trace_file.empty(), "--trace"}};
+    for (const auto& [given, flag] : unsupported) {
+      if (given) {
+        std::cerr << flag << " can't be combined with --workers" << std::endl;
+        return 1;
+      }
+    }
+    distribution.worker_command = {"/proc/self/exe", "--worker"};
+    distribution.roulette_depth = roulette_depth;
+    distribution.sampler = sampler;
+    std::vector<frame_job> frames;
+    for (size_t image_number = 0; image_number < num_rotation_steps; image_number++) {
+      const std::string filename = "raytrace" + std::to_string(image_number);
+      frames.push_back(frame_job{image_number, orbit_lookfrom(image_number), filename});
+    }
+    return distributed(world_scene, frames, distribution, type);
+  }
+
+  // the denoiser filters the frames of calcImage, the temporal and progressive images are accumulated elsewhere
+  if (denoise_samples && (temporal || num_passes > 0)) {
+    std::cerr << "--denoise can't be combined with --temporal or --progressive" << std::endl;
+    return 1;
+  }
+
+  const render_settings& settings = world_scene.settings;
+  const std::shared_ptr<hittable> world = std::make_shared<bvh>(*world_scene.world);
+
+  raytrace raytracer(world, world_scene.materials, settings.image_width, settings.image_height,
+                     denoise_samples.value_or(settings.samples_per_pixel), settings.max_depth);
+  raytracer.set_background(world_scene.background);
+  raytracer.set_sampler(sampler);
+  raytracer.set_adaptive(adaptive);
+  if (roulette_depth) raytracer.set_roulette_depth(*roulette_depth);
+  if (denoise_samples) raytracer.set_denoiser(denoise_settings());
+
+  if (!trace_file.empty()) raytracer.thread_pool().set_trace(true);
+
+  if (num_passes > 0) {
+    if (resume && checkpoint.empty()) {
+      std::cerr << "--resume needs a --checkpoint file" << std::endl;
+      return 1;
+    }
+    if (temporal) {
+      std::cerr << "--temporal can't be combined with --progressive" << std::endl;
+      return 1;
+    }
+    const int result =
+        progressive(raytracer, world_scene.make_camera(), num_passes, preview_interval, checkpoint, resume, type);
+    if (result == 0) {
+      const trace_counters counters = traceStats::collect();
+      write_profile(raytracer.thread_pool(), print_counters ? &counters : nullptr, trace_file);
+    }
+    return result;
+  }
+
+  // the images are encoded and written while the next frame renders
+  imageWriter writer;
+  // the camera moves only a little between the frames, so most diffuse pixels can reuse the previous frame
+  temporal_settings reuse_settings;
+  reuse_settings.fresh_samples = std::max<uint32_t>(1, settings.samples_per_pixel / 4);
+  reuse_settings.max_history = 4 * settings.samples_per_pixel;
+  temporalReuse reuse(raytracer, reuse_settings);
+  double render_time = 0.;
+  double wait_time = 0.;
+  double denoise_time = 0.;
+  // the counters of the threads are merged at the end of every frame
+  trace_counters counters;
 
   for (size_t image_number = 0; image_number < num_rotation_steps; image_number++) {
     stopWatch stop_watch;
 
     stop_watch.start();
 
-    Eigen::AngleAxis<double> rotation(image_number * rotation_angle_delta, vec3(0, 1., 0));
-    // std::cout << rotation * lookfrom << std::endl;
-    camera cam(rotation * lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus);
+    camera cam = world_scene.make_camera(orbit_lookfrom(image_number));
     std::string image_filename = "raytrace" + std::to_string(image_number);
 
-    ImageWrapper image = raytracer.calcImage(cam, image_filename, false);
+    raytracer.set_frame(image_number);
+
+    if (temporal) reuse.render(cam);
+    ImageWrapper image = temporal ? reuse.image(image_filename) : raytracer.calcImage(cam, image_filename, false);
+    image.set_type(type);
+    render_time += stop_watch.stop();
+    if (raytracer.denoiser() && !temporal) denoise_time += raytracer.denoiser()->last_time();
+    if (print_counters) {
+      counters += traceStats::collect();
+      traceStats::reset();
+    }
 
-    image.write();
+    wait_time += writer.push(std::move(image));
 
     double delta_time = stop_watch.stop();
-    log(delta_time, image_number, num_rotation_steps);
+    const auto written = writer.stats();
+    log(delta_time, raytracer.thread_pool().utilization(), image_number, num_rotation_steps,
+        written.empty() ? nullptr : &written.back(), temporal ? &reuse.stats() : nullptr);
+  }
+
+  writer.finish();
+  std::cout << std::endl;
+  log_writer(writer.stats(), render_time, wait_time);
+  if (denoise_time > 0.) {
+    std::cout << "Denoised with " << raytracer.samples_per_pixel() << " samples per pixel, the filter took "
+              << std::setprecision(4) << denoise_time / num_rotation_steps << "s per frame" << std::endl;
   }
+  write_profile(raytracer.thread_pool(), print_counters ? &counters : nullptr, trace_file);
 
-  std::cout << "\nDone.\nYou can make a video with ffmpeg -r 60 -i raytrace%d.png -vcodec libx264 -crf 15 -pix_fmt "
-               "yuv420p raytrace.mp4 if you like."
-            << std::endl;
+  std::cout << "Done.\nYou can make a video with ffmpeg -r 60 -i raytrace%d" << imageEncoder::extension(type)
+            << " -vcodec libx264 -crf 15 -pix_fmt yuv420p raytrace.mp4 if you like." << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+mapped_file::mapped_file(const std::string& filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("can't open " + filename);
+
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw std::runtime_error("can't stat " + filename);
+  }
+  size_ = status.st_size;
+
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (data_ == MAP_FAILED) throw std::runtime_error("can't map " + filename);
+}
+
+mapped_file::~mapped_file() {
+  if (data_ && data_ != MAP_FAILED) ::munmap(data_, size_);
+}
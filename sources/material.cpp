@@ -1,7 +1,7 @@
 #include "material.h"
 
-double schlick(double cosine, double ref_idx) {
-  double r0 = (1 - ref_idx) / (1 + ref_idx);
+real schlick(real cosine, real ref_idx) {
+  real r0 = (1 - ref_idx) / (1 + ref_idx);
   r0 = r0 * r0;
-  return r0 + (1 - r0) * pow((1 - cosine), 5);
+  return r0 + (1 - r0) * std::pow((1 - cosine), 5);
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+int open_counter(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // glibc has no wrapper for perf_event_open
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+constexpr uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+}  // namespace
+
+perfCounters::perfCounters() {
+  fds_[instructions] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fds_[l1d_misses] = open_counter(
+      PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+  fds_[llc_misses] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+}
+
+perfCounters::~perfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+void perfCounters::start() {
+  for (int fd : fds_) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+perfCounters::values perfCounters::stop() {
+  values result{};
+  for (size_t e = 0; e < event_count; e++) {
+    if (fds_[e] < 0) continue;
+    ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fds_[e], &count, sizeof(count)) == sizeof(count)) result[e] = count;
+  }
+  return result;
+}
+#else
+perfCounters::perfCounters() { fds_.fill(-1); }
+perfCounters::~perfCounters() {}
+void perfCounters::start() {}
+perfCounters::values perfCounters::stop() { return values{}; }
+#endif
+
+bool perfCounters::any_available() const {
+  for (size_t e = 0; e < event_count; e++) {
+    if (available(static_cast<event>(e))) return true;
+  }
+  return false;
+}
+
+const char* perfCounters::name(event e) {
+  switch (e) {
+    case instructions:
+      return "instructions";
+    case l1d_misses:
+      return "L1D misses";
+    case llc_misses:
+      return "LLC misses";
+    default:
+      return "?";
+  }
+}
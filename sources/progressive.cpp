@@ -0,0 +1,104 @@
+#include "progressive.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+const char checkpoint_magic[4] = {'R', 'T', 'C', 'K'};
+constexpr uint32_t checkpoint_version = 1;
+
+struct checkpoint_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint64_t passes;
+  uint64_t samples;
+  uint64_t seed;
+};
+}  // namespace
+
+progressiveRender::progressiveRender(raytrace& raytracer, uint64_t seed)
+    : raytracer_(raytracer),
+      seed_(seed),
+      accumulation_(3 * raytracer.image_width() * raytracer.image_height(), 0.f) {}
+
+void progressiveRender::add_pass(const camera& cam) {
+  raytracer_.set_frame(hash_combine(seed_, passes_));
+  raytracer_.render(cam);
+
+  const auto& estimates = raytracer_.pixel_estimates();
+  for (size_t index = 0; index < estimates.size(); index++) {
+    for (int c = 0; c < 3; c++) {
+      accumulation_[3 * index + c] += static_cast<float>(estimates[index].sum[c]);
+    }
+  }
+
+  passes_++;
+  samples_ += raytracer_.samples_per_pixel();
+}
+
+ImageWrapper progressiveRender::image(const std::string& filename, image_type type) const {
+  const size_t width = raytracer_.image_width();
+  const size_t height = raytracer_.image_height();
+  ImageWrapper image(filename, width, height, type);
+
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      const size_t index = 3 * (j * width + i);
+      color pixel_color(accumulation_[index], accumulation_[index + 1], accumulation_[index + 2]);
+      image.write_color(i, j, pixel_color, std::max<size_t>(1, samples_));
+    }
+  }
+
+  return image;
+}
+
+void progressiveRender::save_checkpoint(const std::string& filename) const {
+  checkpoint_header header;
+  std::copy(checkpoint_magic, checkpoint_magic + 4, header.magic);
+  header.version = checkpoint_version;
+  header.width = raytracer_.image_width();
+  header.height = raytracer_.image_height();
+  header.passes = passes_;
+  header.samples = samples_;
+  header.seed = seed_;
+
+  // write to a temporary file and rename it, so a job killed while writing keeps the last checkpoint
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(accumulation_.data()), accumulation_.size() * sizeof(float));
+    if (!file) throw std::runtime_error("can't write checkpoint " + temporary);
+  }
+
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    throw std::runtime_error("can't rename checkpoint to " + filename);
+  }
+}
+
+void progressiveRender::load_checkpoint(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) throw std::runtime_error("can't open checkpoint " + filename);
+
+  checkpoint_header header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || !std::equal(checkpoint_magic, checkpoint_magic + 4, header.magic) ||
+      header.version != checkpoint_version) {
+    throw std::runtime_error(filename + " is no checkpoint");
+  }
+  if (header.width != raytracer_.image_width() || header.height != raytracer_.image_height()) {
+    throw std::runtime_error("checkpoint " + filename + " has a different image size");
+  }
+
+  std::vector<float> accumulation(accumulation_.size());
+  file.read(reinterpret_cast<char*>(accumulation.data()), accumulation.size() * sizeof(float));
+  if (!file) throw std::runtime_error("checkpoint " + filename + " is truncated");
+
+  accumulation_ = std::move(accumulation);
+  passes_ = header.passes;
+  samples_ = header.samples;
+  seed_ = header.seed;
+}
@@ -1,34 +1,42 @@
 #include "random_world.h"
 
 #include "material.h"
+#include "object_arena.h"
 #include "sphere.h"
 
-hittable_list randomWorld::generate_random_scene() {
+hittable_list randomWorld::generate_random_scene(material_table& materials, int grid_extent) {
   hittable_list world;
 
-  world.add(std::make_shared<sphere>(point3(0, -1000, 0), 1000, std::make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+  // all spheres in one block
+  const size_t max_spheres = 4 + 4 * static_cast<size_t>(grid_extent) * grid_extent;
+  auto arena = objectArena::create();
+  arena->reserve<sphere>(max_spheres);
+  world.objects.reserve(max_spheres);
+  materials.reserve(materials.size() + max_spheres);
 
-  world.add(std::make_shared<sphere>(point3(0, 1, 0), 1.0, std::make_shared<dielectric>(1.5)));
-  world.add(std::make_shared<sphere>(point3(-4, 1, 0), 1.0, std::make_shared<lambertian>(color(.4, .2, .1))));
-  world.add(std::make_shared<sphere>(point3(4, 1, 0), 1.0, std::make_shared<metal>(color(.7, .6, .5), 0.0)));
+  world.add(arena->make<sphere>(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.5, 0.5, 0.5)))));
 
-  for (int a = -11; a < 11; a++) {
-    for (int b = -11; b < 11; b++) {
+  world.add(arena->make<sphere>(point3(0, 1, 0), 1.0, materials.add(dielectric(1.5))));
+  world.add(arena->make<sphere>(point3(-4, 1, 0), 1.0, materials.add(lambertian(color(.4, .2, .1)))));
+  world.add(arena->make<sphere>(point3(4, 1, 0), 1.0, materials.add(metal(color(.7, .6, .5), 0.0))));
+
+  for (int a = -grid_extent; a < grid_extent; a++) {
+    for (int b = -grid_extent; b < grid_extent; b++) {
       double choose_mat = random_double();
       point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
       if ((center - vec3(4, 0.2, 0)).norm() > 0.9) {
         if (choose_mat < 0.8) {
           // diffuse
           vec3 albedo = random_vec3().cwiseProduct(random_vec3());
-          world.add(std::make_shared<sphere>(center, 0.2, std::make_shared<lambertian>(albedo)));
+          world.add(arena->make<sphere>(center, 0.2, materials.add(lambertian(albedo))));
         } else if (choose_mat < 0.95) {
           // metal
           vec3 albedo = random_vec3(.5, 1);
           double fuzz = random_double(0, .5);
-          world.add(std::make_shared<sphere>(center, 0.2, std::make_shared<metal>(albedo, fuzz)));
+          world.add(arena->make<sphere>(center, 0.2, materials.add(metal(albedo, fuzz))));
         } else {
           // glass
-          world.add(std::make_shared<sphere>(center, 0.2, std::make_shared<dielectric>(1.5)));
+          world.add(arena->make<sphere>(center, 0.2, materials.add(dielectric(1.5))));
         }
       }
     }
@@ -0,0 +1,129 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// bases of the Halton dimensions
+constexpr uint32_t primes[lowDiscrepancy::num_halton_dimensions] = {
+    2,   3,   5,   7,   11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,  59,  61,  67,  71,  73,  79,
+    83,  89,  97,  101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193,
+    197, 199, 211, 223, 227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+
+// width of the gaussian of the void and cluster energy in pixels
+constexpr double blue_noise_sigma = 1.5;
+}  // namespace
+
+sampler_type lowDiscrepancy::parse_type(const std::string& name) {
+  if (name == "independent") return sampler_type::independent;
+  if (name == "sobol") return sampler_type::sobol;
+  if (name == "halton") return sampler_type::halton;
+  if (name == "blue-noise") return sampler_type::blue_noise;
+
+  throw std::invalid_argument("unknown sampler " + name);
+}
+
+std::string lowDiscrepancy::type_name(sampler_type type) {
+  switch (type) {
+    case sampler_type::independent:
+      return "independent";
+    case sampler_type::sobol:
+      return "sobol";
+    case sampler_type::halton:
+      return "halton";
+    case sampler_type::blue_noise:
+      return "blue-noise";
+  }
+  return "unknown";
+}
+
+const uint32_t* lowDiscrepancy::sobol_byte_table() {
+  static const std::vector<uint32_t> table = [] {
+    // direction numbers of dimension 1: v_0 = 1/2, v_k+1 = v_k ^ (v_k / 2), bit k of the index adds v_k
+    uint32_t directions[32];
+    for (uint32_t bit = 0, v = 1u << 31; bit < 32; bit++, v ^= v >> 1) directions[bit] = v;
+
+    // bit b of the reversed index is bit 31 - b of the index
+    std::vector<uint32_t> entries(4 * 256, 0);
+    for (uint32_t byte = 0; byte < 4; byte++) {
+      for (uint32_t value = 0; value < 256; value++) {
+        for (uint32_t bit = 0; bit < 8; bit++) {
+          if (value & (1u << bit)) entries[byte * 256 + value] ^= reverse_bits(directions[31 - (byte * 8 + bit)]);
+        }
+      }
+    }
+    return entries;
+  }();
+  return table.data();
+}
+
+uint32_t lowDiscrepancy::halton(uint32_t index, uint32_t dimension, uint64_t seed, uint32_t tail_bits) {
+  const uint32_t base = primes[dimension];
+  // base 2 has a_k = 1, the scrambling flips random digits
+  if (base == 2) return reverse_bits(index) ^ static_cast<uint32_t>(seed);
+
+  double value = 0;
+  // width of the stratum of the digits so far
+  double width = 1;
+  uint32_t state = static_cast<uint32_t>(seed);
+  for (uint32_t reach = 1; reach < (1u << 16); reach *= base) {
+    // a_k and c_k from the high and low half of a 32 bit hash (lowbias32) of the seed and the digit number
+    uint32_t random = state += 0x9e3779b9u;
+    random = (random ^ (random >> 16)) * 0x7feb352du;
+    random = (random ^ (random >> 15)) * 0x846ca68bu;
+    random ^= random >> 16;
+    const uint32_t a = 1 + (((random >> 16) * (base - 1)) >> 16);
+    const uint32_t c = ((random & 0xffffu) * base) >> 16;
+    const uint32_t digit = index % base;
+    index /= base;
+    width /= base;
+    value += ((a * digit + c) % base) * width;
+  }
+  value += width * tail_bits * 0x1p-32;
+  return static_cast<uint32_t>(std::min(value * 0x1p32, 4294967295.));
+}
+
+// Void and cluster: the pixels are ranked by inserting them one by one into the largest void, the free pixel with the
+// lowest energy, where every inserted pixel adds a gaussian around itself on the torus. The largest void of the
+// inserted pixels is the tightest cluster of the free ones, so this one loop gives the ranks of all phases.
+const uint16_t* lowDiscrepancy::blue_noise_mask() {
+  static const std::vector<uint16_t> mask = [] {
+    constexpr uint32_t size = blue_noise_size;
+    constexpr uint32_t num_pixels = size * size;
+
+    std::vector<double> kernel(num_pixels);
+    for (uint32_t dy = 0; dy < size; dy++) {
+      for (uint32_t dx = 0; dx < size; dx++) {
+        const double x = std::min(dx, size - dx);
+        const double y = std::min(dy, size - dy);
+        kernel[dy * size + dx] = std::exp(-(x * x + y * y) / (2 * blue_noise_sigma * blue_noise_sigma));
+      }
+    }
+
+    // the tiny random energies break the ties of the empty mask
+    std::vector<double> energy(num_pixels);
+    for (uint32_t p = 0; p < num_pixels; p++) energy[p] = 1e-6 * counterRng::to_uniform<double>(hash_combine(0, p));
+
+    std::vector<uint16_t> ranks(num_pixels);
+    std::vector<bool> inserted(num_pixels, false);
+    for (uint32_t rank = 0; rank < num_pixels; rank++) {
+      uint32_t best = num_pixels;
+      for (uint32_t p = 0; p < num_pixels; p++) {
+        if (!inserted[p] && (best == num_pixels || energy[p] < energy[best])) best = p;
+      }
+      inserted[best] = true;
+      ranks[best] = static_cast<uint16_t>(rank);
+
+      const uint32_t bx = best % size;
+      const uint32_t by = best / size;
+      for (uint32_t y = 0; y < size; y++) {
+        const double* row = kernel.data() + ((y + size - by) % size) * size;
+        for (uint32_t x = 0; x < size; x++) energy[y * size + x] += row[(x + size - bx) % size];
+      }
+    }
+    return ranks;
+  }();
+  return mask.data();
+}
@@ -0,0 +1,442 @@
+#include "scene.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "instance.h"
+#include "mapped_file.h"
+#include "object_arena.h"
+#include "sphere.h"
+#include "stop_watch.h"
+#include "triangle_mesh.h"
+
+namespace {
+const char cache_magic[4] = {'R', 'T', 'S', 'B'};
+constexpr uint32_t cache_version = 2;
+
+struct cache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t image_width;
+  uint32_t image_height;
+  uint32_t samples_per_pixel;
+  uint32_t max_depth;
+  double lookfrom[3];
+  double lookat[3];
+  double vup[3];
+  double vfov;
+  double aperture;
+  double focus_dist;
+  uint32_t has_background;
+  uint32_t padding;
+  double background[3];
+  uint64_t num_materials;
+  uint64_t num_spheres;
+};
+
+// lambertian: albedo, metal: albedo and fuzz, dielectric: refraction index, light: emitted radiance
+struct cache_material {
+  uint32_t type;
+  uint32_t padding;
+  double values[4];
+};
+
+struct cache_sphere {
+  double center[3];
+  double radius;
+  uint32_t material;
+  uint32_t padding;
+};
+
+std::vector<const sphere*> spheres_of(const scene& s) {
+  std::vector<const sphere*> spheres;
+  spheres.reserve(s.world->objects.size());
+  for (const auto& object : s.world->objects) {
+    const sphere* sp = dynamic_cast<const sphere*>(object.get());
+    if (!sp) throw std::runtime_error("only spheres can be saved in a scene cache");
+    spheres.push_back(sp);
+  }
+  return spheres;
+}
+
+class parse_error : public std::runtime_error {
+ public:
+  parse_error(const std::string& filename, size_t line, const std::string& message)
+      : std::runtime_error(filename + ":" + std::to_string(line) + ": " + message) {}
+};
+}  // namespace
+
+scene sceneLoader::load(const std::string& filename, bool use_cache, load_stats* stats) {
+  namespace fs = std::filesystem;
+
+  stopWatch stop_watch;
+  stop_watch.start();
+
+  const std::string cache = cache_filename(filename);
+  std::error_code error;
+  const bool cache_valid = use_cache && fs::exists(cache, error) &&
+                           fs::last_write_time(cache, error) >= fs::last_write_time(filename, error) && !error;
+
+  scene s = cache_valid ? load_binary(cache) : load_text(filename);
+  if (use_cache && !cache_valid) {
+    // the cache only speeds up the next load, a scene in a read only directory is fine
+    try {
+      save_binary(s, cache);
+    } catch (const std::runtime_error&) {
+    }
+  }
+
+  if (stats) {
+    stats->load_time = stop_watch.stop();
+    stats->from_cache = cache_valid;
+  }
+  return s;
+}
+
+scene sceneLoader::load_text(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file) throw std::runtime_error("can't open " + filename);
+
+  return read_text(file, filename);
+}
+
+scene sceneLoader::read_text(std::istream& file, const std::string& filename) {
+  scene s;
+  std::unordered_map<std::string, uint32_t> material_names;
+  // every mesh file is loaded once, further meshes of the same file are instances of it
+  std::unordered_map<std::string, std::shared_ptr<triangle_mesh>> meshes;
+  auto arena = objectArena::create();
+
+  std::string line;
+  for (size_t line_number = 1; std::getline(file, line); line_number++) {
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+
+    std::istringstream stream(line);
+    std::string keyword;
+    if (!(stream >> keyword)) continue;
+
+    const auto fail = [&](const std::string& message) { throw parse_error(filename, line_number, message); };
+    const auto read_vec = [&]() {
+      double x, y, z;
+      if (!(stream >> x >> y >> z)) fail("expected three numbers after " + keyword);
+      return vec3(x, y, z);
+    };
+
+    if (keyword == "image") {
+      if (!(stream >> s.settings.image_width >> s.settings.image_height) || s.settings.image_width < 2 ||
+          s.settings.image_height < 2) {
+        fail("expected image <width> <height>");
+      }
+    } else if (keyword == "samples") {
+      if (!(stream >> s.settings.samples_per_pixel) || s.settings.samples_per_pixel == 0) {
+        fail("expected samples <samples per pixel>");
+      }
+    } else if (keyword == "depth") {
+      if (!(stream >> s.settings.max_depth) || s.settings.max_depth == 0 || s.settings.max_depth > 255) {
+        fail("expected depth <1..255>");
+      }
+    } else if (keyword == "camera") {
+      std::string key;
+      while (stream >> key) {
+        double value;
+        if (key == "lookfrom") {
+          s.view.lookfrom = read_vec();
+        } else if (key == "lookat") {
+          s.view.lookat = read_vec();
+        } else if (key == "vup") {
+          s.view.vup = read_vec();
+        } else if ((key == "vfov" || key == "aperture" || key == "focus_dist") && (stream >> value)) {
+          (key == "vfov" ? s.view.vfov : key == "aperture" ? s.view.aperture : s.view.focus_dist) = value;
+        } else {
+          fail("unknown or incomplete camera setting " + key);
+        }
+      }
+    } else if (keyword == "material") {
+      std::string name, type;
+      if (!(stream >> name >> type)) fail("expected material <name> <type> ...");
+      if (material_names.count(name)) fail("material " + name + " defined twice");
+
+      if (type == "lambertian") {
+        material_names[name] = s.materials->add(lambertian(read_vec()));
+      } else if (type == "metal") {
+        vec3 albedo = read_vec();
+        double fuzz;
+        if (!(stream >> fuzz)) fail("expected material <name> metal <r g b> <fuzz>");
+        material_names[name] = s.materials->add(metal(albedo, fuzz));
+      } else if (type == "dielectric") {
+        double ref_idx;
+        if (!(stream >> ref_idx)) fail("expected material <name> dielectric <refraction index>");
+        material_names[name] = s.materials->add(dielectric(ref_idx));
+      } else if (type == "light") {
+        material_names[name] = s.materials->add(diffuse_light(read_vec()));
+      } else {
+        fail("unknown material type " + type);
+      }
+    } else if (keyword == "sphere") {
+      point3 center = read_vec();
+      double radius;
+      std::string name;
+      if (!(stream >> radius >> name)) fail("expected sphere <x y z> <radius> <material name>");
+      auto mat = material_names.find(name);
+      if (mat == material_names.end()) fail("unknown material " + name);
+      s.world->add(arena->make<sphere>(center, radius, mat->second));
+    } else if (keyword == "mesh") {
+      std::string mesh_file, name;
+      if (!(stream >> mesh_file >> name)) fail("expected mesh <file> <material name> [transforms]");
+      auto mat = material_names.find(name);
+      if (mat == material_names.end()) fail("unknown material " + name);
+
+      bool transformed = false;
+      affine_transform object_to_world;
+      std::string key;
+      while (stream >> key) {
+        double value;
+        if (key == "scale" && (stream >> value)) {
+          object_to_world = affine_transform::scaling(vec3(value, value, value)) * object_to_world;
+        } else if (key == "rotate") {
+          const vec3 axis = read_vec();
+          if (!(stream >> value) || axis.squaredNorm() == 0) fail("expected rotate <axis x y z> <degrees>");
+          object_to_world = affine_transform::rotation(axis, value) * object_to_world;
+        } else if (key == "translate") {
+          object_to_world = affine_transform::translation(read_vec()) * object_to_world;
+        } else if (key == "matrix") {
+          affine_transform matrix;
+          for (auto& row : matrix.m) {
+            for (real& element : row) {
+              if (!(stream >> value)) fail("expected matrix <12 numbers, row by row>");
+              element = value;
+            }
+          }
+          object_to_world = matrix * object_to_world;
+        } else {
+          fail("unknown or incomplete mesh transform " + key);
+        }
+        transformed = true;
+      }
+
+      // relative to the directory of the scene file
+      std::filesystem::path path(mesh_file);
+      if (path.is_relative()) path = std::filesystem::path(filename).parent_path() / path;
+      auto& mesh = meshes[path.string()];
+      const bool first = !mesh;
+      if (first) mesh = meshLoader::load(path.string(), mat->second);
+      if (first && !transformed) {
+        s.world->add(mesh);
+      } else {
+        try {
+          s.world->add(std::make_shared<instance>(mesh, object_to_world, mat->second));
+        } catch (const std::invalid_argument&) {
+          fail("the transform of the mesh can't be inverted");
+        }
+      }
+    } else if (keyword == "background") {
+      s.background = read_vec();
+    } else {
+      fail("unknown keyword " + keyword);
+    }
+
+    std::string rest;
+    if (stream >> rest) fail("unexpected " + rest);
+  }
+
+  return s;
+}
+
+void sceneLoader::save_text(const scene& s, const std::string& filename) {
+  std::ofstream file(filename);
+  write_text(s, file);
+  if (!file) throw std::runtime_error("can't write " + filename);
+}
+
+void sceneLoader::write_text(const scene& s, std::ostream& file) {
+  file.precision(std::numeric_limits<real>::max_digits10);
+
+  const auto write_vec = [&](const vec3& v) { file << v[0] << " " << v[1] << " " << v[2]; };
+
+  file << "image " << s.settings.image_width << " " << s.settings.image_height << "\n";
+  file << "samples " << s.settings.samples_per_pixel << "\n";
+  file << "depth " << s.settings.max_depth << "\n";
+  file << "camera lookfrom ";
+  write_vec(s.view.lookfrom);
+  file << " lookat ";
+  write_vec(s.view.lookat);
+  file << " vup ";
+  write_vec(s.view.vup);
+  file << " vfov " << s.view.vfov << " aperture " << s.view.aperture << " focus_dist " << s.view.focus_dist << "\n";
+  if (s.background) {
+    file << "background ";
+    write_vec(*s.background);
+    file << "\n";
+  }
+
+  for (uint32_t index = 0; index < s.materials->size(); index++) {
+    const material& mat = (*s.materials)[index];
+    file << "material m" << index;
+    if (const auto* m = std::get_if<lambertian>(&mat)) {
+      file << " lambertian ";
+      write_vec(m->albedo);
+    } else if (const auto* m = std::get_if<metal>(&mat)) {
+      file << " metal ";
+      write_vec(m->albedo);
+      file << " " << m->fuzz;
+    } else if (const auto* m = std::get_if<dielectric>(&mat)) {
+      file << " dielectric " << m->ref_idx;
+    } else if (const auto* m = std::get_if<diffuse_light>(&mat)) {
+      file << " light ";
+      write_vec(m->emit);
+    }
+    file << "\n";
+  }
+
+  for (const auto& object : s.world->objects) {
+    if (const auto* sp = dynamic_cast<const sphere*>(object.get())) {
+      file << "sphere ";
+      write_vec(sp->center);
+      file << " " << sp->radius << " m" << sp->mat_index << "\n";
+    } else if (const auto* mesh = dynamic_cast<const triangle_mesh*>(object.get())) {
+      if (mesh->source().empty()) throw std::runtime_error("only meshes loaded from a file can be saved in a scene");
+      file << "mesh " << mesh->source() << " m" << mesh->mat_index() << "\n";
+    } else if (const auto* inst = dynamic_cast<const instance*>(object.get())) {
+      const auto* mesh = dynamic_cast<const triangle_mesh*>(inst->geometry().get());
+      if (!mesh || mesh->source().empty()) throw std::runtime_error("only instances of mesh files can be saved");
+      const uint32_t mat_index = inst->mat_index() != instance::keep_material ? inst->mat_index() : mesh->mat_index();
+      file << "mesh " << mesh->source() << " m" << mat_index << " matrix";
+      for (const auto& row : inst->object_to_world().m) {
+        for (real element : row) file << " " << element;
+      }
+      file << "\n";
+    } else {
+      throw std::runtime_error("only spheres and meshes can be saved in a scene file");
+    }
+  }
+}
+
+scene sceneLoader::load_binary(const std::string& filename) {
+  mapped_file mapping(filename);
+
+  cache_header header;
+  if (mapping.size() < sizeof(header)) throw std::runtime_error(filename + " is no scene cache");
+  std::memcpy(&header, mapping.data(), sizeof(header));
+  if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version) {
+    throw std::runtime_error(filename + " is no scene cache");
+  }
+  if (mapping.size() != sizeof(header) + header.num_materials * sizeof(cache_material) +
+                            header.num_spheres * sizeof(cache_sphere)) {
+    throw std::runtime_error("scene cache " + filename + " has the wrong size");
+  }
+
+  scene s;
+  s.settings.image_width = header.image_width;
+  s.settings.image_height = header.image_height;
+  s.settings.samples_per_pixel = header.samples_per_pixel;
+  s.settings.max_depth = header.max_depth;
+  s.view.lookfrom = point3(header.lookfrom[0], header.lookfrom[1], header.lookfrom[2]);
+  s.view.lookat = point3(header.lookat[0], header.lookat[1], header.lookat[2]);
+  s.view.vup = vec3(header.vup[0], header.vup[1], header.vup[2]);
+  s.view.vfov = header.vfov;
+  s.view.aperture = header.aperture;
+  s.view.focus_dist = header.focus_dist;
+  if (header.has_background) s.background = color(header.background[0], header.background[1], header.background[2]);
+
+  // the records follow the header with their natural alignment, mmap returns page aligned memory
+  const auto* materials = reinterpret_cast<const cache_material*>(mapping.data() + sizeof(header));
+  const auto* spheres = reinterpret_cast<const cache_sphere*>(materials + header.num_materials);
+
+  s.materials->reserve(header.num_materials);
+  for (uint64_t index = 0; index < header.num_materials; index++) {
+    const cache_material& m = materials[index];
+    const color albedo(m.values[0], m.values[1], m.values[2]);
+    switch (static_cast<material_type>(m.type)) {
+      case material_type::lambertian:
+        s.materials->add(lambertian(albedo));
+        break;
+      case material_type::metal:
+        s.materials->add(metal(albedo, m.values[3]));
+        break;
+      case material_type::dielectric:
+        s.materials->add(dielectric(m.values[0]));
+        break;
+      case material_type::light:
+        s.materials->add(diffuse_light(albedo));
+        break;
+      default:
+        throw std::runtime_error("scene cache " + filename + " has an unknown material type");
+    }
+  }
+
+  auto arena = objectArena::create();
+  arena->reserve<sphere>(header.num_spheres);
+  s.world->objects.reserve(header.num_spheres);
+  for (uint64_t index = 0; index < header.num_spheres; index++) {
+    const cache_sphere& sp = spheres[index];
+    if (sp.material >= header.num_materials) {
+      throw std::runtime_error("scene cache " + filename + " references an unknown material");
+    }
+    s.world->add(arena->make<sphere>(point3(sp.center[0], sp.center[1], sp.center[2]), sp.radius, sp.material));
+  }
+
+  return s;
+}
+
+void sceneLoader::save_binary(const scene& s, const std::string& filename) {
+  const std::vector<const sphere*> spheres = spheres_of(s);
+
+  cache_header header = {};
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.image_width = s.settings.image_width;
+  header.image_height = s.settings.image_height;
+  header.samples_per_pixel = s.settings.samples_per_pixel;
+  header.max_depth = s.settings.max_depth;
+  for (int a = 0; a < 3; a++) {
+    header.lookfrom[a] = s.view.lookfrom[a];
+    header.lookat[a] = s.view.lookat[a];
+    header.vup[a] = s.view.vup[a];
+  }
+  header.vfov = s.view.vfov;
+  header.aperture = s.view.aperture;
+  header.focus_dist = s.view.focus_dist;
+  if (s.background) {
+    header.has_background = 1;
+    for (int c = 0; c < 3; c++) header.background[c] = (*s.background)[c];
+  }
+  header.num_materials = s.materials->size();
+  header.num_spheres = spheres.size();
+
+  std::vector<cache_material> materials(header.num_materials);
+  for (uint32_t index = 0; index < s.materials->size(); index++) {
+    const material& mat = (*s.materials)[index];
+    cache_material& record = materials[index];
+    record.type = static_cast<uint32_t>(type_of(mat));
+    if (const auto* m = std::get_if<lambertian>(&mat)) {
+      for (int c = 0; c < 3; c++) record.values[c] = m->albedo[c];
+    } else if (const auto* m = std::get_if<metal>(&mat)) {
+      for (int c = 0; c < 3; c++) record.values[c] = m->albedo[c];
+      record.values[3] = m->fuzz;
+    } else if (const auto* m = std::get_if<dielectric>(&mat)) {
+      record.values[0] = m->ref_idx;
+    } else if (const auto* m = std::get_if<diffuse_light>(&mat)) {
+      for (int c = 0; c < 3; c++) record.values[c] = m->emit[c];
+    }
+  }
+
+  std::vector<cache_sphere> records(spheres.size());
+  for (size_t index = 0; index < spheres.size(); index++) {
+    for (int a = 0; a < 3; a++) records[index].center[a] = spheres[index]->center[a];
+    records[index].radius = spheres[index]->radius;
+    records[index].material = spheres[index]->mat_index;
+  }
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(materials.data()), materials.size() * sizeof(cache_material));
+  file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(cache_sphere));
+  if (!file) throw std::runtime_error("can't write " + filename);
+}
@@ -1,37 +1,49 @@
 #include "sphere.h"
 
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
+bool sphere::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+  // In float the distance to the center of the big ground sphere cancels out most of the digits,
+  // so the root is solved in precise_real.
+  using vec3p = vec3_t<precise_real>;
+
   bool ret = false;
-  vec3 oc = r.origin() - center;
-  double a = r.direction().squaredNorm();
-  double half_b = dot(oc, r.direction());
-  double c = oc.squaredNorm() - radius * radius;
-  double discriminant = half_b * half_b - a * c;
+  vec3p direction = r.direction().template cast<precise_real>();
+  vec3p oc = r.origin().template cast<precise_real>() - center.template cast<precise_real>();
+  precise_real a = direction.squaredNorm();
+  precise_real half_b = oc[0] * direction[0] + oc[1] * direction[1] + oc[2] * direction[2];
+  precise_real c = oc.squaredNorm() - precise_real(radius) * radius;
+  precise_real discriminant = half_b * half_b - a * c;
 
   if (discriminant > 0) {
-    double root = sqrt(discriminant);
+    precise_real root = std::sqrt(discriminant);
 
-    double temp = (-half_b - root) / a;
+    real temp = (-half_b - root) / a;
     if ((temp < t_max) && (temp > t_min)) {
       rec.t = temp;
       rec.p = r.at(rec.t);
       vec3 outward_normal = (rec.p - center) / radius;
       rec.set_face_normal(r, outward_normal);
-      rec.mat_ptr = mat_ptr;
+      rec.mat_index = mat_index;
 
       ret = true;
     } else {
-      double temp = (-half_b + root) / a;
+      real temp = (-half_b + root) / a;
       if ((temp < t_max) && (temp > t_min)) {
         rec.t = temp;
         rec.p = r.at(rec.t);
         vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mat_ptr;
+        rec.mat_index = mat_index;
 
         ret = true;
       }
     }
   }
   return ret;
-}
\ No newline at end of file
+}
+
+bool sphere::bounding_box(aabb& output_box) const {
+  vec3 extent(radius, radius, radius);
+  output_box = aabb(center - extent, center + extent);
+
+  return true;
+}
@@ -0,0 +1,34 @@
+#include "sphere_soa.h"
+
+#include <stdexcept>
+
+#include "sphere.h"
+
+sphere_soa::sphere_soa(const std::vector<std::shared_ptr<hittable>>& objects) {
+  center_x_.reserve(objects.size());
+  center_y_.reserve(objects.size());
+  center_z_.reserve(objects.size());
+  radius_.reserve(objects.size());
+  materials_.reserve(objects.size());
+
+  for (const auto& object : objects) {
+    auto s = std::dynamic_pointer_cast<sphere>(object);
+    if (!s) throw std::invalid_argument("sphere_soa: all objects have to be spheres");
+
+    center_x_.push_back(s->center[0]);
+    center_y_.push_back(s->center[1]);
+    center_z_.push_back(s->center[2]);
+    radius_.push_back(s->radius);
+    materials_.push_back(s->mat_index);
+  }
+}
+
+void sphere_soa::fill_hit_record(size_t index, const ray& r, real t, hit_record& rec) const {
+  point3 center = vec3_t<double>(center_x_[index], center_y_[index], center_z_[index]).cast<real>();
+
+  rec.t = t;
+  rec.p = r.at(t);
+  vec3 outward_normal = (rec.p - center) / static_cast<real>(radius_[index]);
+  rec.set_face_normal(r, outward_normal);
+  rec.mat_index = materials_[index];
+}
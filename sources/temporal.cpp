@@ -0,0 +1,165 @@
+#include "temporal.h"
+
+#include <cmath>
+
+temporalReuse::temporalReuse(raytrace& raytracer, temporal_settings settings)
+    : raytracer_(raytracer),
+      settings_(settings),
+      width_(raytracer.image_width()),
+      height_(raytracer.image_height()),
+      sum_(width_ * height_),
+      count_(width_ * height_) {}
+
+void temporalReuse::trace_hits(const camera& cam, hit_buffer& buffer) {
+  buffer.position.resize(width_ * height_);
+  buffer.depth.resize(width_ * height_);
+  buffer.material.resize(width_ * height_);
+
+  raytracer_.thread_pool().run(height_, [&](size_t j, size_t) {
+    for (size_t i = 0; i < width_; i++) {
+      const size_t index = j * width_ + i;
+      // pixel (i, j) covers [i, i + 1) like the samples of raytrace::calcPixel
+      const ray r = cam.get_center_ray((i + real(0.5)) / (width_ - 1), (j + real(0.5)) / (height_ - 1));
+      hit_record rec;
+      if (raytracer_.world().hit(r, 0.001, infinity, rec)) {
+        buffer.position[index] = rec.p;
+        buffer.depth[index] = rec.t * r.direction().norm();
+        buffer.material[index] = rec.mat_index;
+      } else {
+        buffer.material[index] = no_hit;
+      }
+    }
+  });
+}
+
+// A pixel at the silhouette of an object is partly covered by another surface. Its value depends on the exact
+// position of the edge inside the pixel and can't be interpolated from the previous frame. Every object of the
+// scenes has its own material, so a silhouette is where the material changes.
+bool temporalReuse::interior(size_t index) const {
+  const size_t i = index % width_;
+  const size_t j = index / width_;
+  for (size_t nj = std::max<size_t>(j, 1) - 1; nj <= std::min(j + 1, height_ - 1); nj++) {
+    for (size_t ni = std::max<size_t>(i, 1) - 1; ni <= std::min(i + 1, width_ - 1); ni++) {
+      if (hits_.material[nj * width_ + ni] != hits_.material[index]) return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+// Catmull-Rom weights of the samples at -1, 0, 1, 2 for the position f in [0, 1). Bilinear interpolation would blur
+// the history a little in every frame, which adds up over the frames the history lives.
+void catmull_rom(real f, real weights[4]) {
+  const real f2 = f * f;
+  const real f3 = f2 * f;
+  weights[0] = (-f3 + 2 * f2 - f) / 2;
+  weights[1] = (3 * f3 - 5 * f2 + 2) / 2;
+  weights[2] = (-3 * f3 + 4 * f2 + f) / 2;
+  weights[3] = (f3 - f2) / 2;
+}
+}  // namespace
+
+// interpolation of the previous frame at the projected hit point, neighbors which saw another surface are left out
+bool temporalReuse::reproject(size_t index, color& sum, double& count) const {
+  real s, t;
+  if (!previous_camera_->project(hits_.position[index], s, t)) return false;
+
+  // coordinates relative to the pixel centers
+  const real x = s * (width_ - 1) - real(0.5);
+  const real y = t * (height_ - 1) - real(0.5);
+  const real x0 = std::floor(x);
+  const real y0 = std::floor(y);
+  real weights_x[4], weights_y[4];
+  catmull_rom(x - x0, weights_x);
+  catmull_rom(y - y0, weights_y);
+
+  sum = color(0, 0, 0);
+  count = 0.;
+  real total_weight = 0;
+  real valid_weight = 0;  // of the positive weights, the share of the footprint which saw the surface
+  for (int dy = -1; dy < 3; dy++) {
+    for (int dx = -1; dx < 3; dx++) {
+      const real px = x0 + dx;
+      const real py = y0 + dy;
+      if (px < 0 || py < 0 || px >= width_ || py >= height_) continue;
+
+      const size_t neighbor = static_cast<size_t>(py) * width_ + static_cast<size_t>(px);
+      if (previous_hits_.material[neighbor] != hits_.material[index]) continue;
+      if ((previous_hits_.position[neighbor] - hits_.position[index]).norm() >
+          settings_.position_tolerance * hits_.depth[index]) {
+        continue;
+      }
+
+      const real weight = weights_x[dx + 1] * weights_y[dy + 1];
+      // the history is used as mean and weight, count only scales the weight
+      sum += weight * previous_sum_[neighbor] / static_cast<real>(previous_count_[neighbor]);
+      count += weight * previous_count_[neighbor];
+      total_weight += weight;
+      valid_weight += std::max(weight, real(0));
+    }
+  }
+
+  // too little of the footprint was valid, e.g. at a silhouette
+  if (valid_weight < real(0.5) || total_weight <= 0) return false;
+
+  // the negative lobes can overshoot at edges
+  color mean = (sum / total_weight).cwiseMax(color(0, 0, 0));
+  count = std::min<double>(count / total_weight, settings_.max_history);
+  if (count <= 0.) return false;
+
+  sum = static_cast<real>(count) * mean;
+  return true;
+}
+
+void temporalReuse::render(const camera& cam) {
+  const size_t num_pixels = width_ * height_;
+  const material_table& materials = raytracer_.materials();
+
+  trace_hits(cam, hits_);
+
+  stats_ = frame_stats();
+  stats_.pixels = num_pixels;
+
+  std::vector<color> history_sum(num_pixels, color(0, 0, 0));
+  std::vector<double> history_count(num_pixels, 0.);
+  std::vector<uint32_t> samples(num_pixels, raytracer_.samples_per_pixel());
+  for (size_t index = 0; index < num_pixels; index++) {
+    const uint32_t mat = hits_.material[index];
+    if (mat == no_hit || type_of(materials[mat]) != material_type::lambertian) {
+      stats_.not_reusable++;
+    } else if (previous_camera_ && interior(index) && reproject(index, history_sum[index], history_count[index])) {
+      samples[index] = std::min<uint32_t>(settings_.fresh_samples, raytracer_.samples_per_pixel());
+      stats_.reused++;
+      stats_.history += history_count[index];
+    } else {
+      stats_.rejected++;
+    }
+    stats_.samples += samples[index];
+  }
+  if (stats_.reused) stats_.history /= stats_.reused;
+
+  raytracer_.render_samples(cam, samples);
+
+  const auto& estimates = raytracer_.pixel_estimates();
+  for (size_t index = 0; index < num_pixels; index++) {
+    sum_[index] = history_sum[index] + estimates[index].sum;
+    count_[index] = history_count[index] + estimates[index].count;
+  }
+
+  std::swap(hits_, previous_hits_);
+  previous_sum_ = sum_;
+  previous_count_ = count_;
+  previous_camera_ = cam;
+}
+
+ImageWrapper temporalReuse::image(const std::string& filename, image_type type) const {
+  ImageWrapper image(filename, width_, height_, type);
+
+  for (size_t j = 0; j < height_; j++) {
+    for (size_t i = 0; i < width_; i++) {
+      image.write_color(i, j, mean(j * width_ + i), 1);
+    }
+  }
+
+  return image;
+}
@@ -0,0 +1,190 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+#include "stop_watch.h"
+
+threadPool::threadPool(size_t num_threads) {
+  num_threads = std::max<size_t>(1, num_threads);
+
+  stats_.resize(num_threads);
+  events_.resize(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    queues_.push_back(std::make_unique<worker_queue>());
+  }
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&threadPool::worker_loop, this, i);
+  }
+}
+
+threadPool::~threadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  start_condition_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void threadPool::run(size_t num_tasks, const task_function& task, const char* name) {
+  stopWatch stop_watch;
+  stop_watch.start();
+
+  const size_t num_threads = workers_.size();
+  for (auto& stats : stats_) {
+    stats = thread_stats();
+  }
+
+  // contiguous blocks keep neighboring tasks on the same thread as long as nothing has to be stolen
+  for (size_t i = 0; i < num_threads; i++) {
+    size_t begin = num_tasks * i / num_threads;
+    size_t end = num_tasks * (i + 1) / num_threads;
+
+    std::lock_guard<std::mutex> lock(queues_[i]->mutex);
+    for (size_t task_index = begin; task_index < end; task_index++) {
+      queues_[i]->tasks.push_back(task_index);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    run_name_ = name;
+    active_workers_ = num_threads;
+    generation_++;
+    start_condition_.notify_all();
+
+    done_condition_.wait(lock, [this] { return active_workers_ == 0; });
+    task_ = nullptr;
+  }
+  if (trace_) traced_runs_++;
+
+  run_time_ = stop_watch.stop();
+  for (auto& stats : stats_) {
+    stats.idle_time = std::max(0., run_time_ - stats.busy_time);
+  }
+}
+
+double threadPool::utilization() const {
+  if (run_time_ <= 0.) return 0.;
+
+  double busy_time = 0.;
+  for (const auto& stats : stats_) {
+    busy_time += stats.busy_time;
+  }
+  return busy_time / (run_time_ * stats_.size());
+}
+
+void threadPool::print_stats(std::ostream& out) const {
+  out << std::fixed << std::setprecision(4);
+  out << "thread     busy [s]     idle [s]    tasks   stolen\n";
+  for (size_t i = 0; i < stats_.size(); i++) {
+    out << std::setw(6) << i << std::setw(13) << stats_[i].busy_time << std::setw(13) << stats_[i].idle_time
+        << std::setw(9) << stats_[i].tasks << std::setw(9) << stats_[i].stolen << "\n";
+  }
+  out << "run time " << run_time_ << "s, utilization " << std::setprecision(1) << 100. * utilization() << "%"
+      << std::endl;
+}
+
+void threadPool::set_trace(bool enabled) {
+  if (enabled && !trace_) {
+    for (auto& events : events_) {
+      events.clear();
+    }
+    traced_runs_ = 0;
+    trace_start_ = std::chrono::steady_clock::now();
+  }
+  trace_ = enabled;
+}
+
+void threadPool::write_trace(std::ostream& out) const {
+  out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  for (size_t thread = 0; thread < events_.size(); thread++) {
+    out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread
+        << ", \"args\": {\"name\": \"thread " << thread << "\"}}";
+    first = false;
+    for (const task_event& event : events_[thread]) {
+      // complete events, the times are in microseconds
+      out << ",\n{\"name\": \"" << event.name << " " << event.task << "\", \"cat\": \"" << event.name
+          << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread << ", \"ts\": " << 1e6 * event.start
+          << ", \"dur\": " << 1e6 * (event.end - event.start) << ", \"args\": {\"run\": " << event.run
+          << ", \"stolen\": " << (event.stolen ? "true" : "false") << "}}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+bool threadPool::pop_task(size_t thread_index, size_t& task_index, bool& stolen) {
+  {
+    worker_queue& own = *queues_[thread_index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task_index = own.tasks.front();
+      own.tasks.pop_front();
+      stolen = false;
+      return true;
+    }
+  }
+
+  // steal from the end of the other queues, starting with the neighbor
+  const size_t num_threads = queues_.size();
+  for (size_t offset = 1; offset < num_threads; offset++) {
+    worker_queue& victim = *queues_[(thread_index + offset) % num_threads];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task_index = victim.tasks.back();
+      victim.tasks.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void threadPool::worker_loop(size_t thread_index) {
+  size_t seen_generation = 0;
+
+  while (true) {
+    const task_function* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_condition_.wait(lock, [&] { return shutdown_ || generation_ != seen_generation; });
+      if (shutdown_) return;
+      seen_generation = generation_;
+      task = task_;
+    }
+
+    thread_stats& stats = stats_[thread_index];
+    stopWatch stop_watch;
+    size_t task_index;
+    bool stolen;
+
+    // all tasks are queued before the start, so no work can appear once all queues are empty
+    while (pop_task(thread_index, task_index, stolen)) {
+      stop_watch.start();
+      const auto start = trace_ ? std::chrono::steady_clock::now() : trace_start_;
+      (*task)(task_index, thread_index);
+      const double busy_time = stop_watch.stop();
+      stats.busy_time += busy_time;
+      stats.tasks++;
+      if (stolen) stats.stolen++;
+      if (trace_) {
+        const double task_start = std::chrono::duration<double>(start - trace_start_).count();
+        events_[thread_index].push_back(task_event{run_name_, traced_runs_, static_cast<uint32_t>(task_index),
+                                                   task_start, task_start + busy_time, stolen});
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_workers_ == 0) done_condition_.notify_one();
+    }
+  }
+}
@@ -0,0 +1,101 @@
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<tile> tileScheduler::generate(uint32_t image_width, uint32_t image_height, uint32_t tile_size,
+                                          tile_order order) {
+  tile_size = std::max<uint32_t>(1, tile_size);
+  const uint32_t tiles_x = (image_width + tile_size - 1) / tile_size;
+  const uint32_t tiles_y = (image_height + tile_size - 1) / tile_size;
+
+  uint32_t grid_size = 1;
+  while (grid_size < std::max(tiles_x, tiles_y)) grid_size *= 2;
+
+  std::vector<std::pair<uint32_t, tile>> keyed_tiles;
+  keyed_tiles.reserve(tiles_x * tiles_y);
+
+  for (uint32_t ty = 0; ty < tiles_y; ty++) {
+    for (uint32_t tx = 0; tx < tiles_x; tx++) {
+      tile t{tx * tile_size, ty * tile_size, std::min(image_width, (tx + 1) * tile_size),
+             std::min(image_height, (ty + 1) * tile_size)};
+
+      uint32_t key;
+      switch (order) {
+        case tile_order::morton:
+          key = morton_index(tx, ty);
+          break;
+        case tile_order::hilbert:
+          key = hilbert_index(grid_size, tx, ty);
+          break;
+        default:
+          key = ty * tiles_x + tx;
+          break;
+      }
+      keyed_tiles.emplace_back(key, t);
+    }
+  }
+
+  std::sort(keyed_tiles.begin(), keyed_tiles.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  std::vector<tile> tiles;
+  tiles.reserve(keyed_tiles.size());
+  for (const auto& keyed_tile : keyed_tiles) {
+    tiles.push_back(keyed_tile.second);
+  }
+
+  return tiles;
+}
+
+// spreads the lower 16 bits so that there is a zero bit between each of them
+static uint32_t part_by_one(uint32_t v) {
+  v &= 0x0000ffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+uint32_t tileScheduler::morton_index(uint32_t x, uint32_t y) { return part_by_one(x) | (part_by_one(y) << 1); }
+
+uint32_t tileScheduler::hilbert_index(uint32_t size, uint32_t x, uint32_t y) {
+  uint32_t d = 0;
+
+  for (uint32_t s = size / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    // rotate the quadrant
+    if (ry == 0) {
+      if (rx == 1) {
+        x = size - 1 - x;
+        y = size - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+
+  return d;
+}
+
+tile_order tileScheduler::parse_order(const std::string& name) {
+  if (name == "scanline") return tile_order::scanline;
+  if (name == "morton") return tile_order::morton;
+  if (name == "hilbert") return tile_order::hilbert;
+
+  throw std::invalid_argument("unknown tile order " + name);
+}
+
+std::string tileScheduler::order_name(tile_order order) {
+  switch (order) {
+    case tile_order::morton:
+      return "morton";
+    case tile_order::hilbert:
+      return "hilbert";
+    default:
+      return "scanline";
+  }
+}
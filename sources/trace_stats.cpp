@@ -0,0 +1,90 @@
+#include "trace_stats.h"
+
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+
+namespace {
+// the counters outlive their threads, a finished pool still shows up in collect()
+std::mutex registry_mutex;
+std::deque<trace_counters> registry;
+}  // namespace
+
+trace_counters& trace_counters::operator+=(const trace_counters& other) {
+  paths += other.paths;
+  rays += other.rays;
+  shadow_rays += other.shadow_rays;
+  intersect_time += other.intersect_time;
+  scatter_time += other.scatter_time;
+  node_visits += other.node_visits;
+  intersection_tests += other.intersection_tests;
+  hits += other.hits;
+  for (size_t m = 0; m < 4; m++) {
+    bounces[m] += other.bounces[m];
+  }
+  occluded_shadow_rays += other.occluded_shadow_rays;
+  total_internal_reflections += other.total_internal_reflections;
+  unit_sphere_rejections += other.unit_sphere_rejections;
+  escaped += other.escaped;
+  absorbed += other.absorbed;
+  roulette += other.roulette;
+  max_depth_reached += other.max_depth_reached;
+  for (size_t length = 0; length < histogram_size; length++) {
+    path_length[length] += other.path_length[length];
+  }
+  return *this;
+}
+
+trace_counters* traceStats::register_thread() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.emplace_back();
+  return &registry.back();
+}
+
+trace_counters traceStats::collect() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  trace_counters sum;
+  for (const auto& counters : registry) {
+    sum += counters;
+  }
+  return sum;
+}
+
+void traceStats::reset() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto& counters : registry) {
+    counters = trace_counters();
+  }
+}
+
+void traceStats::print(std::ostream& out, const trace_counters& c) {
+  const auto per_ray = [&](uint64_t count) { return c.rays > 0 ? static_cast<double>(count) / c.rays : 0.; };
+
+  out << std::fixed << std::setprecision(2) << c.paths << " paths, " << c.rays << " rays, " << c.average_depth()
+      << " rays per path, " << c.shadow_rays << " shadow rays\n";
+#ifdef RAYTRACING_COUNTERS
+  out << "per ray: " << per_ray(c.node_visits) << " node visits, " << per_ray(c.intersection_tests)
+      << " intersection tests, " << per_ray(c.hits) << " hits\n";
+  out << "bounces: " << c.bounces[0] << " lambertian, " << c.bounces[1] << " metal, " << c.bounces[2]
+      << " dielectric (" << c.total_internal_reflections << " total internal reflections), " << c.bounces[3]
+      << " light\n";
+  out << "shadow rays: " << c.occluded_shadow_rays << " occluded\n";
+  out << "random_in_unit_sphere rejections: " << c.unit_sphere_rejections << "\n";
+  out << "paths ended: " << c.escaped << " escaped, " << c.absorbed << " absorbed, " << c.roulette
+      << " by russian roulette, " << c.max_depth_reached << " at max depth\n";
+  out << "path length:";
+  const uint64_t ended = c.escaped + c.absorbed + c.roulette + c.max_depth_reached;
+  for (size_t length = 1; length < trace_counters::histogram_size; length++) {
+    // the rare long paths would fill the line with 0.0%
+    if (1000 * c.path_length[length] < ended) continue;
+    out << " " << length << (length + 1 == trace_counters::histogram_size ? "+" : "") << ": " << std::setprecision(1)
+        << 100. * c.path_length[length] / ended << "%";
+  }
+  out << "\n";
+#else
+  static_cast<void>(per_ray);
+  out << "detailed counters need the cmake option RAYTRACING_COUNTERS\n";
+#endif
+  out << std::flush;
+}
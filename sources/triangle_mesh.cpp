@@ -0,0 +1,354 @@
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "stop_watch.h"
+#include "trace_stats.h"
+
+namespace {
+const char mesh_magic[4] = {'R', 'T', 'M', 'B'};
+constexpr uint32_t mesh_version = 1;
+
+// followed by the vertices (3 floats each), the indices (3 per triangle) and the nodes, every section starts at a
+// multiple of 64 bytes
+struct mesh_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t node_size;  // sizeof(bvh_node) of the precision the nodes were built with
+  uint32_t padding;
+  uint64_t num_vertices;
+  uint64_t num_triangles;
+  uint64_t num_nodes;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  uint64_t node_offset;
+};
+
+uint64_t align_section(uint64_t offset) { return (offset + 63) / 64 * 64; }
+
+class obj_error : public std::runtime_error {
+ public:
+  obj_error(const std::string& filename, size_t line, const std::string& message)
+      : std::runtime_error(filename + ":" + std::to_string(line) + ": " + message) {}
+};
+}  // namespace
+
+triangle_mesh::triangle_mesh(std::vector<float> vertices, std::vector<uint32_t> indices, uint32_t mat_index)
+    : vertex_storage_(std::move(vertices)),
+      num_vertices_(vertex_storage_.size() / 3),
+      num_triangles_(indices.size() / 3),
+      mat_index_(mat_index) {
+  vertices_ = vertex_storage_.data();
+
+  std::vector<aabb> boxes(num_triangles_);
+  for (size_t triangle = 0; triangle < num_triangles_; triangle++) {
+    for (int k = 0; k < 3; k++) {
+      const uint32_t index = indices[3 * triangle + k];
+      if (index >= num_vertices_) throw std::runtime_error("triangle references an unknown vertex");
+      boxes[triangle].grow(vertex(index));
+    }
+    // A ray through a vertex or an edge grazes the box of the triangle, the rounding of the slab test could miss it.
+    // The padding makes the boxes conservative.
+    const aabb& box = boxes[triangle];
+    real magnitude = 0;
+    for (int a = 0; a < 3; a++) {
+      magnitude = std::max({magnitude, std::abs(box.min()[a]), std::abs(box.max()[a])});
+    }
+    const vec3 pad(real(1e-6) * magnitude, real(1e-6) * magnitude, real(1e-6) * magnitude);
+    boxes[triangle] = aabb(box.min() - pad, box.max() + pad);
+  }
+  tree_.build(boxes);
+
+  // leaf order, a leaf covers a contiguous range of triangles
+  index_storage_.resize(indices.size());
+  const std::vector<uint32_t>& order = tree_.primitive_indices();
+  for (size_t position = 0; position < num_triangles_; position++) {
+    std::memcpy(&index_storage_[3 * position], &indices[3 * order[position]], 3 * sizeof(uint32_t));
+  }
+  tree_.clear_primitive_indices();
+  indices_ = index_storage_.data();
+}
+
+triangle_mesh::triangle_mesh(std::shared_ptr<const mapped_file> mapping, const float* vertices, size_t num_vertices,
+                             const uint32_t* indices, size_t num_triangles, const bvh_node* nodes, size_t num_nodes,
+                             uint32_t mat_index)
+    : mapping_(std::move(mapping)),
+      vertices_(vertices),
+      indices_(indices),
+      num_vertices_(num_vertices),
+      num_triangles_(num_triangles),
+      mat_index_(mat_index) {
+  tree_.reference(nodes, num_nodes);
+}
+
+triangle_mesh::sheared_ray::sheared_ray(const ray& r) : origin(r.origin()) {
+  const vec3& d = r.direction();
+  // z is the largest component of the direction, x and y keep the winding of the triangles
+  kz = std::abs(d[0]) > std::abs(d[1]) ? (std::abs(d[0]) > std::abs(d[2]) ? 0 : 2)
+                                       : (std::abs(d[1]) > std::abs(d[2]) ? 1 : 2);
+  kx = (kz + 1) % 3;
+  ky = (kx + 1) % 3;
+  if (d[kz] < 0) std::swap(kx, ky);
+
+  sx = d[kx] / d[kz];
+  sy = d[ky] / d[kz];
+  sz = 1 / d[kz];
+}
+
+real triangle_mesh::intersect(const sheared_ray& r, uint32_t triangle, real t_min, real t_max) const {
+  const vec3 a = vertex(indices_[3 * triangle]) - r.origin;
+  const vec3 b = vertex(indices_[3 * triangle + 1]) - r.origin;
+  const vec3 c = vertex(indices_[3 * triangle + 2]) - r.origin;
+
+  // vertices in the coordinates of the ray, the ray goes through (0, 0)
+  const real ax = a[r.kx] - r.sx * a[r.kz];
+  const real ay = a[r.ky] - r.sy * a[r.kz];
+  const real bx = b[r.kx] - r.sx * b[r.kz];
+  const real by = b[r.ky] - r.sy * b[r.kz];
+  const real cx = c[r.kx] - r.sx * c[r.kz];
+  const real cy = c[r.ky] - r.sy * c[r.kz];
+
+  // scaled barycentric coordinates, the signed areas of the edges as seen from the ray
+  precise_real u = cx * by - cy * bx;
+  precise_real v = ax * cy - ay * cx;
+  precise_real w = bx * ay - by * ax;
+  if (u == 0 || v == 0 || w == 0) {
+    // the ray hits an edge in the precision of real, the sign decides which of the neighbours is hit
+    u = precise_real(cx) * by - precise_real(cy) * bx;
+    v = precise_real(ax) * cy - precise_real(ay) * cx;
+    w = precise_real(bx) * ay - precise_real(by) * ax;
+  }
+
+  if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) return 0;
+  const precise_real det = u + v + w;
+  if (det == 0) return 0;
+
+  const precise_real t = (u * a[r.kz] + v * b[r.kz] + w * c[r.kz]) * r.sz / det;
+  return (t > t_min && t < t_max) ? static_cast<real>(t) : 0;
+}
+
+bool triangle_mesh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+  const sheared_ray sheared(r);
+  uint32_t closest_triangle = 0;
+
+  bool hit_anything = tree_.traverse(r, t_min, t_max, [&](uint32_t first, uint32_t count, real& closest) {
+    bool hit_leaf = false;
+    TRACE_ADD(intersection_tests, count);
+    for (uint32_t triangle = first; triangle < first + count; triangle++) {
+      const real t = intersect(sheared, triangle, t_min, closest);
+      if (t > 0) {
+        hit_leaf = true;
+        closest = t;
+        closest_triangle = triangle;
+        rec.t = t;
+      }
+    }
+    return hit_leaf;
+  });
+  if (!hit_anything) return false;
+
+  // the normal only of the closest hit
+  const point3 v0 = vertex(indices_[3 * closest_triangle]);
+  const point3 v1 = vertex(indices_[3 * closest_triangle + 1]);
+  const point3 v2 = vertex(indices_[3 * closest_triangle + 2]);
+  const vec3 outward_normal = unit_vector(cross(v1 - v0, v2 - v0));
+  rec.p = r.at(rec.t);
+  rec.set_face_normal(r, outward_normal);
+  rec.mat_index = mat_index_;
+  return true;
+}
+
+bool triangle_mesh::occluded(const ray& r, real t_min, real t_max) const {
+  const sheared_ray sheared(r);
+
+  return tree_.traverse_any(r, t_min, t_max, [&](uint32_t first, uint32_t count) {
+    TRACE_ADD(intersection_tests, count);
+    for (uint32_t triangle = first; triangle < first + count; triangle++) {
+      if (intersect(sheared, triangle, t_min, t_max) > 0) return true;
+    }
+    return false;
+  });
+}
+
+bool triangle_mesh::bounding_box(aabb& output_box) const {
+  if (tree_.empty()) return false;
+
+  output_box = tree_.bounds();
+  return true;
+}
+
+std::shared_ptr<triangle_mesh> meshLoader::load(const std::string& filename, uint32_t mat_index, bool use_cache,
+                                                load_stats* stats) {
+  namespace fs = std::filesystem;
+
+  stopWatch stop_watch;
+  stop_watch.start();
+
+  const bool binary = fs::path(filename).extension() == ".rtmesh";
+  const std::string cache = cache_filename(filename);
+  std::error_code error;
+  const bool cache_valid = !binary && use_cache && fs::exists(cache, error) &&
+                           fs::last_write_time(cache, error) >= fs::last_write_time(filename, error) && !error;
+
+  std::shared_ptr<triangle_mesh> mesh = binary        ? load_binary(filename, mat_index)
+                                        : cache_valid ? load_binary(cache, mat_index)
+                                                      : load_obj(filename, mat_index);
+  if (!binary && use_cache && !cache_valid) {
+    // the cache only speeds up the next load, a mesh in a read only directory is fine
+    try {
+      save_binary(*mesh, cache);
+    } catch (const std::runtime_error&) {
+    }
+  }
+  mesh->set_source(fs::absolute(filename).string());
+
+  if (stats) {
+    stats->load_time = stop_watch.stop();
+    stats->from_cache = binary || cache_valid;
+  }
+  return mesh;
+}
+
+std::shared_ptr<triangle_mesh> meshLoader::load_obj(const std::string& filename, uint32_t mat_index) {
+  const mapped_file file(filename);
+  const char* position = file.data();
+  const char* const end = file.data() + file.size();
+
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> face;
+  size_t line_number = 1;
+
+  const auto skip_spaces = [&]() {
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\r')) position++;
+  };
+  const auto skip_line = [&]() {
+    while (position < end && *position != '\n') position++;
+    if (position < end) position++;
+    line_number++;
+  };
+
+  while (position < end) {
+    skip_spaces();
+    if (position + 1 < end && position[0] == 'v' && (position[1] == ' ' || position[1] == '\t')) {
+      position += 2;
+      for (int a = 0; a < 3; a++) {
+        skip_spaces();
+        float value;
+        const auto result = std::from_chars(position, end, value);
+        if (result.ec != std::errc()) throw obj_error(filename, line_number, "expected v <x> <y> <z>");
+        vertices.push_back(value);
+        position = result.ptr;
+      }
+    } else if (position + 1 < end && position[0] == 'f' && (position[1] == ' ' || position[1] == '\t')) {
+      position += 2;
+      face.clear();
+      while (true) {
+        skip_spaces();
+        if (position == end || *position == '\n' || *position == '#') break;
+
+        // v, v/vt, v//vn or v/vt/vn, only the vertex is used. Negative indices count from the last vertex.
+        long index;
+        const auto result = std::from_chars(position, end, index);
+        if (result.ec != std::errc() || index == 0) throw obj_error(filename, line_number, "invalid face vertex");
+        const long num_vertices = static_cast<long>(vertices.size() / 3);
+        const long vertex_index = index > 0 ? index - 1 : num_vertices + index;
+        if (vertex_index < 0 || vertex_index >= num_vertices) {
+          throw obj_error(filename, line_number, "face references an unknown vertex");
+        }
+        face.push_back(static_cast<uint32_t>(vertex_index));
+        position = result.ptr;
+        while (position < end && *position != ' ' && *position != '\t' && *position != '\r' && *position != '\n') {
+          position++;
+        }
+      }
+      if (face.size() < 3) throw obj_error(filename, line_number, "face with less than three vertices");
+      for (size_t k = 1; k + 1 < face.size(); k++) {
+        indices.insert(indices.end(), {face[0], face[k], face[k + 1]});
+      }
+    }
+    skip_line();
+  }
+
+  if (indices.empty()) throw std::runtime_error(filename + " has no faces");
+  return std::make_shared<triangle_mesh>(std::move(vertices), std::move(indices), mat_index);
+}
+
+std::shared_ptr<triangle_mesh> meshLoader::load_binary(const std::string& filename, uint32_t mat_index) {
+  auto mapping = std::make_shared<const mapped_file>(filename);
+
+  mesh_header header;
+  if (mapping->size() < sizeof(header)) throw std::runtime_error(filename + " is no binary mesh");
+  std::memcpy(&header, mapping->data(), sizeof(header));
+  if (std::memcmp(header.magic, mesh_magic, sizeof(mesh_magic)) != 0 || header.version != mesh_version) {
+    throw std::runtime_error(filename + " is no binary mesh");
+  }
+  if (header.vertex_offset + 3 * sizeof(float) * header.num_vertices > header.index_offset ||
+      header.index_offset + 3 * sizeof(uint32_t) * header.num_triangles > header.node_offset ||
+      header.node_offset + header.node_size * header.num_nodes != mapping->size()) {
+    throw std::runtime_error("binary mesh " + filename + " has the wrong size");
+  }
+
+  const auto* vertices = reinterpret_cast<const float*>(mapping->data() + header.vertex_offset);
+  const auto* indices = reinterpret_cast<const uint32_t*>(mapping->data() + header.index_offset);
+  for (uint64_t k = 0; k < 3 * header.num_triangles; k++) {
+    if (indices[k] >= header.num_vertices) {
+      throw std::runtime_error("binary mesh " + filename + " references an unknown vertex");
+    }
+  }
+
+  if (header.node_size != sizeof(bvh_node)) {
+    // built in another precision
+    return std::make_shared<triangle_mesh>(std::vector<float>(vertices, vertices + 3 * header.num_vertices),
+                                           std::vector<uint32_t>(indices, indices + 3 * header.num_triangles),
+                                           mat_index);
+  }
+
+  // the tree uses the nodes in the mapping, the mapping is page aligned and the node section 64 byte aligned
+  if (header.node_offset % alignof(bvh_node) != 0) {
+    throw std::runtime_error("binary mesh " + filename + " has misaligned nodes");
+  }
+  const auto* nodes = reinterpret_cast<const bvh_node*>(mapping->data() + header.node_offset);
+  for (uint64_t n = 0; n < header.num_nodes; n++) {
+    const bvh_node& node = nodes[n];
+    const uint64_t end = node.is_leaf() ? uint64_t(node.offset) + node.count : node.offset;
+    if (end > (node.is_leaf() ? header.num_triangles : header.num_nodes - 1)) {
+      throw std::runtime_error("binary mesh " + filename + " has an invalid bvh");
+    }
+  }
+
+  return std::make_shared<triangle_mesh>(mapping, vertices, header.num_vertices, indices, header.num_triangles,
+                                         nodes, header.num_nodes, mat_index);
+}
+
+void meshLoader::save_binary(const triangle_mesh& mesh, const std::string& filename) {
+  const bvh_node* nodes = mesh.tree().nodes();
+
+  mesh_header header = {};
+  std::memcpy(header.magic, mesh_magic, sizeof(mesh_magic));
+  header.version = mesh_version;
+  header.node_size = sizeof(bvh_node);
+  header.num_vertices = mesh.num_vertices();
+  header.num_triangles = mesh.num_triangles();
+  header.num_nodes = mesh.tree().num_nodes();
+  header.vertex_offset = align_section(sizeof(header));
+  header.index_offset = align_section(header.vertex_offset + 3 * sizeof(float) * header.num_vertices);
+  header.node_offset = align_section(header.index_offset + 3 * sizeof(uint32_t) * header.num_triangles);
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  const auto write_section = [&](uint64_t offset, const void* data, size_t size) {
+    const std::string padding(offset - file.tellp(), '\0');
+    file.write(padding.data(), padding.size());
+    file.write(static_cast<const char*>(data), size);
+  };
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  write_section(header.vertex_offset, mesh.vertices(), 3 * sizeof(float) * header.num_vertices);
+  write_section(header.index_offset, mesh.indices(), 3 * sizeof(uint32_t) * header.num_triangles);
+  write_section(header.node_offset, nodes, sizeof(bvh_node) * header.num_nodes);
+  if (!file) throw std::runtime_error("can't write " + filename);
+}
@@ -0,0 +1,294 @@
+#include "wavefront.h"
+
+#include <algorithm>
+
+void wavefrontTrace::ray_queue::resize(size_t n) {
+  for (int a = 0; a < 3; a++) {
+    origin[a].resize(n);
+    direction[a].resize(n);
+    throughput[a].resize(n);
+  }
+  pixel.resize(n);
+}
+
+void wavefrontTrace::ray_queue::set(size_t i, const ray& r, const color& weight, uint32_t pixel_index) {
+  for (int a = 0; a < 3; a++) {
+    origin[a][i] = r.origin()[a];
+    direction[a][i] = r.direction()[a];
+    throughput[a][i] = weight[a];
+  }
+  pixel[i] = pixel_index;
+}
+
+void wavefrontTrace::ray_queue::copy(size_t i, const ray_queue& from, size_t from_index) {
+  for (int a = 0; a < 3; a++) {
+    origin[a][i] = from.origin[a][from_index];
+    direction[a][i] = from.direction[a][from_index];
+    throughput[a][i] = from.throughput[a][from_index];
+  }
+  pixel[i] = from.pixel[from_index];
+}
+
+ray wavefrontTrace::ray_queue::get_ray(size_t i) const {
+  return ray(point3(origin[0][i], origin[1][i], origin[2][i]), vec3(direction[0][i], direction[1][i], direction[2][i]));
+}
+
+void wavefrontTrace::hit_queue::resize(size_t n) {
+  for (int a = 0; a < 3; a++) {
+    p[a].resize(n);
+    normal[a].resize(n);
+  }
+  front_face.resize(n);
+  mat_index.resize(n);
+  type.resize(n);
+}
+
+hit_record wavefrontTrace::hit_queue::get_record(size_t i) const {
+  hit_record rec;
+  rec.p = point3(p[0][i], p[1][i], p[2][i]);
+  rec.normal = vec3(normal[0][i], normal[1][i], normal[2][i]);
+  rec.front_face = front_face[i];
+  return rec;
+}
+
+wavefrontTrace::wavefrontTrace(std::shared_ptr<hittable> world, std::shared_ptr<const material_table> materials,
+                               size_t image_width, size_t image_height, size_t samples_per_pixel, uint8_t max_depth,
+                               std::shared_ptr<threadPool> pool)
+    : world_(world),
+      materials_(materials),
+      image_width_(image_width),
+      image_height_(image_height),
+      samples_per_pixel_(samples_per_pixel),
+      max_depth_(max_depth),
+      pool_(pool) {
+  const size_t num_pixels = image_width_ * image_height_;
+
+  rays_.resize(num_pixels);
+  next_rays_.resize(num_pixels);
+  hits_.resize(num_pixels);
+  order_.resize(num_pixels);
+  alive_.resize(num_pixels);
+  sort_keys_.resize(num_pixels);
+  bucket_begin_.resize(num_buckets + 1);
+  accumulated_.resize(num_pixels);
+
+  world_->bounding_box(scene_box_);
+}
+
+template <class FUNC>
+void wavefrontTrace::parallel_for(size_t n, FUNC&& func) {
+  const size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+  pool_->run(num_chunks, [&](size_t chunk, size_t) {
+    const size_t end = std::min(n, (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; i++) {
+      func(i);
+    }
+  });
+}
+
+ImageWrapper wavefrontTrace::calcImage(const camera& cam, std::string image_filename) {
+  std::fill(accumulated_.begin(), accumulated_.end(), color(0, 0, 0));
+  rays_traced_ = 0;
+
+  for (sample_ = 0; sample_ < samples_per_pixel_; sample_++) {
+    generate_primary_rays(cam);
+
+    for (uint8_t depth = 0; depth < max_depth_ && rays_.size() > 0; depth++) {
+      rays_traced_ += rays_.size();
+      bounce_ = depth + 1;
+
+      // the primary rays are already coherent in pixel order
+      if (sort_rays_ && depth > 0) sort_rays();
+      intersect();
+      partition();
+      scatter();
+      compact();
+    }
+    // rays which are still alive after max_depth bounces contribute nothing, like in raytrace::ray_color without
+    // russian roulette
+  }
+
+  ImageWrapper image(image_filename, image_width_, image_height_);
+  for (size_t j = 0; j < image_height_; j++) {
+    for (size_t i = 0; i < image_width_; i++) {
+      image.write_color(i, j, accumulated_[j * image_width_ + i], samples_per_pixel_);
+    }
+  }
+
+  return image;
+}
+
+void wavefrontTrace::generate_primary_rays(const camera& cam) {
+  rays_.resize(image_width_ * image_height_);
+
+  parallel_for(rays_.size(), [&](size_t index) {
+    size_t i = index % image_width_;
+    size_t j = index / image_width_;
+    random_stream(counterRng::key(frame_, index, sample_));
+    real u = (i + random_real()) / (image_width_ - 1);
+    real v = (j + random_real()) / (image_height_ - 1);
+
+    rays_.set(index, cam.get_ray(u, v), color(1, 1, 1), index);
+  });
+}
+
+namespace {
+// spreads the lower 10 bits of v to every third bit
+uint32_t spread_bits(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+}  // namespace
+
+void wavefrontTrace::sort_rays() {
+  const size_t n = rays_.size();
+  const uint32_t cells = 1u << cell_bits;
+  vec3 scale;
+  for (int a = 0; a < 3; a++) {
+    const real extent = scene_box_.max()[a] - scene_box_.min()[a];
+    scale[a] = extent > 0 ? cells / extent : 0;
+  }
+
+  parallel_for(n, [&](size_t i) {
+    uint32_t octant = 0;
+    uint32_t morton = 0;
+    for (int a = 0; a < 3; a++) {
+      if (rays_.direction[a][i] < 0) octant |= 1u << a;
+      // origins outside of the scene box are clamped to its border cells
+      const real cell = (rays_.origin[a][i] - scene_box_.min()[a]) * scale[a];
+      morton |= spread_bits(static_cast<uint32_t>(std::clamp<real>(cell, 0, cells - 1))) << a;
+    }
+    sort_keys_[i] = (octant << (3 * cell_bits)) | morton;
+  });
+
+  // counting sort like partition, the rays of a bucket stay in pixel order
+  std::fill(bucket_begin_.begin(), bucket_begin_.end(), 0);
+  for (size_t i = 0; i < n; i++) {
+    bucket_begin_[sort_keys_[i] + 1]++;
+  }
+  for (size_t bucket = 1; bucket < bucket_begin_.size(); bucket++) {
+    bucket_begin_[bucket] += bucket_begin_[bucket - 1];
+  }
+  for (size_t i = 0; i < n; i++) {
+    next_rays_.copy(bucket_begin_[sort_keys_[i]]++, rays_, i);
+  }
+
+  std::swap(rays_, next_rays_);
+  rays_.resize(n);
+  next_rays_.resize(image_width_ * image_height_);
+}
+
+void wavefrontTrace::intersect() {
+  parallel_for(rays_.size(), [&](size_t i) {
+    ray r = rays_.get_ray(i);
+    hit_record rec;
+
+    if (world_->hit(r, 0.001, infinity, rec)) {
+      for (int a = 0; a < 3; a++) {
+        hits_.p[a][i] = rec.p[a];
+        hits_.normal[a][i] = rec.normal[a];
+      }
+      hits_.front_face[i] = rec.front_face;
+      hits_.mat_index[i] = rec.mat_index;
+      const material& mat = (*materials_)[rec.mat_index];
+      hits_.type[i] = static_cast<uint8_t>(type_of(mat));
+      // without light sampling the lights only contribute when a scattered ray hits them
+      if (hits_.type[i] == static_cast<uint8_t>(material_type::light)) {
+        accumulated_[rays_.pixel[i]] +=
+            color(rays_.throughput[0][i], rays_.throughput[1][i], rays_.throughput[2][i]).cwiseProduct(
+                emitted(mat, rec));
+      }
+    } else {
+      // every pixel is only once in the queue, so the sky can be added without synchronization
+      vec3 unit_direction = unit_vector(r.direction());
+      real t = (unit_direction.y() + 1) / 2;
+      color sky = (1 - t) * color(1, 1, 1) + t * color(0.5, 0.7, 1.0);
+      accumulated_[rays_.pixel[i]] +=
+          color(rays_.throughput[0][i], rays_.throughput[1][i], rays_.throughput[2][i]).cwiseProduct(sky);
+      hits_.type[i] = miss;
+    }
+  });
+}
+
+void wavefrontTrace::partition() {
+  // counting sort of the ray indices by material type, the misses are dropped
+  size_t count[static_cast<size_t>(material_type::count) + 1] = {};
+  for (size_t i = 0; i < rays_.size(); i++) {
+    count[hits_.type[i]]++;
+  }
+
+  type_begin_[0] = 0;
+  for (size_t type = 0; type < static_cast<size_t>(material_type::count); type++) {
+    type_begin_[type + 1] = type_begin_[type] + count[type];
+  }
+
+  size_t position[static_cast<size_t>(material_type::count)];
+  std::copy(type_begin_, type_begin_ + static_cast<size_t>(material_type::count), position);
+  for (size_t i = 0; i < rays_.size(); i++) {
+    if (hits_.type[i] != miss) {
+      order_[position[hits_.type[i]]++] = i;
+    }
+  }
+}
+
+template <class MATERIAL>
+void wavefrontTrace::scatter_material(size_t begin, size_t end) {
+  if (begin == end) return;
+
+  parallel_for(end - begin, [&](size_t k) {
+    const size_t position = begin + k;
+    const size_t i = order_[position];
+    const MATERIAL* mat = std::get_if<MATERIAL>(&(*materials_)[hits_.mat_index[i]]);
+
+    hit_record rec = hits_.get_record(i);
+    color attenuation;
+    ray scattered;
+
+    random_stream(counterRng::key(frame_, rays_.pixel[i], sample_));
+    random_bounce(bounce_);
+
+    alive_[position] = mat->scatter(rays_.get_ray(i), rec, attenuation, scattered);
+    if (alive_[position]) {
+      color throughput(rays_.throughput[0][i] * attenuation[0], rays_.throughput[1][i] * attenuation[1],
+                       rays_.throughput[2][i] * attenuation[2]);
+      next_rays_.set(position, scattered, throughput, rays_.pixel[i]);
+    }
+  });
+}
+
+void wavefrontTrace::scatter() {
+  const auto range = [this](material_type type) {
+    return std::make_pair(type_begin_[static_cast<size_t>(type)], type_begin_[static_cast<size_t>(type) + 1]);
+  };
+
+  auto lambertian_range = range(material_type::lambertian);
+  scatter_material<lambertian>(lambertian_range.first, lambertian_range.second);
+  auto metal_range = range(material_type::metal);
+  scatter_material<metal>(metal_range.first, metal_range.second);
+  auto dielectric_range = range(material_type::dielectric);
+  scatter_material<dielectric>(dielectric_range.first, dielectric_range.second);
+  // the lights absorb every ray
+  auto light_range = range(material_type::light);
+  std::fill(alive_.begin() + light_range.first, alive_.begin() + light_range.second, 0);
+}
+
+void wavefrontTrace::compact() {
+  const size_t num_hits = type_begin_[static_cast<size_t>(material_type::count)];
+
+  size_t num_alive = 0;
+  for (size_t position = 0; position < num_hits; position++) {
+    if (alive_[position]) {
+      if (num_alive != position) next_rays_.copy(num_alive, next_rays_, position);
+      num_alive++;
+    }
+  }
+
+  std::swap(rays_, next_rays_);
+  rays_.resize(num_alive);
+  next_rays_.resize(image_width_ * image_height_);
+}